@@ -47,6 +47,22 @@ int main(int argc, char** argv){
     cout << "x is: " << x << endl;
   }
   
+  // calls made asynchronously within a batch are sent together when
+  // the batch goes out of scope, their results arrive as futures
+  NVector<NFuture> fs;
+
+  {
+    NBroker::Batch batch(broker);
+
+    for(size_t i = 0; i < 1000; ++i){
+      fs.push_back(d->remoteRunAsync(nfunc("bar")));
+    }
+  }
+
+  for(NFuture& f : fs){
+    cout << "x is: " << f.get() << endl;
+  }
+
   nvar y = d->baz(1000);
 
   cout << "y is: " << y << endl;
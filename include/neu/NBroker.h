@@ -57,6 +57,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <neu/nvar.h>
 #include <neu/NCommunicator.h>
+#include <neu/NFuture.h>
 
 namespace neu{
   
@@ -72,9 +73,32 @@ namespace neu{
     
     bool listen(int port);
     
+    // may be called once for each address to listen on, e.g:
+    // tcp://:8000 and shm:///tmp/broker for same-host peers, see
+    // NCommunicator::connect()
+    bool listen(const nstr& address);
+    
+    // how the calls on a distributed object are run. calls are handed
+    // over by the connections they arrive on, which go on receiving
+    enum Policy{
+      // one at a time in the order they arrive, from all connections
+      Serial,
+      // on any thread of the task as they arrive, in no set order, the
+      // object must be thread-safe
+      Concurrent,
+      // calls to read-only methods run in parallel with each other,
+      // others one at a time, in the order they arrive
+      ReadWrite
+    };
+    
+    // under ReadWrite, readOnly lists the names of the methods which
+    // leave the object unchanged, by default those neu-meta found to
+    // be const in the metadata of its class
     void distribute(NObject* object,
                     const nstr& className,
-                    const nstr& objectName);
+                    const nstr& objectName,
+                    Policy policy=Serial,
+                    const nvar& readOnly=none);
     
     void revoke(const nstr& objectName);
     
@@ -83,8 +107,31 @@ namespace neu{
                     const nstr& objectName,
                     const nvar& auth);
     
+    NObject* obtain(const nstr& address,
+                    const nstr& objectName,
+                    const nvar& auth);
+    
     void release(NObject* object);
     
+    // pushes the changes made to a distributed object to the proxies
+    // subscribed to it: every interval seconds the object is stored
+    // and compared to what was last published, the differences are
+    // sent, or a heartbeat if there are none. the object is stored
+    // through its policy as a read-only call
+    void replicate(const nstr& objectName, double interval=0.05);
+    
+    // publishes the changes to a replicated object at once, e.g: after
+    // it was changed locally
+    void publish(const nstr& objectName);
+    
+    // keeps a local replica of the replicated object behind proxy,
+    // which answers calls to the methods named in reads for as long as
+    // the owner was heard from within staleness seconds, which should
+    // be a few times the interval it was replicated with. other calls,
+    // and reads while the replica is stale, are remote. returns false
+    // if the object is not replicated
+    bool subscribe(NObject* proxy, const nvar& reads, double staleness=0.2);
+    
     void setLogStream(std::ostream& ostr);
     
     virtual bool authenticate(NCommunicator* comm, const nvar& auth){
@@ -93,8 +140,41 @@ namespace neu{
     
     void setEncoder(NCommunicator::Encoder* encoder);
     
+    // see NCommunicator::setMinCompressSize(), applies to connections
+    // made or accepted from then on
+    void setMinCompressSize(size_t n);
+    
     nvar process_(NObject* obj, const nvar& n);
     
+    // sends a call to a remote object without waiting for it to
+    // return, any number of calls may be outstanding on an object.
+    // pointer arguments are updated before the future is ready
+    NFuture processAsync_(NObject* obj, const nvar& n);
+    
+    // while a batch is open, the calls the thread which opened it
+    // makes with processAsync_() are held and sent when it is closed
+    // or send() is called, as one message per connection, which is
+    // shared by the objects obtained from the same address and auth.
+    // the server runs the calls of a message in order, each once the
+    // one before it has returned, and returns their results together.
+    // a synchronous call sends the calls held before it. batches may
+    // be nested
+    class Batch{
+    public:
+      Batch(NBroker& broker);
+      
+      ~Batch();
+      
+      void send();
+      
+      Batch(const Batch&) = delete;
+      
+      Batch& operator=(const Batch&) = delete;
+      
+    private:
+      class NBrokerBatch_* x_;
+    };
+    
     NBroker& operator=(const NBroker&) = delete;
     
     NBroker(const NBroker&) = delete;
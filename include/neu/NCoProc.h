@@ -0,0 +1,162 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_CO_PROC_H
+#define NEU_N_CO_PROC_H
+
+#include <atomic>
+
+#include <neu/NProc.h>
+#include <neu/NBasicMutex.h>
+
+namespace neu{
+  
+  class NCoroutine_;
+  
+  // a proc whose run() is a coroutine: each item queued for it starts
+  // a coroutine on a stack of its own, which may suspend itself while
+  // it waits on a socket, a timer, a semaphore or a future and is
+  // resumed on a worker of the same task once what it waits on is
+  // ready, waiting coroutines hold no worker. a coroutine may resume
+  // on a different worker than the one it suspended on. the proc
+  // must outlive its coroutines
+  
+  class NCoProc : public NProc{
+  public:
+    static const size_t DefaultStackSize = 65536;
+    
+    NCoProc(size_t stackSize=DefaultStackSize);
+    
+    virtual ~NCoProc();
+    
+    // the number of coroutines started and not yet returned
+    size_t active() const;
+    
+    // true if called from a coroutine
+    static bool inCoroutine();
+    
+    // the functions below suspend the calling coroutine, called
+    // outside of a coroutine they block instead. a negative timeout
+    // waits indefinitely, they return false on timeout
+    
+    // waits until fd can be read or has been disconnected, only one
+    // coroutine may wait on an fd at a time
+    static bool awaitReadable(int fd, double timeout=-1);
+    
+    static bool awaitWritable(int fd, double timeout=-1);
+    
+    static void sleep(double dt);
+    
+    // requeues the calling coroutine behind the items already queued
+    static void yield();
+    
+    // waits for f and returns its result, if its computation failed,
+    // throws the NError which caused it
+    static const nvar& await(const NFuture& f);
+    
+  private:
+    friend class NCoroutine_;
+    friend class NCoSemaphore;
+    
+    class Resume : public NProc{
+    public:
+      void run(nvar& r);
+      
+      bool dealloc_(nvar& r);
+    };
+    
+    void run_(NProcTask* task, nvar& r);
+    
+    void* allocStack_();
+    
+    void freeStack_(void* s);
+    
+    size_t stackSize_;
+    std::atomic<size_t> active_;
+    Resume resume_;
+    NBasicMutex stackMutex_;
+    NVector<void*> stacks_;
+  };
+  
+  // a counting semaphore for coroutines, acquire() suspends the
+  // calling coroutine instead of blocking its worker, release() may
+  // be called from any thread
+  
+  class NCoSemaphore{
+  public:
+    NCoSemaphore(size_t count=0);
+    
+    ~NCoSemaphore();
+    
+    // throws if not called from a coroutine
+    void acquire();
+    
+    bool tryAcquire();
+    
+    void release(size_t count=1);
+    
+    NCoSemaphore& operator=(const NCoSemaphore&) = delete;
+    
+    NCoSemaphore(const NCoSemaphore&) = delete;
+    
+  private:
+    NBasicMutex mutex_;
+    size_t count_;
+    NCoroutine_* head_;
+    NCoroutine_* tail_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_CO_PROC_H
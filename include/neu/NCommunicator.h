@@ -88,7 +88,16 @@ namespace neu{
     
     bool connect(const nstr& host, int port);
     
-    void setSocket(NSocket* socket);
+    // connects to tcp://host:port, to a Unix domain socket with
+    // unix:///path, or with shm:///path to a peer on the same host
+    // through a pair of shared memory rings, set up over the Unix
+    // domain socket at path
+    bool connect(const nstr& address);
+    
+    // if sharedMemory is set, socket was accepted on the Unix domain
+    // socket of an shm:// listener and the rings are created and
+    // handed to the peer over it
+    void setSocket(NSocket* socket, bool sharedMemory=false);
     
     NProcTask* task();
 
@@ -96,16 +105,71 @@ namespace neu{
     
     virtual void onClose(bool manual){}
     
+    // called by the receiving proc each time a message has been
+    // queued for receive()
+    virtual void onReceive(){}
+    
     bool isConnected() const;
     
+    // queued messages are written together, at most n with one
+    // system call, 64 by default
+    void setMaxBatch(size_t n);
+    
+    // a received message larger than n bytes closes the connection,
+    // 64 MB by default
+    void setMaxMessageSize(size_t n);
+    
+    // messages which pack to at least n bytes are compressed, 1024 by
+    // default, nvar::NO_COMPRESS to send all uncompressed
+    void setMinCompressSize(size_t n);
+    
+    // sets TCP_NODELAY, on by default as queued messages are already
+    // coalesced
+    void setNoDelay(bool flag);
+    
+    // sets TCP_CORK, or TCP_NOPUSH on the Mac, off by default
+    void setCork(bool flag);
+    
+    // bounds the messages queued for sending, by count and by packed
+    // bytes. once either high watermark is reached, senders wait until
+    // the queue is down to the low watermarks. a high watermark of 0
+    // is unlimited, the default
+    void setSendWatermarks(size_t highCount,
+                           size_t lowCount,
+                           size_t highBytes=0,
+                           size_t lowBytes=0);
+    
+    // bounds the messages received but not yet taken by receive(), by
+    // count and by frame bytes. once either high watermark is reached,
+    // the connection is no longer read until the queue is down to the
+    // low watermarks, so the peer is held back by the transport. the
+    // frames of the last read may go over the high watermarks
+    void setReceiveWatermarks(size_t highCount,
+                              size_t lowCount,
+                              size_t highBytes=0,
+                              size_t lowBytes=0);
+    
+    // blocks while the send queue is full
     void send(nvar& msg);
     
+    // waits at most timeout seconds for room in the send queue, 0 to
+    // fail at once, returns false if msg was not queued
+    bool send(nvar& msg, double timeout);
+    
     bool receive(nvar& msg);
     
     bool receive(nvar& msg, double timeout);
     
     nvar& session();
     
+    // queue depths, returns:
+    // [send:[count:, bytes:, maxCount:, maxBytes:, full:, blocked:,
+    // dropped:], receive:[count:, bytes:, maxCount:, maxBytes:,
+    // paused:]] where full is how often the send queue filled up,
+    // blocked how many sends had to wait, dropped how many of those
+    // gave up and paused how often reading was paused
+    nvar stats();
+    
     NCommunicator(const NCommunicator&) = delete;
     
     NCommunicator& operator=(const NCommunicator&) = delete;
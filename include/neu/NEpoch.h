@@ -0,0 +1,138 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_EPOCH_H
+#define NEU_N_EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace neu{
+  
+  // epoch-based deferred reclamation for read-mostly structures
+  // which are published through an atomic pointer. readers bracket
+  // their accesses with enter()/exit(), which only write to a
+  // per-thread record. writers publish a new version, then retire()
+  // the old one, which is deleted once every reader that could
+  // still be holding it has exited
+  
+  class NEpoch{
+  public:
+    typedef void (*Deleter)(void*);
+    
+    class Guard{
+    public:
+      Guard(){
+        NEpoch::enter();
+      }
+      
+      ~Guard(){
+        NEpoch::exit();
+      }
+      
+      Guard(const Guard&) = delete;
+      
+      Guard& operator=(const Guard&) = delete;
+    };
+    
+    struct Record{
+      std::atomic<uint64_t> epoch;
+      uint32_t depth;
+      bool free;
+      Record* next;
+    };
+    
+    static void enter(){
+      Record* r = record_;
+      
+      if(!r){
+        r = attach_();
+      }
+      
+      if(r->depth++ == 0){
+        r->epoch.store(epoch_.load(std::memory_order_acquire));
+      }
+    }
+    
+    static void exit(){
+      Record* r = record_;
+      
+      if(--r->depth == 0){
+        r->epoch.store(0, std::memory_order_release);
+      }
+    }
+    
+    // p must already be unreachable through the published pointer
+    static void retire(void* p, Deleter deleter);
+    
+    template<class T>
+    static void retire(T* p){
+      retire(p, [](void* q){ delete static_cast<T*>(q); });
+    }
+    
+    // delete whatever retired objects are no longer visible to any
+    // reader
+    static void reclaim();
+    
+  private:
+    static Record* attach_();
+    
+    static std::atomic<uint64_t> epoch_;
+    
+    static thread_local Record* record_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_EPOCH_H
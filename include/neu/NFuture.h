@@ -0,0 +1,143 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_FUTURE_H
+#define NEU_N_FUTURE_H
+
+#include <functional>
+
+#include <neu/nvar.h>
+
+namespace neu{
+  
+  class NProcTask;
+  class NError;
+  
+  // the result of a computation which may not have completed yet,
+  // futures and promises are handles to a shared state, they may be
+  // copied freely
+  
+  class NFuture{
+  public:
+    typedef std::function<nvar(const nvar&)> Func;
+    
+    NFuture();
+    
+    NFuture(const NFuture& f);
+    
+    ~NFuture();
+    
+    NFuture& operator=(const NFuture& f);
+    
+    bool valid() const;
+    
+    // true once a result or an error has been set
+    bool ready() const;
+    
+    void wait() const;
+    
+    // returns false on timeout, dt is in (fractional) seconds
+    bool wait(double dt) const;
+    
+    // waits for the result, if the computation failed, throws the
+    // NError which caused it
+    const nvar& get() const;
+    
+    // returns a future for f applied to this future's result, f is
+    // queued on task once the result is ready, if the computation
+    // failed, f is not run and its future fails with the same error
+    NFuture then(NProcTask* task, const Func& f, double priority=0) const;
+    
+    // calls f once the result or an error is set, on the thread
+    // which sets it, or immediately if it is already set
+    void notify(const std::function<void()>& f) const;
+    
+    // returns a future which is ready once all of fs are, with a
+    // vector of their results
+    static NFuture all(const NVector<NFuture>& fs);
+    
+  private:
+    friend class NPromise;
+    
+    NFuture(class NFuture_* x);
+    
+    class NFuture_* x_;
+  };
+  
+  class NPromise{
+  public:
+    NPromise();
+    
+    NPromise(const NPromise& p);
+    
+    ~NPromise();
+    
+    NPromise& operator=(const NPromise& p);
+    
+    NFuture future() const;
+    
+    // only the first result or error set is kept
+    void set(const nvar& v);
+    
+    void set(nvar&& v);
+    
+    void setError(const NError& e);
+    
+  private:
+    class NFuture_* x_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_FUTURE_H
@@ -381,12 +381,14 @@ namespace neu{
     
     void splice(iterator position, NList& x){
       reset_();
-      l_.splice(position, x);
+      x.reset_();
+      l_.splice(position, x.l_);
     }
     
     void splice(iterator position, NList& x, iterator i){
       reset_();
-      l_.splice(position, x, i);
+      x.reset_();
+      l_.splice(position, x.l_, i);
     }
     
     void splice(iterator position,
@@ -394,7 +396,8 @@ namespace neu{
                 iterator first,
                 iterator last){
       reset_();
-      l_.splice(position, x, first, last);
+      x.reset_();
+      l_.splice(position, x.l_, first, last);
     }
     
     void swap(NList& lst){
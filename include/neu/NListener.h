@@ -58,6 +58,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <fcntl.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <unistd.h>
 
@@ -111,6 +112,56 @@ namespace neu{
       
       return true;
     }
+    
+    // listens on a Unix domain socket at path, replacing a socket
+    // left there, fails if there is any other kind of file. the file
+    // is removed once closed
+    bool listenLocal(const nstr& path){
+      close();
+      
+      sockaddr_un addr;
+      
+      if(path.length() >= sizeof(addr.sun_path)){
+        return false;
+      }
+      
+      fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+      
+      if(fd_ < 0){
+        return false;
+      }
+      
+      struct stat st;
+      if(lstat(path.c_str(), &st) == 0){
+        if(!S_ISSOCK(st.st_mode)){
+          ::close(fd_);
+          return false;
+        }
+        
+        unlink(path.c_str());
+      }
+      
+      bzero((char*)&addr, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path.c_str());
+      
+      int status = ::bind(fd_, (const sockaddr*)&addr, sizeof(addr));
+      if(status < 0){
+        ::close(fd_);
+        return false;
+      }
+      
+      if(::listen(fd_, listenBackLog_) < 0){
+        ::close(fd_);
+        unlink(path.c_str());
+        return false;
+      }
+      
+      port_ = 0;
+      path_ = path;
+      
+      return true;
+    }
 
     NSocket* accept(){
      if(port_ < 0){
@@ -131,23 +182,7 @@ namespace neu{
         return 0;
       }
       
-      int reuseOn = 1;
-      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, 
-                 &reuseOn, sizeof(reuseOn));
-      
-      char host[2048];
-      
-      getnameinfo(&addr, sizeof(addr), host, 2048, 0, 0, 0);
-
-      sockaddr_in addrIn;
-      socklen_t inLen = sizeof(addrIn);
-      getpeername(fd, (sockaddr*)&addrIn, &inLen);
-
-      NSocket* socket = new NSocket(fd);
-      socket->setHost_(host);
-      socket->setIPAddress_(inet_ntoa(addrIn.sin_addr));
-
-      return socket;
+      return newSocket(fd, addr);
     }
 
     NSocket* accept(double timeout){
@@ -166,6 +201,11 @@ namespace neu{
       int fd;
 
       while((fd = ::accept(fd_, &addr, &len)) < 0){
+        // e.g: out of fds, the connection stays pending
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+          return 0;
+        }
+        
         fd_set rfs;
         FD_ZERO(&rfs);
         FD_SET(fd_, &rfs);
@@ -188,23 +228,7 @@ namespace neu{
       opts &= ~O_NONBLOCK;
       fcntl(fd, F_SETFL, opts);
       
-      int reuseOn = 1;
-      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, 
-                 &reuseOn, sizeof(reuseOn));
-      
-      char host[2048];
-      
-      getnameinfo(&addr, sizeof(addr), host, 2048, 0, 0, 0);
-
-      sockaddr_in addrIn;
-      socklen_t inLen = sizeof(addrIn);
-      getpeername(fd, (sockaddr*)&addrIn, &inLen);
-
-      NSocket* socket = new NSocket(fd);
-      socket->setHost_(host);
-      socket->setIPAddress_(inet_ntoa(addrIn.sin_addr));
-
-      return socket;
+      return newSocket(fd, addr);
     } 
     
     void close(){
@@ -214,8 +238,17 @@ namespace neu{
 
       ::close(fd_);
       port_ = -1;
+      
+      if(!path_.empty()){
+        unlink(path_.c_str());
+        path_ = "";
+      }
     }
 
+    int fd() const{
+      return fd_;
+    }
+    
     NListener& operator=(const NListener&) = delete;
 
     NListener(const NListener&) = delete;
@@ -223,7 +256,35 @@ namespace neu{
   private:  
     int port_;
     int fd_;
+    nstr path_;
     size_t listenBackLog_;
+    
+    NSocket* newSocket(int fd, sockaddr& addr){
+      NSocket* socket = new NSocket(fd);
+      
+      // peers of a local listener have no address
+      if(!path_.empty()){
+        socket->setHost_("localhost");
+        return socket;
+      }
+      
+      int reuseOn = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, 
+                 &reuseOn, sizeof(reuseOn));
+      
+      char host[2048];
+      
+      getnameinfo(&addr, sizeof(addr), host, 2048, 0, 0, 0);
+
+      sockaddr_in addrIn;
+      socklen_t inLen = sizeof(addrIn);
+      getpeername(fd, (sockaddr*)&addrIn, &inLen);
+
+      socket->setHost_(host);
+      socket->setIPAddress_(inet_ntoa(addrIn.sin_addr));
+      
+      return socket;
+    }
   };
   
 } // end namespace neu
@@ -62,6 +62,8 @@ namespace neu{
   
   class NScope;
   class NBroker;
+  class NFuture;
+  class NObjectCompiler;
   
   class NObject : public NObjectBase{
   public:
@@ -85,8 +87,15 @@ namespace neu{
     
     nvar remoteRun(const nvar& v);
     
+    // returns once v has been sent to the remote object, see
+    // NBroker::processAsync_()
+    NFuture remoteRunAsync(const nvar& v);
+    
     nvar run(const nvar& v, uint32_t flags=0);
     
+    // returns an optimized copy of code, see NObject.cpp
+    nvar optimize(const nvar& code);
+    
     virtual NFunc handle(const nvar& v, uint32_t flags=0);
     
     virtual nvar handleSymbol(const nstr& s){
@@ -105,6 +114,24 @@ namespace neu{
     
     void setHandleSymbol(bool flag);
     
+    // when set, function bodies are passed through optimize() by Def
+    void setOptimize(bool flag);
+    
+    // when set, functions subsequently defined in the object scope are
+    // handed to compiler for the types of their arguments once they
+    // have been called threshold times, see NObjectCompiler.h
+    void setCompiler(NObjectCompiler* compiler, size_t threshold=1000);
+    
+    // sets the maximum number of results cached for each function
+    // defined with DefMemo, the least recently used are evicted
+    void setMemoSize(size_t size);
+    
+    // returns: [<name>/<arity>:[hits:, misses:, size:, capacity:], ...]
+    nvar memoStats();
+    
+    // discards the cached results and statistics of DefMemo functions
+    void clearMemo();
+    
     bool isRemote();
     
     void foo(nvar& x);
@@ -238,6 +265,10 @@ namespace neu{
     nvar Def(const nvar& v1, const nvar& v2, const nvar& v3);
     
     nvar Def(const nvar& v1, const nvar& v2);
+    
+    // same as Def, but the function is treated as pure, its results
+    // are cached by the values of its arguments, see setMemoSize()
+    nvar DefMemo(const nvar& v1, const nvar& v2);
 
     nvar DefSym(const nvar& v1, const nvar& v2, const nvar& v3);
     
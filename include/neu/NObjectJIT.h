@@ -0,0 +1,104 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_OBJECT_JIT_H
+#define NEU_N_OBJECT_JIT_H
+
+#include <neu/NObjectCompiler.h>
+
+namespace neu{
+  
+  // compiles numeric-only NObject functions to native code through
+  // NPLModule. a function qualifies for a combination of Integer and
+  // Float argument types if its body only uses arithmetic,
+  // comparisons, If, For, While, Break, Ret, locals declared with
+  // Var and calls to itself. the compiled code bails out to the
+  // interpreter where nvar would throw or produce a Rational, e.g:
+  // on division by zero
+  //
+  // NObjectJIT jit;
+  // NObject o;
+  // o.setCompiler(&jit, 100);
+  
+  class NObjectJIT : public NObjectCompiler{
+  public:
+    NObjectJIT();
+    
+    ~NObjectJIT();
+    
+    NCompiledFunc* compile(NObject* o,
+                           const nvar& s,
+                           const nvar& b,
+                           const nvec& types);
+    
+    // returns the NPL code compile() passes to NPLModule or none if
+    // the function does not qualify
+    nvar translate(NObject* o,
+                   const nvar& s,
+                   const nvar& b,
+                   const nvec& types);
+    
+    void setErrorStream(std::ostream& estr);
+    
+    NObjectJIT& operator=(const NObjectJIT&) = delete;
+    
+    NObjectJIT(const NObjectJIT&) = delete;
+    
+  private:
+    class NObjectJIT_* x_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_OBJECT_JIT_H
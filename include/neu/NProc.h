@@ -55,16 +55,33 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef NEU_N_PROC_H
 #define NEU_N_PROC_H
 
+#include <atomic>
+#include <functional>
+#include <ostream>
+
 #include <neu/nvar.h>
+#include <neu/NFuture.h>
 
 namespace neu{
 
   class NProc;
+  class NProcState_;
   
   class NProcTask{
   public:
     NProcTask(size_t threads);
     
+    // options:
+    //   threads: the number of workers
+    //   name: workers are named <name>:<index>, as shown in /proc,
+    //     truncated to 15 characters
+    //   cpus: a vector, worker i is pinned to the cpu or the vector of
+    //     cpus at i modulo its size
+    //   numa: if true and cpus is not given, workers are spread round
+    //     robin over the NUMA nodes and pinned to the cpus of their
+    //     node. pinned workers allocate their items on their own node
+    NProcTask(const nvar& options);
+    
     void shutdown();
     
     virtual ~NProcTask();
@@ -78,17 +95,114 @@ namespace neu{
       queue(proc, r);
     }
     
+    // queues proc once for each of rs, which is left empty. the items
+    // are split into one run per worker and each run is queued under
+    // a single lock, no more workers are woken than there are runs
+    void queueBatch(NProc* proc, nvec& rs, double priority=0);
+    
+    // queues procs[i] with rs[i]
+    void queueBatch(const NVector<NProc*>& procs,
+                    nvec& rs,
+                    double priority=0);
+    
+    // calls f(i, j) for each range [i, j) of at most chunk indices
+    // making up [begin, end). the ranges are shared by a batch of at
+    // most one item per worker and the calling thread, which returns
+    // once all have been run. if f throws, the first NError is
+    // rethrown
+    void parallelFor(size_t begin,
+                     size_t end,
+                     size_t chunk,
+                     const std::function<void(size_t, size_t)>& f,
+                     double priority=0);
+    
+    // queues proc to run after delay seconds, returns a timer which
+    // may be passed to cancel(), or 0 if proc has been terminated
+    uint64_t queueAfter(NProc* proc, nvar& r, double delay,
+                        double priority=0);
+    
+    uint64_t queueAfter(NProc* proc, double delay){
+      nvar r;
+      return queueAfter(proc, r, delay);
+    }
+    
+    // time is as returned by NSys::now()
+    uint64_t queueAt(NProc* proc, nvar& r, double time, double priority=0);
+    
+    // queues proc with a copy of r every period seconds, until the
+    // timer is cancelled or proc is terminated
+    uint64_t queueEvery(NProc* proc,
+                        const nvar& r,
+                        double period,
+                        double priority=0);
+    
+    // returns true if the timer was pending, r is passed to dealloc()
+    bool cancel(uint64_t timer);
+    
+    // runs f and sets p to its result, or to the NError it throws
+    void submit(const std::function<nvar()>& f,
+                const NPromise& p,
+                double priority=0);
+    
+    NFuture submit(const std::function<nvar()>& f, double priority=0){
+      NPromise p;
+      submit(f, p, priority);
+      return p.future();
+    }
+    
     bool terminate(NProc* proc);
     
+    size_t threads() const;
+    
+    // the index of the calling worker, or -1 if not called from a
+    // worker of this task
+    int worker() const;
+    
+    // the number of NUMA nodes the workers were placed on, 1 unless
+    // workers are pinned
+    size_t nodes() const;
+    
+    size_t node(size_t worker) const;
+    
+    // while statistics are on, items are counted by the workers
+    // which queue and run them and one in 16 has its wait and run
+    // times measured, utilization is derived from the time workers
+    // spend asleep. the queue depth is sampled every interval seconds
+    void startStats(double interval=0.1);
+    
+    void stopStats();
+    
+    // returns: [enabled:, elapsed:, threads:, tasks:, tasksPerSecond:,
+    // depth:, steals:, utilization:, wait:<h>, run:<h>, workers:[[tasks:,
+    // steals:, utilization:], ...], procs:[<class>:[tasks:, wait:<h>,
+    // run:<h>], ...], samples:[[time:, depth:, tasksPerSecond:], ...]]
+    // where <h> is [count:, mean:, max:, p50:, p90:, p99:], times are in
+    // seconds. wait is the time from queue to start, tasksPerSecond is
+    // the rate over the last sample interval
+    nvar stats();
+    
+    // while statistics are on, writes a summary line to ostr every
+    // period seconds, a period of 0 stops logging
+    void logStats(std::ostream& ostr, double period);
+    
+    // queues proc on the deque of worker, where it runs unless
+    // another worker steals it
+    void queueOn(NProc* proc, nvar& r, size_t worker);
+    
+    // queues proc on a worker of node, workers steal from the other
+    // workers of their node before trying other nodes
+    void queueOnNode(NProc* proc, nvar& r, size_t node);
+    
   private:
     class NProcTask_* x_;
   };
   
   class NProc{
   public:
-    NProc(){}
+    NProc()
+    : state_(0){}
     
-    virtual ~NProc(){}
+    virtual ~NProc();
     
     virtual bool handle(nvar& v, nvar& r){
       return true;
@@ -111,6 +225,22 @@ namespace neu{
     NProc& operator=(const NProc&) = delete;
     
     NProc(const NProc&) = delete;
+    
+  private:
+    friend class NProcTask_;
+    
+    // called by task to run an item, NCoProc runs it in a coroutine
+    virtual void run_(NProcTask* task, nvar& r){
+      run(r);
+    }
+    
+    // called for the items left queued when a task is deleted,
+    // returns false to pass r on to the task's dealloc()
+    virtual bool dealloc_(nvar& r){
+      return false;
+    }
+    
+    std::atomic<NProcState_*> state_;
   };
   
 } // end namespace neu
@@ -0,0 +1,110 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_PROFILER_H
+#define NEU_N_PROFILER_H
+
+#include <atomic>
+
+#include <neu/nvar.h>
+
+namespace neu{
+  
+  // profiler for interpreted NObject code. functions are identified
+  // by name, arity and the __file/__line of their definition. in
+  // Exact mode every call is timed; in Sampling mode calls only
+  // maintain a shadow stack which a background thread samples
+  // (wall-clock) every interval seconds. when the profiler is not
+  // started the interpreter only tests active()
+  
+  class NProfiler{
+  public:
+    static const uint32_t Exact =    0x00000001;
+    static const uint32_t Sampling = 0x00000002;
+    
+    static void start(uint32_t mode=Exact, double interval=0.001);
+    
+    static void stop();
+    
+    static void clear();
+    
+    static bool active(){
+      return active_.load(std::memory_order_relaxed);
+    }
+    
+    // returns: [mode:<mode>, functions:[[name:, arity:, file:, line:,
+    // calls:, inclusive:, exclusive:, allocations:, samples:,
+    // inclusiveSamples:], ...]], times are in seconds and functions
+    // are sorted by descending exclusive time (or samples)
+    static nvar report();
+    
+    // collapsed stacks for flame graph tools, one "f1;f2;f3 count"
+    // line per distinct stack, count is microseconds of exclusive
+    // time in Exact mode or the number of samples in Sampling mode
+    static nstr collapsed();
+    
+    // called by NObject on entering and leaving an interpreted
+    // function whose signature is s, s must remain valid until the
+    // matching exit()
+    static void enter(const nvar& s);
+    
+    static void exit();
+    
+  private:
+    static std::atomic_bool active_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_PROFILER_H
@@ -0,0 +1,131 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_REACTOR_H
+#define NEU_N_REACTOR_H
+
+#include <cstdint>
+
+namespace neu{
+  
+  // an edge-triggered reactor: one thread, shared by the process,
+  // which waits on the sockets of communicators and listeners with
+  // epoll, or kqueue on the Mac, and calls their handlers as they
+  // become readable or writable. a handler is only called again
+  // once more data or buffer space is available, so it must read
+  // until its fd would block or ask to be called again
+  
+  class NReactor{
+  public:
+    static const uint32_t Readable = 0x1;
+    static const uint32_t Writable = 0x2;
+    static const uint32_t Closed =   0x4;
+    
+    class Handler{
+    public:
+      Handler(int fd)
+      : fd_(fd),
+      dead_(false),
+      again_(0){}
+      
+      virtual ~Handler(){}
+      
+      // called on the reactor thread with a combination of Readable,
+      // Writable and Closed, returns true if the handler stopped
+      // before its fd would block and should be called again with
+      // the same events before the reactor waits
+      virtual bool onEvent(uint32_t events) = 0;
+      
+      int fd() const{
+        return fd_;
+      }
+      
+    private:
+      friend class NReactor_;
+      
+      int fd_;
+      bool dead_;
+      uint32_t again_;
+    };
+    
+    // the process's reactor, started on first use
+    static NReactor* get();
+    
+    // makes h's fd non-blocking and watches it for reading and
+    // writing, h is called for the first time when either is
+    // possible
+    void add(Handler* h);
+    
+    // once remove() returns, h is no longer called, the reactor
+    // deletes it. remove() may be called from onEvent()
+    void remove(Handler* h);
+    
+    // calls h with events on the reactor thread as soon as it can,
+    // e.g: to resume a handler which stopped reading. h must not be
+    // removed before call() returns
+    void call(Handler* h, uint32_t events);
+    
+    NReactor& operator=(const NReactor&) = delete;
+    
+    NReactor(const NReactor&) = delete;
+    
+  private:
+    NReactor();
+    
+    class NReactor_* x_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_REACTOR_H
@@ -55,9 +55,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef NEU_N_SCOPE_H
 #define NEU_N_SCOPE_H
 
+#include <atomic>
+
 #include <neu/NObjectBase.h>
 #include <neu/nvar.h>
-#include <neu/NRWMutex.h>
+#include <neu/NBasicMutex.h>
+#include <neu/NEpoch.h>
 
 namespace neu{
   
@@ -75,14 +78,20 @@ namespace neu{
       limiting_ = sv["limiting_"];
       shared_ = sv["shared"] ? new Shared_ : 0;
 
+      SymbolMap_& symbolMap =
+      shared_ ? *shared_->symbolMap.load() : symbolMap_;
+      
       const nmap& sm  = sv["symbolMap"];
       
       for(auto& itr : sm){
         const nstr& s = itr.first;
         const nvar& v = itr.second;
-        symbolMap_.insert({s, v});
+        symbolMap.insert({s, v});
       }
       
+      FunctionMap_& functionMap =
+      shared_ ? *shared_->functionMap.load() : functionMap_;
+      
       const nmap& fm  = sv["functionMap"];
       
       for(auto& itr : fm){
@@ -92,11 +101,15 @@ namespace neu{
         
         const nvar& v = itr.second;
         
-        functionMap_.insert({{fs, arity}, {v[0], v[1]}});
+        functionMap.insert({{fs, arity}, {v[0], v[1]}});
       }
     }
     
-    ~NScope(){}
+    ~NScope(){
+      if(shared_){
+        delete shared_;
+      }
+    }
     
     void store(nvar& v) const{
       if(!v.has("type")){
@@ -108,22 +121,14 @@ namespace neu{
       nput(sv, limiting_);
       sv("shared") = shared_ ? true : false;
       
-      nmap& sm = sv("symbolMap") = nmap();
-      
-      for(auto& itr : symbolMap_){
-        const nstr& s = itr.first;
-        const nvar& v = itr.second;
-        
-        sm[nvar(s, nvar::Sym)] = v;
+      if(shared_){
+        NEpoch::Guard guard;
+        store_(sv,
+               *shared_->symbolMap.load(),
+               *shared_->functionMap.load());
       }
-      
-      nmap& fm = sv("functionMap") = nmap();
-      
-      for(auto& itr : functionMap_){
-        nvar k = {nvar(itr.first.first, nvar::Sym), itr.first.second};
-        nvar v = {itr.second.first, itr.second.second};
-        
-        fm.emplace(std::move(k), std::move(v));
+      else{
+        store_(sv, symbolMap_, functionMap_);
       }
     }
     
@@ -136,19 +141,42 @@ namespace neu{
     }
     
     void clear(){
+      if(shared_){
+        shared_->mutex.lock();
+        SymbolMap_* sm = shared_->symbolMap.exchange(new SymbolMap_);
+        FunctionMap_* fm = shared_->functionMap.exchange(new FunctionMap_);
+        shared_->mutex.unlock();
+        
+        NEpoch::retire(sm);
+        NEpoch::retire(fm);
+        return;
+      }
+      
       symbolMap_.clear();
       functionMap_.clear();
     }
     
     void setSymbolFast(const nstr& s, const nvar& v){
+      if(shared_){
+        setSymbol(s, v);
+        return;
+      }
+      
       symbolMap_[s] = v;
     }
     
+    // a shared scope is read-copy-update: readers take no locks, a
+    // writer publishes a modified copy and retires the old version
     void setSymbol(const nstr& s, const nvar& v){
       if(shared_){
-        shared_->symbolMutex_.writeLock();
-        symbolMap_[s] = v;
-        shared_->symbolMutex_.unlock();
+        shared_->mutex.lock();
+        SymbolMap_* sm = shared_->symbolMap.load();
+        SymbolMap_* nm = new SymbolMap_(*sm);
+        (*nm)[s] = v;
+        shared_->symbolMap.store(nm);
+        shared_->mutex.unlock();
+        
+        NEpoch::retire(sm);
       }
       else{
         symbolMap_[s] = v;
@@ -157,16 +185,16 @@ namespace neu{
         
     bool getSymbol(const nstr& s, nvar& v){
       if(shared_){
-        shared_->symbolMutex_.readLock();
+        NEpoch::Guard guard;
+        
+        const SymbolMap_& sm = *shared_->symbolMap.load();
         
-        auto itr = symbolMap_.find(s);
-        if(itr == symbolMap_.end()){
-          shared_->symbolMutex_.unlock();
+        auto itr = sm.find(s);
+        if(itr == sm.end()){
           return false;
         }
         
         v = itr->second;
-        shared_->symbolMutex_.unlock();
         return true;
       }
       
@@ -181,9 +209,14 @@ namespace neu{
     
     void setFunction(const nvar& s, const nvar& b){
       if(shared_){
-        shared_->functionMutex_.writeLock();
-        functionMap_.insert({{s.str(), s.size()}, {s, b}});
-        shared_->functionMutex_.unlock();
+        shared_->mutex.lock();
+        FunctionMap_* fm = shared_->functionMap.load();
+        FunctionMap_* nm = new FunctionMap_(*fm);
+        nm->insert({{s.str(), s.size()}, {s, b}});
+        shared_->functionMap.store(nm);
+        shared_->mutex.unlock();
+        
+        NEpoch::retire(fm);
         return;
       }
       
@@ -192,14 +225,15 @@ namespace neu{
     
     bool getFunction(const nstr& f, size_t arity, nvar& s, nvar& b){
       if(shared_){
-        shared_->functionMutex_.readLock();
-        auto itr = functionMap_.find({f, arity});
-        if(itr == functionMap_.end()){
-          shared_->functionMutex_.unlock();
+        NEpoch::Guard guard;
+        
+        const FunctionMap_& fm = *shared_->functionMap.load();
+        
+        auto itr = fm.find({f, arity});
+        if(itr == fm.end()){
           return false;
         }
         
-        shared_->functionMutex_.unlock();
         s = itr->second.first;
         b = itr->second.second;
         return true;
@@ -215,16 +249,32 @@ namespace neu{
       return true;
     }
     
-    void dump(){
-      for(auto& itr : symbolMap_){
-        std::cout << itr.first << ": " << itr.second << std::endl;
+    bool hasFunction(const nstr& f, size_t arity){
+      if(shared_){
+        NEpoch::Guard guard;
+        
+        const FunctionMap_& fm = *shared_->functionMap.load();
+        return fm.find({f, arity}) != fm.end();
       }
       
-      for(auto& itr : functionMap_){
-        std::cout << itr.second.first << ": " << itr.second.second << std::endl;
+      return functionMap_.find({f, arity}) != functionMap_.end();
+    }
+    
+    void dump(){
+      if(shared_){
+        NEpoch::Guard guard;
+        dump_(*shared_->symbolMap.load(), *shared_->functionMap.load());
+      }
+      else{
+        dump_(symbolMap_, functionMap_);
       }
     }
     
+    // a shared scope owns its published maps
+    NScope& operator=(const NScope&) = delete;
+    
+    NScope(const NScope&) = delete;
+    
   private:
     struct SymHash_{
       size_t operator()(const nstr& k) const{
@@ -245,17 +295,63 @@ namespace neu{
 
     typedef NHashMap<FuncKey_, std::pair<nvar, nvar>, FuncHash_> FunctionMap_;
     
+    static void store_(nvar& sv,
+                       const SymbolMap_& symbolMap,
+                       const FunctionMap_& functionMap){
+      
+      nmap& sm = sv("symbolMap") = nmap();
+      
+      for(auto& itr : symbolMap){
+        const nstr& s = itr.first;
+        const nvar& v = itr.second;
+        
+        sm[nvar(s, nvar::Sym)] = v;
+      }
+      
+      nmap& fm = sv("functionMap") = nmap();
+      
+      for(auto& itr : functionMap){
+        nvar k = {nvar(itr.first.first, nvar::Sym), itr.first.second};
+        nvar v = {itr.second.first, itr.second.second};
+        
+        fm.emplace(std::move(k), std::move(v));
+      }
+    }
+    
+    static void dump_(const SymbolMap_& symbolMap,
+                      const FunctionMap_& functionMap){
+      for(auto& itr : symbolMap){
+        std::cout << itr.first << ": " << itr.second << std::endl;
+      }
+      
+      for(auto& itr : functionMap){
+        std::cout << itr.second.first << ": " << itr.second.second << std::endl;
+      }
+    }
+    
     SymbolMap_ symbolMap_;
     FunctionMap_ functionMap_;
 
     bool limiting_ : 1;
     
+    // the current versions of a shared scope's maps, writers are
+    // serialized by mutex
     struct Shared_{
-      mutable NRWMutex symbolMutex_;
-      mutable NRWMutex functionMutex_;
+      Shared_()
+      : symbolMap(new SymbolMap_),
+      functionMap(new FunctionMap_){}
+      
+      ~Shared_(){
+        delete symbolMap.load();
+        delete functionMap.load();
+      }
+      
+      std::atomic<SymbolMap_*> symbolMap;
+      std::atomic<FunctionMap_*> functionMap;
+      NBasicMutex mutex;
     };
     
-    mutable Shared_* shared_;
+    Shared_* shared_;
   };
   
 } // end namespace neu
@@ -73,6 +73,10 @@ namespace neu{
     
     bool listen(int port);
     
+    // listens on tcp://:port, or on a Unix domain socket with
+    // unix:///path or shm:///path, see NCommunicator::connect()
+    bool listen(const nstr& address);
+    
     virtual NCommunicator* create(){
       return new NCommunicator(task());
     }
@@ -81,6 +85,10 @@ namespace neu{
       return true;
     }
     
+    // called once comm has authenticated and been sent its response,
+    // after which the server no longer refers to it
+    virtual void onAuthenticated(NCommunicator* comm){}
+    
     NServer& operator=(const NServer&) = delete;
 
     NServer(const NServer&) = delete;
@@ -56,12 +56,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define NEU_N_SOCKET_H
 
 #include <strings.h>
+#include <cstring>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <poll.h>
 
 #include <neu/NResourceManager.h>
 #include <neu/global.h>
@@ -122,6 +126,33 @@ namespace neu{
       return true;
     }
     
+    // connects to a Unix domain socket at path
+    bool connectLocal(const nstr& path){
+      sockaddr_un addr;
+      
+      if(path.length() >= sizeof(addr.sun_path)){
+        return false;
+      }
+      
+      fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+      
+      if(fd_ < 0){
+        return false;
+      }
+      
+      bzero((char*)&addr, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path.c_str());
+      
+      if(::connect(fd_, (sockaddr*)&addr, sizeof(addr)) < 0){
+        return false;
+      }
+      
+      host_ = "localhost";
+      
+      return true;
+    }
+    
     void close(){
       if(fd_ >= 0){
         ::close(fd_);
@@ -196,6 +227,37 @@ namespace neu{
       return ::recv(fd_, buf, len, 0);
     }
     
+    // return true if data or a disconnect can be received without
+    // blocking, waiting at most dt seconds
+    bool poll(double dt=0){
+      pollfd pfd;
+      pfd.fd = fd_;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      
+      return ::poll(&pfd, 1, dt*1000) > 0;
+    }
+    
+    int fd() const{
+      return fd_;
+    }
+    
+    // disables Nagle's algorithm
+    bool setNoDelay(bool flag){
+      int on = flag;
+      return setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == 0;
+    }
+    
+    // while corked, partial segments are held back until uncorked
+    bool setCork(bool flag){
+      int on = flag;
+#ifdef TCP_CORK
+      return setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &on, sizeof(on)) == 0;
+#else
+      return setsockopt(fd_, IPPROTO_TCP, TCP_NOPUSH, &on, sizeof(on)) == 0;
+#endif
+    }
+    
     void setHost_(const nstr& host){
       host_ = host;
     }
@@ -215,6 +277,54 @@ namespace neu{
     static bool isLocalHost(const nstr& host){
       return host == "127.0.0.1" || host == "localhost" || host == "127.0.1.1";
     }
+    
+    // splits an address of the form tcp://host:port, unix:///path or
+    // shm:///path. for the local schemes, host is set to the path and
+    // port to -1
+    static bool parseAddress(const nstr& address,
+                             nstr& scheme,
+                             nstr& host,
+                             int& port){
+      size_t pos = address.find("://");
+      if(pos == nstr::npos){
+        return false;
+      }
+      
+      scheme = address.substr(0, pos);
+      nstr rest = address.substr(pos + 3);
+      
+      if(scheme == "unix" || scheme == "shm"){
+        host = rest;
+        port = -1;
+        return !host.empty();
+      }
+      
+      if(scheme != "tcp"){
+        return false;
+      }
+      
+      pos = rest.rfind(":");
+      if(pos == nstr::npos){
+        return false;
+      }
+      
+      host = rest.substr(0, pos);
+      nstr p = rest.substr(pos + 1);
+      
+      if(p.empty()){
+        return false;
+      }
+      
+      for(size_t i = 0; i < p.length(); ++i){
+        if(!nstr::isDigit(p[i])){
+          return false;
+        }
+      }
+      
+      port = atoi(p.c_str());
+      
+      return true;
+    }
 
     NSocket& operator=(const NSocket&) = delete;
 
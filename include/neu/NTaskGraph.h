@@ -0,0 +1,109 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#ifndef NEU_N_TASK_GRAPH_H
+#define NEU_N_TASK_GRAPH_H
+
+#include <functional>
+
+#include <neu/nvar.h>
+#include <neu/NFuture.h>
+
+namespace neu{
+  
+  class NProcTask;
+  
+  // a graph of dependent tasks, each node is queued on the task as
+  // soon as the nodes it depends on have completed, so independent
+  // nodes run in parallel
+  
+  class NTaskGraph{
+  public:
+    typedef std::function<nvar(const nvec& inputs)> Func;
+    
+    NTaskGraph(NProcTask* task);
+    
+    ~NTaskGraph();
+    
+    // adds a node which runs f with the results of the nodes in deps,
+    // in the same order, deps must have been added already, returns
+    // the index of the node
+    size_t add(const Func& f,
+               const NVector<size_t>& deps=NVector<size_t>(),
+               double priority=0);
+    
+    size_t size() const;
+    
+    // runs the graph, the returned future is set to a vector of the
+    // results of the nodes once all of them have completed. if a
+    // node throws, the nodes which depend on it, directly or not, are
+    // not run, the others still are, and the future is set to the
+    // first error. the graph may be run again once the future is
+    // ready
+    NFuture run();
+    
+    // the result of node from the last run
+    const nvar& result(size_t node) const;
+    
+    NTaskGraph& operator=(const NTaskGraph&) = delete;
+    
+    NTaskGraph(const NTaskGraph&) = delete;
+    
+  private:
+    class NTaskGraph_* x_;
+  };
+  
+} // end namespace neu
+
+#endif // NEU_N_TASK_GRAPH_H
@@ -54,15 +54,22 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <neu/NBroker.h>
 
+#include <deque>
+
 #include <neu/NProc.h>
 #include <neu/NServer.h>
 #include <neu/NBasicMutex.h>
+#include <neu/NMutex.h>
 #include <neu/NRWMutex.h>
 #include <neu/NObject.h>
 #include <neu/NClass.h>
 #include <neu/global.h>
+#include <neu/NGuard.h>
 #include <neu/NReadGuard.h>
+#include <neu/NWriteGuard.h>
 #include <neu/NServerProc.h>
+#include <neu/NError.h>
+#include <neu/NSys.h>
 
 using namespace std;
 using namespace neu;
@@ -74,21 +81,172 @@ namespace{
   static const int OP_OBTAINED = 102;
   static const int OP_CALL = 103;
   static const int OP_CALLED = 104;
+  static const int OP_CALL_BATCH = 105;
+  static const int OP_CALLED_BATCH = 106;
+  static const int OP_RELEASE = 107;
+  static const int OP_SUBSCRIBE = 108;
+  static const int OP_SUBSCRIBED = 109;
+  static const int OP_UPDATE = 110;
+  
+  // how long a new connection waits for the server to accept its
+  // authentication, in seconds
+  static const double AUTH_TIMEOUT = 30.0;
   
   class DistributedObject;
+  class Call;
+  class Replica;
+  
+  thread_local NBrokerBatch_* _batch = 0;
+  
+  // the changes from the snapshot a to b, as [s:[<key>:<value>, ...],
+  // d:[<key>:<changes>, ...], r:[<key>, ...]]: the keys set, the maps
+  // changed and the keys removed. maps are compared key by key, other
+  // values whole. d is left undefined if there are none
+  
+  bool isMap(const nvar& v){
+    return v.fullType() == nvar::Map || v.fullType() == nvar::HashMap;
+  }
+  
+  void diff(const nvar& a, const nvar& b, nvar& d){
+    bool am = isMap(a);
+    
+    nvec keys;
+    b.keys(keys);
+    
+    for(const nvar& k : keys){
+      const nvar& bk = b[k];
+      
+      if(!am || !a.has(k)){
+        d("s")(k) = bk;
+        continue;
+      }
+      
+      const nvar& ak = a[k];
+      
+      if(isMap(ak) && isMap(bk)){
+        nvar dk;
+        diff(ak, bk, dk);
+        
+        if(isMap(dk)){
+          d("d")(k) = move(dk);
+        }
+      }
+      else if(!ak.equal(bk)){
+        d("s")(k) = bk;
+      }
+    }
+    
+    if(!am){
+      return;
+    }
+    
+    keys.clear();
+    a.keys(keys);
+    
+    nvec removed;
+    
+    for(const nvar& k : keys){
+      if(!b.has(k)){
+        removed.push_back(k);
+      }
+    }
+    
+    if(!removed.empty()){
+      d("r") = move(removed);
+    }
+  }
+  
+  void patch(nvar& a, const nvar& d){
+    nvec keys;
+    
+    if(d.has("s")){
+      const nvar& s = d["s"];
+      s.keys(keys);
+      
+      for(const nvar& k : keys){
+        a(k) = s[k];
+      }
+    }
+    
+    if(d.has("d")){
+      const nvar& dd = d["d"];
+      
+      keys.clear();
+      dd.keys(keys);
+      
+      for(const nvar& k : keys){
+        patch(a(k), dd[k]);
+      }
+    }
+    
+    if(d.has("r")){
+      const nvar& r = d["r"];
+      size_t size = r.size();
+      
+      for(size_t i = 0; i < size; ++i){
+        a.erase(r[i]);
+      }
+    }
+  }
+  
+  // a connection holds a handle for each object obtained over it,
+  // each call names the handle of the object it is for. the proc
+  // hands calls to their objects and goes on receiving. the server
+  // owns the proc until it has authenticated, then it deletes itself
+  // once closed and the calls it handed over have returned
   
   class ServerProc : public NServerProc{
   public:
+    // the states of state_
+    static const int Pending = 0;
+    static const int Started = 1;
+    static const int Closed = 2;
+    
     ServerProc(NProcTask* task, NBroker_* broker);
     
     void onClose(bool manual);
     
+    void onReceive();
+    
+    void start();
+    
     void run(nvar& r);
     
+    bool process(nvar& req);
+    
+    // hands the call, or the batch of calls, in req to the objects
+    // they are on
+    void dispatch(nvar& req, bool batch);
+    
+    // sends the results once all the calls of c have run
+    void reply(Call* c);
+    
+    // sends obj's snapshot and adds the proc to its subscribers if
+    // it still holds handle
+    void subscribe(DistributedObject* obj, int64_t handle, const nvar& id);
+    
+    // called with the broker's handle mutex locked
+    void removeHandles(DistributedObject* obj);
+    
+    // held by the connection until it closes and by each call handed
+    // over. once dropped to 0 no more are taken
+    bool ref();
+    
+    void unref();
+    
   private:
+    typedef NHashMap<int64_t, DistributedObject*> HandleMap_;
+    
     NProcTask* task_;
     NBroker_* broker_;
-    DistributedObject* obj_;
+    HandleMap_ handleMap_;
+    int64_t nextHandle_;
+    atomic<size_t> count_;
+    atomic<int> state_;
+    atomic<size_t> refs_;
+    
+    // the task deletes the proc once it has run what is queued
+    void retire();
   };
   
   class Server : public NServer{
@@ -103,71 +261,420 @@ namespace{
     }
     
     bool authenticate(NCommunicator* comm, const nvar& auth);
+    
+    void onAuthenticated(NCommunicator* comm);
 
   private:
     NProcTask* task_;
     NBroker_* broker_;
   };
   
-  class Client : public NCommunicator{
+  // a local copy of a remote object, kept up to date with the changes
+  // its owner pushes. the object is restored from the snapshot on the
+  // first read after a change
+  
+  class Replica{
   public:
-    Client(NProcTask* task, NBroker_* broker);
+    Replica(const nvar& reads, double staleness)
+    : staleness_(staleness),
+    ready_(false),
+    version_(0),
+    heard_(0),
+    changed_(false),
+    obj_(0){
+      size_t size = reads.size();
+      for(size_t i = 0; i < size; ++i){
+        reads_ << reads[i].str();
+      }
+    }
+    
+    ~Replica(){
+      delete obj_;
+    }
     
-    void setObj(NObject* obj){
-      obj_ = obj;
+    bool reads(const nvar& f) const{
+      return f.isFunction() && reads_.has((*f).funcStr());
     }
     
-    NObject* obj(){
-      return obj_;
+    // resp holds the snapshot sent in response to the subscription
+    void reset(nvar& resp){
+      mutex_.lock();
+      state_ = move(resp["s"]);
+      version_ = resp["v"];
+      heard_ = NSys::now();
+      changed_ = true;
+      ready_ = true;
+      mutex_.unlock();
+    }
+    
+    // a heartbeat only holds the version. changes which do not follow
+    // the last ones put the replica out of use
+    void update(nvar& u){
+      mutex_.lock();
+      
+      if(!ready_){
+        mutex_.unlock();
+        return;
+      }
+      
+      int64_t v = u["v"];
+      
+      if(u.has("d")){
+        if(v != version_ + 1){
+          ready_ = false;
+          mutex_.unlock();
+          return;
+        }
+        
+        patch(state_, u["d"]);
+        version_ = v;
+        changed_ = true;
+      }
+      
+      heard_ = NSys::now();
+      
+      mutex_.unlock();
+    }
+    
+    // returns false if the replica is out of use or was last heard
+    // from more than staleness seconds ago
+    bool run(const nvar& f, nvar& r){
+      lock_guard<mutex> guard(mutex_.mutex());
+      
+      if(!ready_ || NSys::now() - heard_ > staleness_){
+        return false;
+      }
+      
+      if(changed_){
+        delete obj_;
+        
+        NObjectBase* o = NClass::recreate(state_);
+        obj_ = dynamic_cast<NObject*>(o);
+        
+        if(!obj_){
+          delete o;
+          ready_ = false;
+          return false;
+        }
+        
+        changed_ = false;
+      }
+      
+      r = obj_->run(f);
+      return true;
+    }
+    
+  private:
+    NHashSet<nstr> reads_;
+    double staleness_;
+    NBasicMutex mutex_;
+    bool ready_;
+    nvar state_;
+    int64_t version_;
+    double heard_;
+    bool changed_;
+    NObject* obj_;
+  };
+  
+  // one client connection is shared by the proxies of all objects
+  // obtained from the same address with the same authentication, and
+  // is deleted once they have all been released. requests are tagged
+  // with an id so that any number may be outstanding, responses are
+  // matched to them as they are received, in whatever order. until it
+  // has authenticated the client receives its responses itself
+  
+  class Client : public NCommunicator{
+  public:
+    Client(NProcTask* task, NBroker_* broker, const nstr& key);
+    
+    ~Client();
+    
+    const nstr& key() const{
+      return key_;
     }
     
+    // the number of proxies and open batches using the client
+    atomic<size_t> refs;
+    
+    bool authenticate(const nvar& auth);
+    
+    // the result is the server's response, holding the handle and
+    // class of the object
+    NFuture obtain(const nstr& objectName);
+    
+    void release(int64_t handle);
+    
+    // if batch is given, the request is appended to it rather than
+    // sent
+    NFuture call(int64_t handle, const nvar& n, nvar* batch=0);
+    
+    // the client keeps replica, which receives the snapshot and the
+    // changes pushed for handle from then on, until it is released.
+    // returns false if the object is not replicated
+    bool subscribe(int64_t handle, Replica* replica);
+    
+    void sendBatch(nvar& calls);
+    
+    void onReceive();
+    
     void onClose(bool manual);
     
   private:
+    class Call{
+    public:
+      nvar n;
+      bool obtain;
+      
+      // set for a subscription
+      Replica* replica;
+      
+      NPromise promise;
+    };
+    
+    typedef NHashMap<int64_t, Call> CallMap_;
+    typedef NHashMap<int64_t, Replica*> ReplicaMap_;
+    
     NBroker_* broker_;
-    NObject* obj_;
+    nstr key_;
+    atomic_bool ready_;
+    atomic<int64_t> nextId_;
+    CallMap_ callMap_;
+    NBasicMutex callMutex_;
+    ReplicaMap_ replicaMap_;
+    NBasicMutex replicaMutex_;
+    
+    NFuture add(int64_t id, const nvar& n, bool obtain, Replica* replica=0);
+    
+    void update(nvar& u);
+    
+    void complete(nvar& resp);
+    
+    // fails the call with id if it is still outstanding
+    void fail(int64_t id);
+    
+    void failAll();
+    
+    static NError error(const Call& c);
+  };
+  
+  class Proxy{
+  public:
+    Client* client;
+    int64_t handle;
+    
+    // owned by the client, 0 unless subscribed
+    Replica* replica;
+  };
+  
+  // run by a dispatcher on an object under its policy, deletes
+  // itself once done
+  
+  class Job{
+  public:
+    virtual ~Job(){}
+    
+    bool readOnly;
+    
+    virtual void execute() = 0;
+  };
+  
+  // a call received by a server proc, or a batch of them. the calls
+  // of a batch run one after the other, each is handed to its object
+  // once the one before it has returned
+  
+  class Call : public Job{
+  public:
+    ServerProc* proc;
+    bool batch;
+    nvar calls;
+    nvar results;
+    
+    // the objects the calls are on with a reference taken, 0 where
+    // the handle was not found
+    NVector<DistributedObject*> objects;
+    
+    // the call to run next, readOnly is for it
+    size_t i;
+    
+    // runs calls[i] then moves on to the next, which may be handed
+    // to the same object again
+    void execute();
+    
+    // hands calls[i] to its object, or replies once all have run
+    void next();
+  };
+  
+  // stores the object and pushes the changes to its replicas
+  
+  class Publish : public Job{
+  public:
+    Publish(DistributedObject* o)
+    : o_(o){
+      readOnly = true;
+    }
+    
+    void execute();
+    
+  private:
+    DistributedObject* o_;
+  };
+  
+  // sends the snapshot to a new subscriber, between the publishes
+  
+  class Subscribe : public Job{
+  public:
+    Subscribe(ServerProc* proc,
+              DistributedObject* o,
+              int64_t handle,
+              const nvar& id)
+    : proc_(proc),
+    o_(o),
+    handle_(handle),
+    id_(id){
+      readOnly = true;
+    }
+    
+    void execute();
+    
+  private:
+    ServerProc* proc_;
+    DistributedObject* o_;
+    int64_t handle_;
+    nvar id_;
+  };
+  
+  // runs the calls on an object under its policy. concurrent calls
+  // are queued on the task as they arrive. the others wait in a queue
+  // drained by one run of the proc at a time, as an actor. under
+  // ReadWrite, the read-only calls at the front of the queue are
+  // queued on the task together and the queue is not drained further
+  // until they have all returned. an item of the proc is a job to
+  // run, or undefined to drain the queue
+  
+  class Dispatcher : public NProc{
+  public:
+    Dispatcher(NProcTask* task, NBroker::Policy policy)
+    : task_(task),
+    policy_(policy),
+    running_(false),
+    readers_(0){}
+    
+    void dispatch(Job* j);
+    
+    void run(nvar& r);
+    
+    // the task deletes the proc once it has run what is queued
+    void retire(){
+      if(task_->terminate(this)){
+        delete this;
+      }
+    }
+    
+  private:
+    // the jobs drained by a run before it queues the proc again, so
+    // that a busy object leaves workers to the others
+    static const size_t MaxRun = 64;
+    
+    NProcTask* task_;
+    NBroker::Policy policy_;
+    NBasicMutex mutex_;
+    deque<Job*> queue_;
+    
+    // set while the queue is being drained or readers are out
+    bool running_;
+    size_t readers_;
+    
+    void drain();
+    
+    void queueDrain(){
+      nvar r;
+      task_->queue(this, r);
+    }
   };
   
   class DistributedObject{
   public:
-    DistributedObject(NProcTask* task)
-    : task_(task){}
+    DistributedObject(NProcTask* task, NBroker::Policy policy)
+    : obj(0),
+    refs(1),
+    dispatcher(new Dispatcher(task, policy)),
+    replicated(false),
+    timer(0),
+    version(0){}
     
     nstr className;
     NObject* obj;
     
-    ~DistributedObject(){
-      revoke();
-    }
+    // under ReadWrite, the names of the read-only methods
+    NHashSet<nstr> readOnly;
     
-    void addServerProc(ServerProc* proc){
-      mutex_.lock();
-      serverProcs_.add(proc);
-      mutex_.unlock();
+    // held by the broker while it is distributed and by the calls on
+    // it
+    atomic<size_t> refs;
+    
+    Dispatcher* dispatcher;
+    
+    // the server procs holding handles to it, guarded by the broker's
+    // handle mutex
+    NHashSet<ServerProc*> serverProcs;
+    
+    // set once replicated, then published by timer
+    atomic_bool replicated;
+    uint64_t timer;
+    
+    // the subscribed server procs and the handles their replicas are
+    // for, the last snapshot published and its version. guarded by
+    // the replica mutex
+    NVector<pair<ServerProc*, int64_t>> subscribers;
+    nvar published;
+    int64_t version;
+    NBasicMutex replicaMutex;
+    
+    // publishes run as read-only calls, so may run in parallel. each
+    // must diff against the snapshot the one before it published
+    NBasicMutex publishMutex;
+    
+    // called through the dispatcher
+    void subscribe(ServerProc* proc, int64_t handle, const nvar& id);
+    
+    // removes the subscriptions of proc, or only that of handle if it
+    // is not negative, or all if proc is 0
+    void unsubscribe(ServerProc* proc, int64_t handle=-1);
+    
+    // called through the dispatcher
+    void publish();
+    
+    bool isReadOnly(const nvar& f) const{
+      return f.isFunction() && readOnly.has((*f).funcStr());
     }
     
-    void removeServerProc(ServerProc* proc){
-      mutex_.lock();
-      serverProcs_.erase(proc);
-      mutex_.unlock();
+    void unref(){
+      if(--refs == 0){
+        dispatcher->retire();
+        delete this;
+      }
     }
+  };
+  
+  // queued every interval for each replicated object, with its name.
+  // once detached, runs do nothing
+  
+  class PublishProc : public NProc{
+  public:
+    PublishProc(NBroker_* broker)
+    : broker_(broker){}
+    
+    void run(nvar& r);
     
-    void revoke(){
+    // waits for a run in progress
+    void detach(){
       mutex_.lock();
-      for(ServerProc* serverProc : serverProcs_){
-        serverProc->close();
-        if(task_->terminate(serverProc)){
-          delete serverProc;
-        }
-      }
+      broker_ = 0;
       mutex_.unlock();
     }
     
   private:
-    typedef NHashSet<ServerProc*> ServerProcSet_;
-
-    NProcTask* task_;
-    ServerProcSet_ serverProcs_;
+    NBroker_* broker_;
     NBasicMutex mutex_;
   };
   
@@ -175,18 +682,68 @@ namespace{
 
 namespace neu{
   
+  // holds the calls made on a thread while it has a batch open, in
+  // a list for each connection, which the batch holds a reference to
+  
+  class NBrokerBatch_{
+  public:
+    NBrokerBatch_(NBroker_* broker)
+    : broker_(broker),
+    prev_(_batch){
+      _batch = this;
+    }
+    
+    ~NBrokerBatch_(){
+      send();
+      _batch = prev_;
+    }
+    
+    NBroker_* broker(){
+      return broker_;
+    }
+    
+    nvar& calls(Client* client){
+      auto itr = callMap_.find(client);
+      if(itr != callMap_.end()){
+        return itr->second;
+      }
+      
+      ++client->refs;
+      
+      nvar& calls = callMap_[client];
+      calls = nvec();
+      return calls;
+    }
+    
+    void send();
+    
+  private:
+    typedef NHashMap<Client*, nvar> CallMap_;
+    
+    NBroker_* broker_;
+    NBrokerBatch_* prev_;
+    CallMap_ callMap_;
+  };
+  
   class NBroker_{
   public:
     
     NBroker_(NBroker* o, NProcTask* task)
     : o_(o),
     task_(task),
-    server_(0),
-    encoder_(0){}
+    encoder_(0),
+    minCompressSize_(1024),
+    publishProc_(new PublishProc(this)){}
     
     ~NBroker_(){
-      if(server_){
-        delete server_;
+      for(Server* server : servers_){
+        delete server;
+      }
+      
+      publishProc_->detach();
+      
+      if(task_->terminate(publishProc_)){
+        delete publishProc_;
       }
     }
     
@@ -195,69 +752,201 @@ namespace neu{
     }
     
     bool listen(int port){
-      server_ = new Server(task_, this);
-      if(server_->listen(port)){
+      return listen(nstr("tcp://:") + nvar(port).toStr());
+    }
+    
+    // may be called for each address to listen on
+    bool listen(const nstr& address){
+      Server* server = new Server(task_, this);
+      if(server->listen(address)){
+        servers_.push_back(server);
         return true;
       }
       
-      delete server_;
-      server_ = 0;
+      delete server;
       return false;
     }
     
     void distribute(NObject* object,
                     const nstr& className,
-                    const nstr& objectName){
-      DistributedObject* o = new DistributedObject(task_);
+                    const nstr& objectName,
+                    NBroker::Policy policy,
+                    const nvar& readOnly){
+      DistributedObject* o = new DistributedObject(task_, policy);
       o->className = className;
       o->obj = object;
       
+      if(policy == NBroker::ReadWrite){
+        if(readOnly.isNone()){
+          constMethods(className, o->readOnly);
+        }
+        else{
+          size_t size = readOnly.size();
+          for(size_t i = 0; i < size; ++i){
+            o->readOnly << readOnly[i].str();
+          }
+        }
+      }
+      
       serverMutex_.writeLock();
       distributedObjectMap_[objectName] = o;
       serverMutex_.unlock();
     }
     
+    // the methods neu-meta found to be const, under every number of
+    // arguments they take
+    static void constMethods(const nstr& className, NHashSet<nstr>& names){
+      NClass* c = NClass::getClass(className);
+      if(!c){
+        return;
+      }
+      
+      const nvar& md = c->metadata();
+      if(!md.has(c->name()) || !md[c->name()].has("methods")){
+        return;
+      }
+      
+      const nvar& methods = md[c->name()]["methods"];
+      
+      nvec keys;
+      methods.keys(keys);
+      
+      NHashSet<nstr> mutating;
+      
+      for(const nvar& k : keys){
+        nstr name = k[0].str();
+        
+        if(methods[k].get("const", false)){
+          names << name;
+        }
+        else{
+          mutating << name;
+        }
+      }
+      
+      for(const nstr& name : mutating){
+        names.erase(name);
+      }
+    }
+    
+    // connections stay open, calls on handles to the object fail.
+    // calls already handed to it still run
     void revoke(const nstr& objectName){
-      serverMutex_.readLock();
+      serverMutex_.writeLock();
       auto itr = distributedObjectMap_.find(objectName);
       assert(itr != distributedObjectMap_.end());
+      DistributedObject* o = itr->second;
       distributedObjectMap_.erase(itr);
       serverMutex_.unlock();
       
-      DistributedObject* o = itr->second;
-      o->revoke();
-      delete o;
+      if(o->timer){
+        task_->cancel(o->timer);
+      }
+      
+      handleMutex_.writeLock();
+      for(ServerProc* proc : o->serverProcs){
+        proc->removeHandles(o);
+      }
+      o->unsubscribe(0);
+      handleMutex_.unlock();
+      
+      o->unref();
     }
     
-    NObject* obtain(const nstr& host,
-                    int port,
-                    const nstr& objectName,
-                    const nvar& auth){
-      
-      Client* client = new Client(task_, this);
-      client->setEncoder(encoder_);
+    void replicate(const nstr& objectName, double interval){
+      NWriteGuard guard(serverMutex_);
       
-      if(!client->connect(host, port)){
-        delete client;
+      auto itr = distributedObjectMap_.find(objectName);
+      assert(itr != distributedObjectMap_.end());
+      DistributedObject* o = itr->second;
+      
+      if(o->replicated){
+        return;
+      }
+      
+      o->replicated = true;
+      o->timer = task_->queueEvery(publishProc_, objectName, interval);
+    }
+    
+    void publish(const nstr& objectName){
+      DistributedObject* o = acquire(objectName);
+      
+      if(o){
+        o->dispatcher->dispatch(new Publish(o));
+      }
+    }
+    
+    // returns the object with a reference taken, or 0 if it is not
+    // distributed
+    DistributedObject* acquire(const nstr& objectName){
+      NReadGuard guard(serverMutex_);
+      
+      auto itr = distributedObjectMap_.find(objectName);
+      if(itr == distributedObjectMap_.end()){
         return 0;
       }
-
-      nvar a = auth;
-      client->send(a);
-      nvar authResp;
-      if(!client->receive(authResp) || !authResp){
-        delete client;
+      
+      DistributedObject* o = itr->second;
+      ++o->refs;
+      return o;
+    }
+    
+    bool subscribe(NObject* proxy, const nvar& reads, double staleness){
+      clientMutex_.readLock();
+      
+      auto itr = proxyMap_.find(proxy);
+      assert(itr != proxyMap_.end());
+      
+      Proxy p = itr->second;
+      
+      clientMutex_.unlock();
+      
+      if(p.replica){
+        return true;
+      }
+      
+      Replica* r = new Replica(reads, staleness);
+      
+      if(!p.client->subscribe(p.handle, r)){
+        return false;
+      }
+      
+      clientMutex_.writeLock();
+      
+      itr = proxyMap_.find(proxy);
+      if(itr != proxyMap_.end()){
+        itr->second.replica = r;
+      }
+      
+      clientMutex_.unlock();
+      
+      return true;
+    }
+    
+    NObject* obtain(const nstr& host,
+                    int port,
+                    const nstr& objectName,
+                    const nvar& auth){
+      return obtain("tcp://" + host + ":" + nvar(port).toStr(),
+                    objectName, auth);
+    }
+    
+    NObject* obtain(const nstr& address,
+                    const nstr& objectName,
+                    const nvar& auth){
+      
+      Client* client = connect(address, auth);
+      if(!client){
         return 0;
       }
       
-      nvar req;
-      req("op") = OP_OBTAIN;
-      req("o") = objectName;
-      client->send(req);
-
       nvar resp;
-      if(!client->receive(resp) || resp["op"] != OP_OBTAINED){
-        delete client;
+      
+      try{
+        resp = client->obtain(objectName).get();
+      }
+      catch(NError& e){
+        unref(client);
         return 0;
       }
       
@@ -266,13 +955,16 @@ namespace neu{
       NObject* obj = NClass::createRemote(className, o_);
       
       if(!obj){
-        delete client;
+        client->release(resp["h"]);
+        unref(client);
         NERROR("failed to create remote object of class: " + className);
       }
       
-      client->setObj(obj);
       clientMutex_.writeLock();
-      objectClientMap_.insert({obj, client});
+      Proxy& p = proxyMap_[obj];
+      p.client = client;
+      p.handle = resp["h"];
+      p.replica = 0;
       clientMutex_.unlock();
       
       return obj;
@@ -281,16 +973,18 @@ namespace neu{
     void release(NObject* object){
       clientMutex_.writeLock();
       
-      auto itr = objectClientMap_.find(object);
-      if(itr == objectClientMap_.end()){
+      auto itr = proxyMap_.find(object);
+      if(itr == proxyMap_.end()){
         clientMutex_.unlock();
         return;
       }
       
-      Client* client = itr->second;
-      objectClientMap_.erase(itr);
+      Proxy p = itr->second;
+      proxyMap_.erase(itr);
       clientMutex_.unlock();
-      delete client;
+      
+      p.client->release(p.handle);
+      unref(p.client);
     }
     
     void setLogStream(std::ostream& ostr){
@@ -309,38 +1003,56 @@ namespace neu{
       return encoder_;
     }
     
+    void setMinCompressSize(size_t n){
+      minCompressSize_ = n;
+    }
+    
+    size_t minCompressSize(){
+      return minCompressSize_;
+    }
+    
     nvar process_(NObject* obj, const nvar& n){
+      NFuture f = processAsync_(obj, n);
+      
+      if(_batch && _batch->broker() == this){
+        _batch->send();
+      }
+      
+      return f.get();
+    }
+    
+    NFuture processAsync_(NObject* obj, const nvar& n){
       NReadGuard guard(clientMutex_);
       
-      auto itr = objectClientMap_.find(obj);
-      assert(itr != objectClientMap_.end());
-
-      Client* client = itr->second;
+      auto itr = proxyMap_.find(obj);
+      assert(itr != proxyMap_.end());
       
-      nvar req;
-      req("op") = OP_CALL;
-      req("f") = n;
-
-      client->send(req);
+      const Proxy& p = itr->second;
       
-      nvar resp;
-      if(!client->receive(resp) || resp["op"] != OP_CALLED){
-        NERROR("failed to remote process: " + n);
+      // reads are answered by the replica while it is fresh
+      if(p.replica && p.replica->reads(n)){
+        nvar r;
+        
+        if(p.replica->run(n, r)){
+          NPromise promise;
+          promise.set(move(r));
+          return promise.future();
+        }
       }
       
-      nvar& f = resp["f"];
-      size_t size = n.size();
-
-      for(size_t i = 0; i < size; ++i){
-        if(n[i].fullType() == nvar::Pointer){
-          *n[i] = move(f[i]);
-        }
+      if(_batch && _batch->broker() == this){
+        return p.client->call(p.handle, n, &_batch->calls(p.client));
       }
       
-      return resp["r"];
+      return p.client->call(p.handle, n);
+    }
+    
+    NRWMutex& handleMutex(){
+      return handleMutex_;
     }
     
-    DistributedObject* obtain_(ServerProc* proc, const nstr& objName){
+    // called with the handle mutex locked
+    DistributedObject* find_(const nstr& objName){
       NReadGuard guard(serverMutex_);
       
       auto itr = distributedObjectMap_.find(objName);
@@ -348,101 +1060,678 @@ namespace neu{
         return 0;
       }
       
-      DistributedObject* o = itr->second;
-      o->addServerProc(proc);
-      return o;
+      return itr->second;
+    }
+    
+    // a closed connection is no longer shared, its proxies are kept
+    // until they are released, calls on them fail
+    void removeClient(Client* client){
+      clientMutex_.writeLock();
+      
+      auto itr = clientMap_.find(client->key());
+      if(itr != clientMap_.end() && itr->second == client){
+        clientMap_.erase(itr);
+      }
+      
+      clientMutex_.unlock();
     }
     
-    void removeClient(NObject* obj){
+    void unref(Client* client){
       clientMutex_.writeLock();
-      auto itr = objectClientMap_.find(obj);
-      objectClientMap_.erase(itr);
+      
+      if(--client->refs > 0){
+        clientMutex_.unlock();
+        return;
+      }
+      
+      auto itr = clientMap_.find(client->key());
+      if(itr != clientMap_.end() && itr->second == client){
+        clientMap_.erase(itr);
+      }
+      
       clientMutex_.unlock();
-      delete obj;
-      // ndm - need to delete the client
+      
+      delete client;
     }
     
   private:
-    typedef NHashMap<NObject*, Client*> ObjectClientMap_;
+    typedef NHashMap<NObject*, Proxy> ProxyMap_;
+    typedef NHashMap<nstr, Client*> ClientMap_;
+    typedef NHashMap<nstr, NFuture> ConnectMap_;
     typedef NHashMap<nstr, DistributedObject*> DistributedObjectMap_;
     
     NBroker* o_;
     NProcTask* task_;
-    Server* server_;
+    NVector<Server*> servers_;
     NCommunicator::Encoder* encoder_;
-    ObjectClientMap_ objectClientMap_;
+    size_t minCompressSize_;
+    ProxyMap_ proxyMap_;
+    ClientMap_ clientMap_;
+    ConnectMap_ connectMap_;
     DistributedObjectMap_ distributedObjectMap_;
     ostream* logStream_;
     NRWMutex clientMutex_;
     NRWMutex serverMutex_;
+    NRWMutex handleMutex_;
+    PublishProc* publishProc_;
+    
+    // returns the connection for address and auth with a reference
+    // taken, connecting and authenticating if there is none. while a
+    // connection is being made, concurrent obtains for the same
+    // address and auth wait for it in the connect map, and share it.
+    // no lock is held while connecting
+    Client* connect(const nstr& address, const nvar& auth){
+      nstr key = address + ":" + auth.toStr();
+      
+      for(;;){
+        clientMutex_.writeLock();
+        
+        auto itr = clientMap_.find(key);
+        if(itr != clientMap_.end()){
+          Client* client = itr->second;
+          
+          if(client->isConnected()){
+            ++client->refs;
+            clientMutex_.unlock();
+            return client;
+          }
+          
+          clientMap_.erase(itr);
+        }
+        
+        auto citr = connectMap_.find(key);
+        if(citr == connectMap_.end()){
+          break;
+        }
+        
+        NFuture f = citr->second;
+        
+        clientMutex_.unlock();
+        
+        if(!f.get()){
+          return 0;
+        }
+      }
+      
+      NPromise p;
+      connectMap_.insert({key, p.future()});
+      
+      clientMutex_.unlock();
+      
+      Client* client = new Client(task_, this, key);
+      client->setEncoder(encoder_);
+      client->setMinCompressSize(minCompressSize_);
+      
+      bool connected = client->connect(address) && client->authenticate(auth);
+      
+      clientMutex_.writeLock();
+      
+      connectMap_.erase(key);
+      
+      if(connected){
+        client->refs = 1;
+        clientMap_[key] = client;
+      }
+      
+      clientMutex_.unlock();
+      
+      p.set(connected);
+      
+      if(!connected){
+        delete client;
+        return 0;
+      }
+      
+      return client;
+    }
   };
   
 } // end namespace neu
 
-void ServerProc::run(nvar& r){
-  nvar req;
-  if(!receive(req, _timeout)){
-    signal(task_, this);
+void NBrokerBatch_::send(){
+  for(auto& itr : callMap_){
+    Client* client = itr.first;
+    client->sendBatch(itr.second);
+    broker_->unref(client);
+  }
+  
+  callMap_.clear();
+}
+
+// the proc is queued when count_ becomes non-zero, counting the
+// messages received once it has started and start() itself. each
+// pass drains all messages without waiting rather than one per
+// count, as onReceive() for a message may come after it was drained.
+// the authentication message may be consumed before its onReceive()
+
+void ServerProc::onReceive(){
+  if(state_ == Started && count_++ == 0){
+    task_->queue(this);
+  }
+}
+
+// a proc closed before it started is deleted here, as the server
+// still referred to it
+
+void ServerProc::start(){
+  int s = Pending;
+  if(!state_.compare_exchange_strong(s, Started)){
+    retire();
     return;
   }
   
+  if(count_++ == 0){
+    task_->queue(this);
+  }
+}
+
+void ServerProc::retire(){
+  if(task_->terminate(this)){
+    delete this;
+  }
+}
+
+// a call received after the connection has closed is dropped
+
+bool ServerProc::ref(){
+  size_t r = refs_;
+  
+  do{
+    if(r == 0){
+      return false;
+    }
+  } while(!refs_.compare_exchange_weak(r, r + 1));
+  
+  return true;
+}
+
+void ServerProc::unref(){
+  if(--refs_ == 0){
+    retire();
+  }
+}
+
+void ServerProc::run(nvar& r){
+  size_t count;
+  
+  do{
+    count = count_;
+    
+    for(;;){
+      nvar req;
+      if(!receive(req, 0)){
+        break;
+      }
+      
+      if(!process(req)){
+        return;
+      }
+    }
+  } while(count_.fetch_sub(count) != count);
+}
+
+bool ServerProc::process(nvar& req){
   int op = req["op"];
 
   switch(op){
     case OP_OBTAIN:{
-      obj_ = broker_->obtain_(this, req["o"]);
+      nvar resp;
+      resp("id") = req["id"];
       
-      if(!obj_){
-        close();
-        return;
+      NRWMutex& mutex = broker_->handleMutex();
+      mutex.writeLock();
+      
+      DistributedObject* o = broker_->find_(req["o"]);
+      
+      if(o){
+        int64_t h = nextHandle_++;
+        handleMap_[h] = o;
+        o->serverProcs.add(this);
+        
+        resp("op") = OP_OBTAINED;
+        resp("h") = h;
+        resp("c") = o->className;
+      }
+      else{
+        resp("op") = OP_ERROR;
       }
       
-      nvar resp;
-      resp("op") = OP_OBTAINED;
-      resp("c") = obj_->className;
+      mutex.unlock();
+      
       send(resp);
       break;
     }
-    case OP_CALL:{
-      if(!obj_){
-        close();
-        return;
+    case OP_RELEASE:{
+      NWriteGuard guard(broker_->handleMutex());
+      
+      auto itr = handleMap_.find(req["h"]);
+      if(itr == handleMap_.end()){
+        break;
       }
       
-      nvar& f = req["f"];
+      DistributedObject* o = itr->second;
+      handleMap_.erase(itr);
       
-      nvar resp;
-      try{
-        resp("r") = obj_->obj->run(f);
+      o->unsubscribe(this, req["h"]);
+      
+      for(auto& h : handleMap_){
+        if(h.second == o){
+          return true;
+        }
       }
-      catch(NError& e){
-        resp("op") = OP_ERROR;
-        send(resp);
+      
+      o->serverProcs.erase(this);
+      break;
+    }
+    case OP_SUBSCRIBE:{
+      DistributedObject* o = 0;
+      
+      NRWMutex& mutex = broker_->handleMutex();
+      mutex.readLock();
+      
+      auto itr = handleMap_.find(req["h"]);
+      if(itr != handleMap_.end() && itr->second->replicated){
+        o = itr->second;
+        ++o->refs;
+      }
+      
+      mutex.unlock();
+      
+      if(o && ref()){
+        o->dispatcher->dispatch(new Subscribe(this, o, req["h"], req["id"]));
         break;
       }
       
-      resp("op") = OP_CALLED;
-      resp("f") = move(f);
+      if(o){
+        o->unref();
+      }
       
+      nvar resp;
+      resp("op") = OP_ERROR;
+      resp("id") = req["id"];
       send(resp);
       break;
     }
+    case OP_CALL:
+      dispatch(req, false);
+      break;
+    case OP_CALL_BATCH:
+      dispatch(req, true);
+      break;
+  }
+  
+  return true;
+}
+
+// the objects of all the calls of a batch are looked up as it is
+// received, so that the handles it uses may be released right after
+
+void ServerProc::dispatch(nvar& req, bool batch){
+  if(!ref()){
+    return;
+  }
+  
+  Call* c = new Call;
+  c->proc = this;
+  c->batch = batch;
+  c->i = 0;
+  c->readOnly = false;
+  
+  if(batch){
+    c->calls = move(req["c"]);
+  }
+  else{
+    c->calls = nvec();
+    c->calls << move(req);
+  }
+  
+  size_t size = c->calls.size();
+  c->results = nvec(size);
+  
+  NRWMutex& mutex = broker_->handleMutex();
+  mutex.readLock();
+  
+  for(size_t i = 0; i < size; ++i){
+    auto itr = handleMap_.find(c->calls[i]["o"]);
+    
+    if(itr == handleMap_.end()){
+      c->objects.push_back(0);
+    }
+    else{
+      DistributedObject* o = itr->second;
+      ++o->refs;
+      c->objects.push_back(o);
+    }
+  }
+  
+  mutex.unlock();
+  
+  c->next();
+}
+
+void ServerProc::reply(Call* c){
+  if(c->batch){
+    nvar resp;
+    resp("op") = OP_CALLED_BATCH;
+    resp("c") = move(c->results);
+    send(resp);
+  }
+  else{
+    send(c->results[0]);
+  }
+  
+  delete c;
+  
+  unref();
+}
+
+void ServerProc::subscribe(DistributedObject* obj,
+                           int64_t handle,
+                           const nvar& id){
+  NReadGuard guard(broker_->handleMutex());
+  
+  auto itr = handleMap_.find(handle);
+  
+  if(itr == handleMap_.end() || itr->second != obj){
+    nvar resp;
+    resp("op") = OP_ERROR;
+    resp("id") = id;
+    send(resp);
+    return;
+  }
+  
+  obj->subscribe(this, handle, id);
+}
+
+// a call on a handle which was not found is answered with an error
+// of its own, so that calls in a batch fail separately
+
+void Call::next(){
+  size_t size = calls.size();
+  
+  while(i < size && !objects[i]){
+    nvar& resp = results[i];
+    resp("id") = calls[i]["id"];
+    resp("op") = OP_ERROR;
+    ++i;
+  }
+  
+  if(i == size){
+    proc->reply(this);
+    return;
+  }
+  
+  DistributedObject* o = objects[i];
+  readOnly = o->isReadOnly(calls[i]["f"]);
+  o->dispatcher->dispatch(this);
+}
+
+void Dispatcher::dispatch(Job* j){
+  if(policy_ == NBroker::Concurrent){
+    nvar r = (void*)j;
+    task_->queue(this, r);
+    return;
+  }
+  
+  mutex_.lock();
+  queue_.push_back(j);
+  
+  if(running_){
+    mutex_.unlock();
+    return;
   }
   
-  signal(task_, this);
+  running_ = true;
+  mutex_.unlock();
+  
+  queueDrain();
+}
+
+// the last reader of a run to return drains the queue again
+
+void Dispatcher::run(nvar& r){
+  if(!r.isDefined()){
+    drain();
+    return;
+  }
+  
+  r.ptr<Job>()->execute();
+  
+  if(policy_ != NBroker::ReadWrite){
+    return;
+  }
+  
+  mutex_.lock();
+  bool last = --readers_ == 0;
+  mutex_.unlock();
+  
+  if(last){
+    drain();
+  }
+}
+
+void Dispatcher::drain(){
+  for(size_t n = 0; n < MaxRun; ++n){
+    mutex_.lock();
+    
+    if(queue_.empty()){
+      running_ = false;
+      mutex_.unlock();
+      return;
+    }
+    
+    Job* j = queue_.front();
+    queue_.pop_front();
+    
+    if(j->readOnly && policy_ == NBroker::ReadWrite &&
+       !queue_.empty() && queue_.front()->readOnly){
+      NVector<NProc*> procs;
+      nvec rs;
+      
+      procs.push_back(this);
+      rs.push_back((void*)j);
+      
+      while(!queue_.empty() && queue_.front()->readOnly){
+        procs.push_back(this);
+        rs.push_back((void*)queue_.front());
+        queue_.pop_front();
+      }
+      
+      readers_ = rs.size();
+      mutex_.unlock();
+      
+      task_->queueBatch(procs, rs);
+      return;
+    }
+    
+    mutex_.unlock();
+    
+    j->execute();
+  }
+  
+  queueDrain();
+}
+
+void Call::execute(){
+  DistributedObject* o = objects[i];
+  
+  nvar& req = calls[i];
+  nvar& resp = results[i];
+  resp("id") = req["id"];
+  
+  nvar& f = req["f"];
+  
+  try{
+    resp("r") = o->obj->run(f);
+    resp("op") = OP_CALLED;
+    resp("f") = move(f);
+  }
+  catch(NError& e){
+    resp("op") = OP_ERROR;
+  }
+  
+  objects[i] = 0;
+  o->unref();
+  
+  ++i;
+  next();
+}
+
+void Publish::execute(){
+  o_->publish();
+  o_->unref();
+  delete this;
+}
+
+void Subscribe::execute(){
+  proc_->subscribe(o_, handle_, id_);
+  proc_->unref();
+  o_->unref();
+  delete this;
+}
+
+// the first subscriber after a publish with none stores a snapshot,
+// the changes published next are from it
+
+void DistributedObject::subscribe(ServerProc* proc,
+                                  int64_t handle,
+                                  const nvar& id){
+  NBasicGuard guard(publishMutex);
+  
+  replicaMutex.lock();
+  
+  if(!isMap(published)){
+    nvar s;
+    obj->store(s);
+    published = s.copy();
+  }
+  
+  subscribers.push_back({proc, handle});
+  
+  nvar resp;
+  resp("op") = OP_SUBSCRIBED;
+  resp("id") = id;
+  resp("v") = version;
+  resp("s") = published;
+  
+  proc->send(resp);
+  
+  replicaMutex.unlock();
+}
+
+void DistributedObject::unsubscribe(ServerProc* proc, int64_t handle){
+  replicaMutex.lock();
+  
+  if(!proc){
+    subscribers.clear();
+    replicaMutex.unlock();
+    return;
+  }
+  
+  auto itr = subscribers.begin();
+  
+  while(itr != subscribers.end()){
+    if(itr->first == proc && (handle < 0 || itr->second == handle)){
+      itr = subscribers.erase(itr);
+    }
+    else{
+      ++itr;
+    }
+  }
+  
+  replicaMutex.unlock();
+}
+
+// the object is only stored while it has subscribers. an unchanged
+// object is published as a heartbeat, which tells the replicas they
+// are still up to date. the replica mutex is not held while storing
+// and diffing, so that subscribers can be removed meanwhile
+
+void DistributedObject::publish(){
+  NBasicGuard guard(publishMutex);
+  
+  replicaMutex.lock();
+  
+  if(subscribers.empty()){
+    published = nvar();
+    replicaMutex.unlock();
+    return;
+  }
+  
+  replicaMutex.unlock();
+  
+  // the stored symbols refer to those of the object
+  nvar s;
+  obj->store(s);
+  s = s.copy();
+  
+  nvar d;
+  diff(published, s, d);
+  
+  replicaMutex.lock();
+  
+  nvar u;
+  u("op") = OP_UPDATE;
+  
+  if(isMap(d)){
+    u("v") = ++version;
+    u("d") = move(d);
+    published = move(s);
+  }
+  else{
+    u("v") = version;
+  }
+  
+  for(auto& sub : subscribers){
+    nvar m = u;
+    m("h") = sub.second;
+    sub.first->send(m);
+  }
+  
+  replicaMutex.unlock();
+}
+
+void ServerProc::removeHandles(DistributedObject* obj){
+  auto itr = handleMap_.begin();
+  
+  while(itr != handleMap_.end()){
+    if(itr->second == obj){
+      itr = handleMap_.erase(itr);
+    }
+    else{
+      ++itr;
+    }
+  }
 }
 
 ServerProc::ServerProc(NProcTask* task, NBroker_* broker)
 : NServerProc(task),
 task_(task),
 broker_(broker),
-obj_(0){
+nextHandle_(0),
+count_(0),
+state_(Pending),
+refs_(1){
   setEncoder(broker_->encoder());
+  setMinCompressSize(broker_->minCompressSize());
 }
 
 void ServerProc::onClose(bool manual){
-  obj_->removeServerProc(this);
-  terminate();
+  broker_->handleMutex().writeLock();
+  
+  for(auto& itr : handleMap_){
+    itr.second->serverProcs.erase(this);
+    itr.second->unsubscribe(this);
+  }
+  
+  handleMap_.clear();
+  
+  broker_->handleMutex().unlock();
+  
+  int s = Pending;
+  if(!state_.compare_exchange_strong(s, Closed)){
+    unref();
+  }
 }
 
 bool Server::authenticate(NCommunicator* comm, const nvar& auth){
@@ -450,20 +1739,334 @@ bool Server::authenticate(NCommunicator* comm, const nvar& auth){
     return false;
   }
 
-  ServerProc* proc = static_cast<ServerProc*>(comm);
-  task_->queue(proc);
-  
   return true;
 }
 
-Client::Client(NProcTask* task, NBroker_* broker)
+void PublishProc::run(nvar& r){
+  NBasicGuard guard(mutex_);
+  
+  if(broker_){
+    broker_->publish(r.str());
+  }
+}
+
+void Server::onAuthenticated(NCommunicator* comm){
+  static_cast<ServerProc*>(comm)->start();
+}
+
+Client::Client(NProcTask* task, NBroker_* broker, const nstr& key)
 : NCommunicator(task),
-broker_(broker){
+refs(0),
+broker_(broker),
+key_(key),
+ready_(false),
+nextId_(0){
+  
+}
+
+Client::~Client(){
+  failAll();
+  
+  for(auto& itr : replicaMap_){
+    delete itr.second;
+  }
+}
+
+bool Client::authenticate(const nvar& auth){
+  nvar a = auth;
+  send(a);
+  
+  nvar resp;
+  if(!receive(resp, AUTH_TIMEOUT) || !resp){
+    return false;
+  }
+  
+  ready_ = true;
+  return true;
+}
+
+NFuture Client::obtain(const nstr& objectName){
+  int64_t id = nextId_++;
+  
+  NFuture f = add(id, objectName, true);
+  
+  nvar req;
+  req("op") = OP_OBTAIN;
+  req("id") = id;
+  req("o") = objectName;
+  
+  send(req);
   
+  if(!isConnected()){
+    fail(id);
+  }
+  
+  return f;
+}
+
+void Client::release(int64_t handle){
+  replicaMutex_.lock();
+  auto itr = replicaMap_.find(handle);
+  if(itr != replicaMap_.end()){
+    delete itr->second;
+    replicaMap_.erase(itr);
+  }
+  replicaMutex_.unlock();
+  
+  nvar req;
+  req("op") = OP_RELEASE;
+  req("h") = handle;
+  
+  send(req);
+}
+
+bool Client::subscribe(int64_t handle, Replica* replica){
+  replicaMutex_.lock();
+  replicaMap_[handle] = replica;
+  replicaMutex_.unlock();
+  
+  int64_t id = nextId_++;
+  
+  NFuture f = add(id, handle, false, replica);
+  
+  nvar req;
+  req("op") = OP_SUBSCRIBE;
+  req("id") = id;
+  req("h") = handle;
+  
+  send(req);
+  
+  if(!isConnected()){
+    fail(id);
+  }
+  
+  try{
+    f.get();
+  }
+  catch(NError& e){
+    replicaMutex_.lock();
+    replicaMap_.erase(handle);
+    replicaMutex_.unlock();
+    
+    delete replica;
+    return false;
+  }
+  
+  return true;
+}
+
+NFuture Client::add(int64_t id,
+                    const nvar& n,
+                    bool obtain,
+                    Replica* replica){
+  callMutex_.lock();
+  Call& c = callMap_[id];
+  c.n = n;
+  c.obtain = obtain;
+  c.replica = replica;
+  NFuture f = c.promise.future();
+  callMutex_.unlock();
+  
+  return f;
+}
+
+NFuture Client::call(int64_t handle, const nvar& n, nvar* batch){
+  int64_t id = nextId_++;
+  
+  NFuture f = add(id, n, false);
+  
+  nvar req;
+  req("op") = OP_CALL;
+  req("id") = id;
+  req("o") = handle;
+  req("f") = n;
+  
+  if(batch){
+    *batch << move(req);
+    return f;
+  }
+  
+  send(req);
+  
+  // the connection may have closed before the call was added
+  if(!isConnected()){
+    fail(id);
+  }
+  
+  return f;
+}
+
+void Client::sendBatch(nvar& calls){
+  size_t size = calls.size();
+  
+  if(size == 0){
+    return;
+  }
+  
+  NVector<int64_t> ids;
+  for(size_t i = 0; i < size; ++i){
+    ids.push_back(calls[i]["id"]);
+  }
+  
+  nvar req;
+  
+  if(size == 1){
+    req = move(calls[0]);
+  }
+  else{
+    req("op") = OP_CALL_BATCH;
+    req("c") = move(calls);
+  }
+  
+  send(req);
+  
+  if(!isConnected()){
+    for(int64_t id : ids){
+      fail(id);
+    }
+  }
+}
+
+// the authentication response may have been taken by authenticate()
+// by the time it is delivered here
+
+void Client::onReceive(){
+  if(!ready_){
+    return;
+  }
+  
+  nvar resp;
+  if(!receive(resp, 0)){
+    return;
+  }
+  
+  if(resp["op"] == OP_UPDATE){
+    update(resp);
+    return;
+  }
+  
+  if(resp["op"] == OP_CALLED_BATCH){
+    nvar& rs = resp["c"];
+    size_t size = rs.size();
+    
+    for(size_t i = 0; i < size; ++i){
+      complete(rs[i]);
+    }
+    
+    return;
+  }
+  
+  complete(resp);
+}
+
+void Client::complete(nvar& resp){
+  int64_t id = resp["id"];
+  
+  callMutex_.lock();
+  auto itr = callMap_.find(id);
+  if(itr == callMap_.end()){
+    callMutex_.unlock();
+    return;
+  }
+  
+  Call c = move(itr->second);
+  callMap_.erase(itr);
+  callMutex_.unlock();
+  
+  int op = resp["op"];
+  
+  if(c.obtain){
+    if(op == OP_OBTAINED){
+      c.promise.set(move(resp));
+    }
+    else{
+      c.promise.setError(error(c));
+    }
+    
+    return;
+  }
+  
+  if(c.replica){
+    if(op == OP_SUBSCRIBED){
+      c.replica->reset(resp);
+      c.promise.set(true);
+    }
+    else{
+      c.promise.setError(error(c));
+    }
+    
+    return;
+  }
+  
+  if(op != OP_CALLED){
+    c.promise.setError(error(c));
+    return;
+  }
+  
+  const nvar& n = c.n;
+  nvar& f = resp["f"];
+  size_t size = n.size();
+  
+  for(size_t i = 0; i < size; ++i){
+    if(n[i].fullType() == nvar::Pointer){
+      *n[i] = move(f[i]);
+    }
+  }
+  
+  c.promise.set(move(resp["r"]));
+}
+
+void Client::update(nvar& u){
+  NBasicGuard guard(replicaMutex_);
+  
+  auto itr = replicaMap_.find(u["h"]);
+  if(itr != replicaMap_.end()){
+    itr->second->update(u);
+  }
+}
+
+void Client::fail(int64_t id){
+  callMutex_.lock();
+  auto itr = callMap_.find(id);
+  if(itr == callMap_.end()){
+    callMutex_.unlock();
+    return;
+  }
+  
+  Call c = move(itr->second);
+  callMap_.erase(itr);
+  callMutex_.unlock();
+  
+  c.promise.setError(error(c));
+}
+
+void Client::failAll(){
+  callMutex_.lock();
+  CallMap_ m = callMap_;
+  callMap_.clear();
+  callMutex_.unlock();
+  
+  for(auto& itr : m){
+    Call& c = itr.second;
+    c.promise.setError(error(c));
+  }
+}
+
+NError Client::error(const Call& c){
+  if(c.obtain){
+    return NError(NMESSAGE("failed to obtain: " + c.n));
+  }
+  
+  if(c.replica){
+    return NError(NMESSAGE("failed to subscribe: " + c.n));
+  }
+  
+  return NError(NMESSAGE("failed to remote process: " + c.n));
 }
 
 void Client::onClose(bool manual){
-  broker_->removeClient(obj_);
+  failAll();
+  broker_->removeClient(this);
 }
 
 NBroker::NBroker(NProcTask* task){
@@ -482,10 +2085,16 @@ bool NBroker::listen(int port){
   return x_->listen(port);
 }
 
+bool NBroker::listen(const nstr& address){
+  return x_->listen(address);
+}
+
 void NBroker::distribute(NObject* object,
                          const nstr& className,
-                         const nstr& objectName){
-  x_->distribute(object, className, objectName);
+                         const nstr& objectName,
+                         Policy policy,
+                         const nvar& readOnly){
+  x_->distribute(object, className, objectName, policy, readOnly);
 }
 
 void NBroker::revoke(const nstr& objectName){
@@ -499,6 +2108,24 @@ NObject* NBroker::obtain(const nstr& host,
   return x_->obtain(host, port, objectName, auth);
 }
 
+NObject* NBroker::obtain(const nstr& address,
+                         const nstr& objectName,
+                         const nvar& auth){
+  return x_->obtain(address, objectName, auth);
+}
+
+void NBroker::replicate(const nstr& objectName, double interval){
+  x_->replicate(objectName, interval);
+}
+
+void NBroker::publish(const nstr& objectName){
+  x_->publish(objectName);
+}
+
+bool NBroker::subscribe(NObject* proxy, const nvar& reads, double staleness){
+  return x_->subscribe(proxy, reads, staleness);
+}
+
 void NBroker::release(NObject* object){
   x_->release(object);
 }
@@ -511,6 +2138,26 @@ void NBroker::setEncoder(NCommunicator::Encoder* encoder){
   x_->setEncoder(encoder);
 }
 
+void NBroker::setMinCompressSize(size_t n){
+  x_->setMinCompressSize(n);
+}
+
 nvar NBroker::process_(NObject* obj, const nvar& n){
   return x_->process_(obj, n);
 }
+
+NFuture NBroker::processAsync_(NObject* obj, const nvar& n){
+  return x_->processAsync_(obj, n);
+}
+
+NBroker::Batch::Batch(NBroker& broker){
+  x_ = new NBrokerBatch_(broker.x_);
+}
+
+NBroker::Batch::~Batch(){
+  delete x_;
+}
+
+void NBroker::Batch::send(){
+  x_->send();
+}
@@ -0,0 +1,639 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+// ucontext is deprecated on the Mac but remains available
+#ifdef __APPLE__
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <neu/NCoProc.h>
+
+#include <ucontext.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <cmath>
+#include <map>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include <neu/NSys.h>
+#include <neu/NError.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  // the number of freed stacks an NCoProc keeps for reuse
+  const size_t MaxStacks = 256;
+  
+  const size_t PageSize = 4096;
+  
+  typedef multimap<double, NCoroutine_*> DeadlineMap;
+  
+} // end namespace
+
+namespace neu{
+  
+  // a coroutine and what it waits on, a coroutine switches back to
+  // the worker which resumed it when it suspends itself, the worker
+  // then calls then() to arrange for it to be resumed. until the
+  // coroutine has switched out, nothing may resume it
+  
+  class NCoroutine_{
+  public:
+    typedef void (*Then)(NCoroutine_*);
+    
+    NCoroutine_(NCoProc* proc, NProcTask* task, nvar& r)
+    : proc(proc),
+    task(task),
+    r(move(r)),
+    caller(0),
+    then(0),
+    done(false),
+    next(0),
+    fd(-1),
+    events(0),
+    deadline(-1),
+    polling(false),
+    timedOut(false),
+    failed(false),
+    delay(0),
+    semaphore(0){
+      stack = proc->allocStack_();
+      
+      getcontext(&context);
+      context.uc_stack.ss_sp = (char*)stack + PageSize;
+      context.uc_stack.ss_size = proc->stackSize_;
+      context.uc_link = 0;
+      makecontext(&context, entry, 0);
+    }
+    
+    ~NCoroutine_(){
+      proc->freeStack_(stack);
+      --proc->active_;
+    }
+    
+    static NCoroutine_* current(){
+      return current_;
+    }
+    
+    // runs c on the calling worker until it suspends itself or
+    // returns
+    static void switchTo(NCoroutine_* c){
+      NCoroutine_* prev = current_;
+      current_ = c;
+      
+      ucontext_t caller;
+      c->caller = &caller;
+      swapcontext(&caller, &c->context);
+      
+      current_ = prev;
+      
+      if(c->done){
+        delete c;
+        return;
+      }
+      
+      c->then(c);
+    }
+    
+    // the coroutine may resume on another thread so thread locals
+    // must not be read again after suspend() returns
+    void suspend(Then t){
+      then = t;
+      swapcontext(&context, caller);
+    }
+    
+    void resume(){
+      nvar v = this;
+      task->queue(&proc->resume_, v);
+    }
+    
+    NCoProc* proc;
+    NProcTask* task;
+    nvar r;
+    void* stack;
+    ucontext_t context;
+    ucontext_t* caller;
+    Then then;
+    bool done;
+    NCoroutine_* next;
+    
+    int fd;
+    uint32_t events;
+    double deadline;
+    DeadlineMap::iterator deadlineItr;
+    bool polling;
+    bool timedOut;
+    bool failed;
+    double delay;
+    NFuture future;
+    NCoSemaphore* semaphore;
+    
+  private:
+    static void entry(){
+      NCoroutine_* c = current_;
+      
+      c->proc->run(c->r);
+      
+      c->done = true;
+      swapcontext(&c->context, c->caller);
+    }
+    
+    static thread_local NCoroutine_* current_;
+  };
+  
+  thread_local NCoroutine_* NCoroutine_::current_ = 0;
+  
+} // end namespace neu
+
+namespace{
+  
+#ifdef __linux__
+  
+  // a thread shared by all tasks which waits on the fds of
+  // coroutines with epoll and resumes them when their fd is ready or
+  // their deadline passes. fds are registered one shot and removed
+  // once their wait is over
+  
+  class Poller{
+  public:
+    Poller(){
+      epoll_ = epoll_create1(EPOLL_CLOEXEC);
+      wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      
+      if(epoll_ < 0 || wake_ < 0){
+        NERROR("failed to create poller");
+      }
+      
+      epoll_event e;
+      e.events = EPOLLIN;
+      e.data.ptr = 0;
+      epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &e);
+      
+      thread t(&Poller::run, this);
+      t.detach();
+    }
+    
+    static Poller* get(){
+      static Poller* poller = new Poller;
+      return poller;
+    }
+    
+    void add(NCoroutine_* c){
+      mutex_.lock();
+      
+      epoll_event e;
+      e.events = c->events | EPOLLONESHOT;
+      e.data.ptr = c;
+      
+      if(epoll_ctl(epoll_, EPOLL_CTL_ADD, c->fd, &e) < 0){
+        mutex_.unlock();
+        c->failed = true;
+        c->resume();
+        return;
+      }
+      
+      c->polling = true;
+      
+      bool first = false;
+      
+      if(c->deadline >= 0){
+        c->deadlineItr = deadlines_.insert({c->deadline, c});
+        first = c->deadlineItr == deadlines_.begin();
+      }
+      
+      mutex_.unlock();
+      
+      // the poller may be waiting for a later deadline
+      if(first){
+        uint64_t one = 1;
+        ssize_t n = write(wake_, &one, sizeof(one));
+        (void)n;
+      }
+    }
+    
+  private:
+    int epoll_;
+    int wake_;
+    NBasicMutex mutex_;
+    DeadlineMap deadlines_;
+    
+    // called with mutex_ locked
+    void remove(NCoroutine_* c){
+      c->polling = false;
+      
+      epoll_ctl(epoll_, EPOLL_CTL_DEL, c->fd, 0);
+      
+      if(c->deadline >= 0){
+        deadlines_.erase(c->deadlineItr);
+      }
+    }
+    
+    void run(){
+      const size_t MaxEvents = 256;
+      epoll_event events[MaxEvents];
+      NVector<NCoroutine_*> ready;
+      
+      for(;;){
+        int timeout = -1;
+        
+        mutex_.lock();
+        if(!deadlines_.empty()){
+          double dt = deadlines_.begin()->first - NSys::now();
+          timeout = dt > 0 ? ceil(dt*1000) : 0;
+        }
+        mutex_.unlock();
+        
+        int n = epoll_wait(epoll_, events, MaxEvents, timeout);
+        
+        mutex_.lock();
+        
+        for(int i = 0; i < n; ++i){
+          NCoroutine_* c = (NCoroutine_*)events[i].data.ptr;
+          
+          if(!c){
+            uint64_t count;
+            ssize_t n = read(wake_, &count, sizeof(count));
+            (void)n;
+            continue;
+          }
+          
+          if(c->polling){
+            remove(c);
+            ready.push_back(c);
+          }
+        }
+        
+        if(!deadlines_.empty()){
+          double now = NSys::now();
+          
+          while(!deadlines_.empty() && deadlines_.begin()->first <= now){
+            NCoroutine_* c = deadlines_.begin()->second;
+            remove(c);
+            c->timedOut = true;
+            ready.push_back(c);
+          }
+        }
+        
+        mutex_.unlock();
+        
+        for(NCoroutine_* c : ready){
+          c->resume();
+        }
+        
+        ready.clear();
+      }
+    }
+  };
+  
+#endif
+  
+  bool pollFd(int fd, short events, double timeout){
+    pollfd p;
+    p.fd = fd;
+    p.events = events;
+    p.revents = 0;
+    
+    return ::poll(&p, 1, timeout < 0 ? -1 : timeout*1000) > 0;
+  }
+  
+  bool awaitFd(int fd, short events, double timeout){
+    NCoroutine_* c = NCoroutine_::current();
+    
+    if(!c || timeout == 0){
+      return pollFd(fd, events, timeout);
+    }
+    
+#ifdef __linux__
+    
+    c->fd = fd;
+    c->events = events == POLLIN ? EPOLLIN : EPOLLOUT;
+    c->deadline = timeout < 0 ? -1 : NSys::now() + timeout;
+    c->timedOut = false;
+    c->failed = false;
+    
+    c->suspend([](NCoroutine_* c){
+      Poller::get()->add(c);
+    });
+    
+    if(c->failed){
+      NERROR("failed to wait on fd");
+    }
+    
+    return !c->timedOut;
+    
+#else
+    
+    // without epoll, poll the fd with a backoff from 1 ms to 16 ms
+    double end = timeout < 0 ? -1 : NSys::now() + timeout;
+    double delay = 0.001;
+    
+    for(;;){
+      if(pollFd(fd, events, 0)){
+        return true;
+      }
+      
+      double dt = delay;
+      
+      if(end >= 0){
+        double left = end - NSys::now();
+        
+        if(left <= 0){
+          return false;
+        }
+        
+        dt = min(dt, left);
+      }
+      
+      NCoProc::sleep(dt);
+      
+      delay = min(delay*2, 0.016);
+    }
+    
+#endif
+  }
+  
+} // end namespace
+
+void NCoProc::Resume::run(nvar& r){
+  NCoroutine_::switchTo(r.ptr<NCoroutine_>());
+}
+
+// a coroutine left waiting when its task is deleted is abandoned,
+// the objects on its stack are not destroyed
+bool NCoProc::Resume::dealloc_(nvar& r){
+  delete r.ptr<NCoroutine_>();
+  
+  return true;
+}
+
+NCoProc::NCoProc(size_t stackSize)
+: stackSize_((stackSize + PageSize - 1)/PageSize*PageSize),
+active_(0){}
+
+NCoProc::~NCoProc(){
+  for(void* s : stacks_){
+    munmap(s, stackSize_ + PageSize);
+  }
+}
+
+size_t NCoProc::active() const{
+  return active_;
+}
+
+void NCoProc::run_(NProcTask* task, nvar& r){
+  ++active_;
+  
+  NCoroutine_::switchTo(new NCoroutine_(this, task, r));
+}
+
+// stacks are mapped with a guard page below them
+void* NCoProc::allocStack_(){
+  stackMutex_.lock();
+  
+  if(!stacks_.empty()){
+    void* s = stacks_.back();
+    stacks_.pop_back();
+    stackMutex_.unlock();
+    return s;
+  }
+  
+  stackMutex_.unlock();
+  
+  void* s = mmap(0, stackSize_ + PageSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANON, -1, 0);
+  
+  if(s == MAP_FAILED){
+    NERROR("failed to allocate stack");
+  }
+  
+  mprotect(s, PageSize, PROT_NONE);
+  
+  return s;
+}
+
+void NCoProc::freeStack_(void* s){
+  stackMutex_.lock();
+  
+  if(stacks_.size() < MaxStacks){
+    stacks_.push_back(s);
+    stackMutex_.unlock();
+    return;
+  }
+  
+  stackMutex_.unlock();
+  
+  munmap(s, stackSize_ + PageSize);
+}
+
+bool NCoProc::inCoroutine(){
+  return NCoroutine_::current();
+}
+
+bool NCoProc::awaitReadable(int fd, double timeout){
+  return awaitFd(fd, POLLIN, timeout);
+}
+
+bool NCoProc::awaitWritable(int fd, double timeout){
+  return awaitFd(fd, POLLOUT, timeout);
+}
+
+void NCoProc::sleep(double dt){
+  NCoroutine_* c = NCoroutine_::current();
+  
+  if(!c){
+    NSys::sleep(dt);
+    return;
+  }
+  
+  c->delay = dt;
+  
+  c->suspend([](NCoroutine_* c){
+    nvar v = c;
+    c->task->queueAfter(&c->proc->resume_, v, c->delay);
+  });
+}
+
+void NCoProc::yield(){
+  NCoroutine_* c = NCoroutine_::current();
+  
+  if(!c){
+    return;
+  }
+  
+  c->suspend([](NCoroutine_* c){
+    c->resume();
+  });
+}
+
+const nvar& NCoProc::await(const NFuture& f){
+  NCoroutine_* c = NCoroutine_::current();
+  
+  if(!c || f.ready() || !f.valid()){
+    return f.get();
+  }
+  
+  c->future = f;
+  
+  c->suspend([](NCoroutine_* c){
+    NFuture f = c->future;
+    c->future = NFuture();
+    
+    f.notify([c]{
+      c->resume();
+    });
+  });
+  
+  return f.get();
+}
+
+NCoSemaphore::NCoSemaphore(size_t count)
+: count_(count),
+head_(0),
+tail_(0){}
+
+NCoSemaphore::~NCoSemaphore(){}
+
+void NCoSemaphore::acquire(){
+  NCoroutine_* c = NCoroutine_::current();
+  
+  if(!c){
+    NERROR("not called from a coroutine");
+  }
+  
+  if(tryAcquire()){
+    return;
+  }
+  
+  c->semaphore = this;
+  
+  // count_ is checked again as release() may have been called
+  // before the coroutine switched out
+  c->suspend([](NCoroutine_* c){
+    NCoSemaphore* s = c->semaphore;
+    
+    s->mutex_.lock();
+    
+    if(s->count_ > 0){
+      --s->count_;
+      s->mutex_.unlock();
+      c->resume();
+      return;
+    }
+    
+    c->next = 0;
+    
+    if(s->tail_){
+      s->tail_->next = c;
+    }
+    else{
+      s->head_ = c;
+    }
+    
+    s->tail_ = c;
+    
+    s->mutex_.unlock();
+  });
+}
+
+bool NCoSemaphore::tryAcquire(){
+  mutex_.lock();
+  
+  if(count_ > 0){
+    --count_;
+    mutex_.unlock();
+    return true;
+  }
+  
+  mutex_.unlock();
+  
+  return false;
+}
+
+void NCoSemaphore::release(size_t count){
+  NCoroutine_* ready = 0;
+  
+  mutex_.lock();
+  
+  while(count > 0 && head_){
+    NCoroutine_* c = head_;
+    head_ = c->next;
+    
+    if(!head_){
+      tail_ = 0;
+    }
+    
+    c->next = ready;
+    ready = c;
+    --count;
+  }
+  
+  count_ += count;
+  
+  mutex_.unlock();
+  
+  while(ready){
+    NCoroutine_* next = ready->next;
+    ready->resume();
+    ready = next;
+  }
+}
@@ -56,6 +56,21 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <atomic>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <climits>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#endif
 
 #include <neu/NProc.h>
 #include <neu/NBasicMutex.h>
@@ -63,34 +78,415 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <neu/NError.h>
 #include <neu/NSocket.h>
 #include <neu/NGuard.h>
+#include <neu/NReactor.h>
 
 using namespace std;
 using namespace neu;
 
 namespace{
   
-  class ReceiveProc : public NProc{
+#ifdef MSG_NOSIGNAL
+  const int SendFlags = MSG_NOSIGNAL;
+#else
+  const int SendFlags = 0;
+#endif
+  
+  // the most a connection reads before letting the reactor handle
+  // other connections
+  const size_t MaxRead = 1048576;
+  
+  // the size of pooled receive chunks, a frame which does not fit in
+  // one gets a chunk of its own
+  const size_t ChunkSize = 262144;
+  
+  // an incomplete frame is moved to a new chunk when less than this
+  // is left to read into
+  const size_t MinRead = 4096;
+  
+  // the most free chunks kept for reuse
+  const size_t MaxFreeChunks = 16;
+  
+  const size_t DefaultMaxMessageSize = 67108864;
+  
+#ifdef IOV_MAX
+  const size_t MaxIOV = IOV_MAX;
+#else
+  const size_t MaxIOV = 1024;
+#endif
+  
+  // how long a shared memory peer waits for the rings once connected
+  const double ShmTimeout = 5.0;
+  
+  // frames are received into chunks and unpacked where they lie. a
+  // chunk is shared by the connection reading into it and each of its
+  // frames not yet delivered, the last to release it returns it to
+  // the pool. a connection only holds a chunk while it has data to
+  // read, so idle connections cost none
+  
+  class Chunk{
+  public:
+    char* data;
+    size_t size;
+    size_t end;
+    atomic<size_t> refs;
+  };
+  
+  NVector<Chunk*> _chunkPool;
+  NBasicMutex _chunkMutex;
+  
+  // chunks of the standard size are reused
+  Chunk* newChunk(size_t size){
+    if(size <= ChunkSize){
+      _chunkMutex.lock();
+      
+      if(!_chunkPool.empty()){
+        Chunk* c = _chunkPool.back();
+        _chunkPool.pop_back();
+        _chunkMutex.unlock();
+        
+        c->end = 0;
+        c->refs = 1;
+        return c;
+      }
+      
+      _chunkMutex.unlock();
+      size = ChunkSize;
+    }
+    
+    Chunk* c = new Chunk;
+    c->data = (char*)malloc(size);
+    c->size = size;
+    c->end = 0;
+    c->refs = 1;
+    return c;
+  }
+  
+  void releaseChunk(Chunk* c){
+    if(c->refs.fetch_sub(1) != 1){
+      return;
+    }
+    
+    if(c->size == ChunkSize){
+      _chunkMutex.lock();
+      
+      if(_chunkPool.size() < MaxFreeChunks){
+        _chunkPool.push_back(c);
+        _chunkMutex.unlock();
+        return;
+      }
+      
+      _chunkMutex.unlock();
+    }
+    
+    free(c->data);
+    delete c;
+  }
+  
+  // a queue is full once it reaches either of its high watermarks,
+  // and has room again once it is down to the low watermarks of both
+  // limits it has. a high watermark of 0 is unlimited
+  
+  class Watermarks{
+  public:
+    Watermarks()
+    : highCount(0),
+    lowCount(0),
+    highBytes(0),
+    lowBytes(0){}
+    
+    void set(size_t hc, size_t lc, size_t hb, size_t lb){
+      highCount = hc;
+      lowCount = min(lc, hc);
+      highBytes = hb;
+      lowBytes = min(lb, hb);
+    }
+    
+    bool full(size_t count, size_t bytes) const{
+      return (highCount > 0 && count >= highCount) ||
+      (highBytes > 0 && bytes >= highBytes);
+    }
+    
+    bool low(size_t count, size_t bytes) const{
+      return (highCount == 0 || count <= lowCount) &&
+      (highBytes == 0 || bytes <= lowBytes);
+    }
+    
+    atomic<size_t> highCount;
+    atomic<size_t> lowCount;
+    atomic<size_t> highBytes;
+    atomic<size_t> lowBytes;
+  };
+  
+  class Connection;
+  
+  // moves the bytes of a connection, read() and write() behave like
+  // recv() and sendmsg() on a non-blocking socket. the reactor
+  // watches fd() for the connection
+  
+  class Transport{
+  public:
+    Transport(NSocket* socket)
+    : socket_(socket),
+    fd_(socket->fd()){}
+    
+    virtual ~Transport(){
+      delete socket_;
+    }
+    
+    NSocket* socket(){
+      return socket_;
+    }
+    
+    virtual int fd(){
+      return fd_;
+    }
+    
+    virtual ssize_t read(char* buf, size_t size){
+      return recv(fd_, buf, size, 0);
+    }
+    
+    virtual ssize_t write(iovec* iov, size_t n){
+      msghdr h;
+      memset(&h, 0, sizeof(h));
+      h.msg_iov = iov;
+      h.msg_iovlen = n;
+      
+      return sendmsg(fd_, &h, SendFlags);
+    }
+    
+    virtual void add(Connection* c);
+    
+    virtual void remove(Connection* c);
+    
+  protected:
+    NSocket* socket_;
+    int fd_;
+  };
+  
+#ifdef __linux__
+  
+  const size_t RingSize = 1048576;
+  
+  // a single producer, single consumer byte ring in shared memory.
+  // before either side sleeps it sets its waiting flag and looks
+  // again, the other side only rings its doorbell when the flag is
+  // set, so neither makes a system call while the other keeps up
+  
+  class Ring{
+  public:
+    atomic<uint64_t> head;
+    char pad1[56];
+    atomic<uint64_t> tail;
+    char pad2[56];
+    atomic<uint32_t> readerWaiting;
+    atomic<uint32_t> writerWaiting;
+    char pad3[56];
+    char data[RingSize];
+  };
+  
+  // watches the Unix domain socket of a shared memory connection,
+  // which carries no data once the rings are set up, for the peer
+  // closing it
+  
+  class Hangup : public NReactor::Handler{
   public:
-    ReceiveProc(NProcTask* task, NCommunicator_* c);
+    Hangup(int fd, Connection* c)
+    : NReactor::Handler(fd),
+    c_(c){}
     
-    void run(nvar& r);
+    bool onEvent(uint32_t events);
     
   private:
-    NProcTask* task_;
+    Connection* c_;
+  };
+  
+  // the server creates the two rings, and an eventfd doorbell for
+  // each side, and passes them to the client over the Unix domain
+  // socket. the reactor finds a doorbell both readable and writable
+  // each time it is rung, so it wakes a writer waiting for space as
+  // well as a reader
+  
+  class ShmTransport : public Transport{
+  public:
+    ShmTransport(NSocket* socket, Ring* rings, int* bells, bool server)
+    : Transport(socket),
+    rings_(rings),
+    hangup_(0),
+    awake_(true){
+      size_t i = server ? 0 : 1;
+      
+      rx_ = rings + i;
+      tx_ = rings + 1 - i;
+      bell_ = bells[i];
+      peerBell_ = bells[1 - i];
+    }
+    
+    ~ShmTransport(){
+      munmap(rings_, 2*sizeof(Ring));
+      ::close(bell_);
+      ::close(peerBell_);
+    }
+    
+    // called by the server on an accepted socket
+    static ShmTransport* create(NSocket* socket);
+    
+    // called by the client once connected
+    static ShmTransport* join(NSocket* socket);
+    
+    int fd(){
+      return bell_;
+    }
+    
+    ssize_t read(char* buf, size_t size);
+    
+    ssize_t write(iovec* iov, size_t n);
+    
+    void add(Connection* c);
+    
+    void remove(Connection* c);
+    
+  private:
+    Ring* rings_;
+    Ring* rx_;
+    Ring* tx_;
+    int bell_;
+    int peerBell_;
+    Hangup* hangup_;
+    bool awake_;
+    
+    void ring(){
+      uint64_t v = 1;
+      ::write(peerBell_, &v, sizeof(v));
+    }
+  };
+  
+#endif
+  
+  // reads the messages of a connection on the reactor thread, each
+  // completed frame is handed to the communicator, which decodes
+  // and delivers frames in order on its task
+  
+  class Connection : public NReactor::Handler{
+  public:
+    Connection(Transport* transport, NCommunicator_* c)
+    : NReactor::Handler(transport->fd()),
+    transport_(transport),
+    c_(c),
+    closed_(false),
+    hangup_(false),
+    chunk_(0),
+    pos_(0){}
+    
+    ~Connection(){
+      if(chunk_){
+        releaseChunk(chunk_);
+      }
+    }
+    
+    bool onEvent(uint32_t events);
+    
+    // reads what is left then closes
+    void hangup();
+    
+  private:
+    Transport* transport_;
     NCommunicator_* c_;
-    NSocket* s_;
+    bool closed_;
+    bool hangup_;
+    Chunk* chunk_;
+    size_t pos_;
+    
+    void reserve();
+    
+    bool parse();
+    
+    void close();
   };
   
-  class SendProc : public NProc{
+  // a proc of a communicator, which may be deleted while the proc
+  // is queued or running, even from a call the proc makes, e.g: to
+  // onClose(). the task deletes the proc after its last run, which
+  // does nothing once detached
+  
+  class CommProc : public NProc{
   public:
-    SendProc(NProcTask* task, NCommunicator_* c);
+    CommProc()
+    : detached_(false){}
+    
+    void run(nvar& r){
+      mutex_.lock();
+      
+      if(detached_){
+        mutex_.unlock();
+        return;
+      }
+      
+      runner_ = this_thread::get_id();
+      process(r);
+      runner_ = thread::id();
+      
+      mutex_.unlock();
+    }
     
-    void run(nvar& r);
+    virtual void process(nvar& r) = 0;
+    
+    // waits for a run on another thread to finish
+    void detach(){
+      if(runner_ == this_thread::get_id()){
+        detached_ = true;
+        return;
+      }
+      
+      mutex_.lock();
+      detached_ = true;
+      mutex_.unlock();
+    }
+    
+  private:
+    NBasicMutex mutex_;
+    atomic<thread::id> runner_;
+    bool detached_;
+  };
+  
+  class DeliverProc : public CommProc{
+  public:
+    DeliverProc(NCommunicator_* c)
+    : c_(c){}
+    
+    void process(nvar& r);
+    
+  private:
+    NCommunicator_* c_;
+  };
+  
+  // only queued when there are messages to send, or by the reactor
+  // once its socket, which was full, is writable again. takes up to
+  // the communicator's max batch of queued messages at a time and
+  // writes them with a single sendmsg()
+  
+  class SendProc : public CommProc{
+  public:
+    SendProc(NCommunicator_* c);
+    
+    ~SendProc(){
+      clear();
+    }
+    
+    void process(nvar& r);
     
   private:
-    NProcTask* task_;
     NCommunicator_* c_;
-    NSocket* s_;
+    Transport* transport_;
+    size_t taken_;
+    size_t bytes_;
+    NVector<char*> bufs_;
+    NVector<iovec> iov_;
+    size_t first_;
+    
+    // returns false if no messages were queued
+    bool fill();
+    
+    void clear();
   };
   
 } // end namespace
@@ -99,59 +495,194 @@ namespace neu{
   
   class NCommunicator_{
   public:
+    // the states of writable_
+    static const int Unknown = 0;
+    static const int Waiting = 1;
+    static const int Writable = 2;
+    
+    class Frame{
+    public:
+      Chunk* chunk;
+      char* buf;
+      uint32_t size;
+    };
+    
+    // a message packed by its sender, with 4 bytes reserved for its
+    // size
+    class Packed{
+    public:
+      char* buf;
+      uint32_t size;
+    };
+    
+    // size is that of its frame
+    class Received{
+    public:
+      nvar msg;
+      uint32_t size;
+    };
+    
     NCommunicator_(NCommunicator* o, NProcTask* task)
     : o_(o),
     task_(task),
-    socket_(0),
+    transport_(0),
     sendProc_(0),
-    receiveProc_(0),
+    deliverProc_(0),
+    connection_(0),
+    sendCount_(0),
+    maxBatch_(64),
+    maxMessageSize_(DefaultMaxMessageSize),
+    minCompressSize_(1024),
+    noDelay_(true),
+    cork_(false),
+    writable_(Unknown),
+    sendQueued_(0),
+    sendBytes_(0),
+    sendFull_(false),
+    sendMaxCount_(0),
+    sendMaxBytes_(0),
+    sendFulls_(0),
+    sendBlocked_(0),
+    sendDropped_(0),
+    frameCount_(0),
+    receiveCount_(0),
+    receiveBytes_(0),
+    receiveMaxCount_(0),
+    receiveMaxBytes_(0),
+    receivePauses_(0),
+    paused_(false),
+    connected_(false),
     encoder_(0){}
     
     ~NCommunicator_(){
-      if(socket_){
-        sendSem_.disable();
+      if(transport_){
+        removeConnection();
+        
         receiveSem_.disable();
         
+        sendProc_->detach();
+        deliverProc_->detach();
+        
         if(task_->terminate(sendProc_)){
           delete sendProc_;
         }
         
-        if(task_->terminate(receiveProc_)){
-          delete receiveProc_;
+        if(task_->terminate(deliverProc_)){
+          delete deliverProc_;
         }
         
-        delete socket_;
+        delete transport_;
+      }
+      
+      for(Frame& f : frames_){
+        if(f.chunk){
+          releaseChunk(f.chunk);
+        }
+      }
+      
+      for(Packed& p : sendQueue_){
+        free(p.buf);
       }
     }
     
-    void setSocket(NSocket* socket){
-      socket_ = socket;
-      init();
+    // on failure, the socket is closed and the communicator is left
+    // disconnected
+    void setSocket(NSocket* socket, bool sharedMemory){
+      Transport* t;
+      
+#ifdef __linux__
+      t = sharedMemory ? ShmTransport::create(socket) : new Transport(socket);
+#else
+      // without shared memory support, both sides fall back to the
+      // Unix domain socket
+      t = new Transport(socket);
+#endif
+      
+      if(!t){
+        delete socket;
+        return;
+      }
+      
+      init(t);
     }
     
-    void init(){
+    void init(Transport* transport){
+      transport_ = transport;
       connected_ = true;
       
-      sendProc_ = new SendProc(task_, this);
-      receiveProc_ = new ReceiveProc(task_, this);
-
-      task_->queue(sendProc_);
-      task_->queue(receiveProc_);
+      NSocket* socket = transport_->socket();
+      
+      socket->setNoDelay(noDelay_);
+      
+      if(cork_){
+        socket->setCork(true);
+      }
+      
+      sendProc_ = new SendProc(this);
+      deliverProc_ = new DeliverProc(this);
+      
+      Connection* c = new Connection(transport_, this);
+      connection_ = c;
+      transport_->add(c);
+      
+      if(sendCount_ > 0){
+        task_->queue(sendProc_);
+      }
     }
     
     bool connect(const nstr& host, int port){
-      if(socket_){
+      if(transport_){
+        NERROR("socket exists");
+      }
+      
+      NSocket* socket = new NSocket;
+      if(!socket->connect(host, port)){
+        delete socket;
+        return false;
+      }
+      
+      init(new Transport(socket));
+      
+      return true;
+    }
+    
+    bool connect(const nstr& address){
+      nstr scheme;
+      nstr host;
+      int port;
+      
+      if(!NSocket::parseAddress(address, scheme, host, port)){
+        NERROR("invalid address: " + address);
+      }
+      
+      if(scheme == "tcp"){
+        return connect(host, port);
+      }
+      
+      if(transport_){
         NERROR("socket exists");
       }
       
-      socket_ = new NSocket;
-      if(!socket_->connect(host, port)){
-        delete socket_;
-        socket_ = 0;
+      NSocket* socket = new NSocket;
+      if(!socket->connectLocal(host)){
+        delete socket;
+        return false;
+      }
+      
+      Transport* t;
+      
+#ifdef __linux__
+      t = scheme == "shm" ? ShmTransport::join(socket) : new Transport(socket);
+#else
+      t = new Transport(socket);
+#endif
+      
+      if(!t){
+        delete socket;
         return false;
       }
       
-      init();
+      init(t);
       
       return true;
     }
@@ -160,37 +691,165 @@ namespace neu{
       return task_;
     }
     
+    // the connection is removed from the reactor before the socket is
+    // closed, so that its fd cannot be reused while it is watched
+    void removeConnection(){
+      connectionMutex_.lock();
+      Connection* c = connection_.exchange(0);
+      connectionMutex_.unlock();
+      
+      if(c){
+        transport_->remove(c);
+      }
+    }
+    
     void close(){
-      if(!connected_){
+      if(!connected_.exchange(false)){
         return;
       }
       
-      connected_ = false;
-      socket_->close();
+      removeConnection();
+      transport_->socket()->close();
+      wakeSenders();
       
       o_->onClose(true);
     }
     
     void close_(){
-      if(!connected_){
+      if(!connected_.exchange(false)){
         return;
       }
       
-      connected_ = false;
-      socket_->close();
+      removeConnection();
+      transport_->socket()->close();
+      wakeSenders();
       
       o_->onClose(false);
     }
     
+    // senders waiting for room give up once closed
+    void wakeSenders(){
+      sendMutex_.lock();
+      sendMutex_.unlock();
+      sendCondition_.notify_all();
+    }
+    
     bool isConnected() const{
       return connected_;
     }
     
-    void send(nvar& msg){
+    void setMaxBatch(size_t n){
+      maxBatch_ = max(size_t(1), min(n, MaxIOV));
+    }
+    
+    size_t maxBatch() const{
+      return maxBatch_;
+    }
+    
+    void setMaxMessageSize(size_t n){
+      maxMessageSize_ = min(n, size_t(UINT32_MAX));
+    }
+    
+    size_t maxMessageSize() const{
+      return maxMessageSize_;
+    }
+    
+    void setMinCompressSize(size_t n){
+      minCompressSize_ = n;
+    }
+    
+    void setNoDelay(bool flag){
+      noDelay_ = flag;
+      
+      if(transport_){
+        transport_->socket()->setNoDelay(flag);
+      }
+    }
+    
+    void setCork(bool flag){
+      cork_ = flag;
+      
+      if(transport_){
+        transport_->socket()->setCork(flag);
+      }
+    }
+    
+    void setSendWatermarks(size_t highCount,
+                           size_t lowCount,
+                           size_t highBytes,
+                           size_t lowBytes){
       sendMutex_.lock();
-      sendQueue_.emplace_back(move(msg));
+      sendWatermarks_.set(highCount, lowCount, highBytes, lowBytes);
+      sendFull_ = sendWatermarks_.full(sendQueued_, sendBytes_);
       sendMutex_.unlock();
-      sendSem_.release();
+      sendCondition_.notify_all();
+    }
+    
+    void setReceiveWatermarks(size_t highCount,
+                              size_t lowCount,
+                              size_t highBytes,
+                              size_t lowBytes){
+      receiveWatermarks_.set(highCount, lowCount, highBytes, lowBytes);
+      received(0, 0);
+    }
+    
+    // messages are packed by their senders so that the queue can be
+    // bounded in bytes. a message is counted before the send proc can
+    // take it, else the send proc could account for it first and be
+    // queued again while it is still running. once full, the queue
+    // takes no more until it is down to its low watermarks. timeout
+    // is in seconds, negative to wait for as long as it takes
+    bool send(nvar& msg, double timeout){
+      Packed p;
+      p.buf = msg.pack(p.size, minCompressSize_, 4);
+      
+      unique_lock<mutex> lock(sendMutex_.mutex());
+      
+      if(sendFull_){
+        ++sendBlocked_;
+        
+        auto room = [&]{
+          return !sendFull_ || !connected_;
+        };
+        
+        if(timeout < 0){
+          sendCondition_.wait(lock, room);
+        }
+        else{
+          sendCondition_.wait_for(lock,
+                                  chrono::duration<double>(timeout), room);
+        }
+        
+        if(sendFull_){
+          ++sendDropped_;
+          lock.unlock();
+          free(p.buf);
+          return false;
+        }
+      }
+      
+      bool first = sendCount_++ == 0;
+      
+      sendQueue_.push_back(p);
+      
+      ++sendQueued_;
+      sendBytes_ += p.size;
+      
+      sendMaxCount_ = max(sendMaxCount_, sendQueued_);
+      sendMaxBytes_ = max(sendMaxBytes_, sendBytes_);
+      
+      if(sendWatermarks_.full(sendQueued_, sendBytes_)){
+        sendFull_ = true;
+        ++sendFulls_;
+      }
+      
+      lock.unlock();
+      
+      if(first && sendProc_){
+        task_->queue(sendProc_);
+      }
+      
+      return true;
     }
     
     bool receive(nvar& msg, double timeout){
@@ -198,10 +857,7 @@ namespace neu{
         return false;
       }
       
-      receiveMutex_.lock();
-      msg = move(receiveQueue_.front());
-      receiveQueue_.pop_front();
-      receiveMutex_.unlock();
+      take(msg);
       return true;
     }
     
@@ -210,38 +866,249 @@ namespace neu{
         return false;
       }
       
+      take(msg);
+      return true;
+    }
+    
+    void take(nvar& msg){
       receiveMutex_.lock();
-      msg = move(receiveQueue_.front());
+      Received& r = receiveQueue_.front();
+      msg = move(r.msg);
+      uint32_t size = r.size;
       receiveQueue_.pop_front();
       receiveMutex_.unlock();
-      return true;
+      
+      received(1, size);
     }
     
-    bool get(nvar& msg, double timeout){
-      if(!sendSem_.acquire(timeout)){
+    bool get(Packed& p){
+      sendMutex_.lock();
+      
+      if(sendQueue_.empty()){
+        sendMutex_.unlock();
         return false;
       }
-
-      sendMutex_.lock();
-      msg = move(sendQueue_.front());
+      
+      p = sendQueue_.front();
       sendQueue_.pop_front();
       sendMutex_.unlock();
       return true;
     }
     
-    void put(nvar& msg){
+    void put(nvar& msg, uint32_t size){
       receiveMutex_.lock();
-      receiveQueue_.emplace_back(move(msg));
+      receiveQueue_.push_back({move(msg), size});
       receiveMutex_.unlock();
       receiveSem_.release();
+      
+      o_->onReceive();
     }
     
-    NSocket* socket(){
-      return socket_;
-    }
-    
-    virtual char* encrypt(char* buf, uint32_t& size){
-      return encoder_ ? encoder_->encrypt(buf, size) : buf;
+    // returns true if no messages were sent since n were taken
+    bool sent(size_t n){
+      return sendCount_.fetch_sub(n) == n;
+    }
+    
+    // called by the send proc once n messages of the given packed
+    // size have been written
+    void written(size_t n, size_t bytes){
+      sendMutex_.lock();
+      
+      sendQueued_ -= n;
+      sendBytes_ -= bytes;
+      
+      if(sendFull_ && sendWatermarks_.low(sendQueued_, sendBytes_)){
+        sendFull_ = false;
+        sendMutex_.unlock();
+        sendCondition_.notify_all();
+        return;
+      }
+      
+      sendMutex_.unlock();
+    }
+    
+    // called by the reactor before reading
+    bool receiveFull() const{
+      return receiveWatermarks_.full(receiveCount_, receiveBytes_);
+    }
+    
+    // called by the reactor when the receive queue is full, returns
+    // false if it has since been drained and reading may go on. else
+    // the connection is called again once there is room
+    bool pause(){
+      paused_ = true;
+      
+      if(receiveWatermarks_.low(receiveCount_, receiveBytes_) &&
+         paused_.exchange(false)){
+        return false;
+      }
+      
+      ++receivePauses_;
+      return true;
+    }
+    
+    // n messages of the given frame size were taken off the receive
+    // queue
+    void received(size_t n, size_t bytes){
+      size_t count = receiveCount_ -= n;
+      size_t b = receiveBytes_ -= bytes;
+      
+      if(paused_ && receiveWatermarks_.low(count, b) &&
+         paused_.exchange(false)){
+        connectionMutex_.lock();
+        
+        Connection* c = connection_;
+        if(c){
+          NReactor::get()->call(c, NReactor::Readable);
+        }
+        
+        connectionMutex_.unlock();
+      }
+    }
+    
+    nvar stats(){
+      nvar v;
+      
+      nvar& sv = v("send");
+      
+      sendMutex_.lock();
+      sv("count") = sendQueued_;
+      sv("bytes") = sendBytes_;
+      sv("maxCount") = sendMaxCount_;
+      sv("maxBytes") = sendMaxBytes_;
+      sv("full") = sendFulls_;
+      sv("blocked") = sendBlocked_;
+      sv("dropped") = sendDropped_;
+      sendMutex_.unlock();
+      
+      nvar& rv = v("receive");
+      rv("count") = receiveCount_.load();
+      rv("bytes") = receiveBytes_.load();
+      rv("maxCount") = receiveMaxCount_.load();
+      rv("maxBytes") = receiveMaxBytes_.load();
+      rv("paused") = receivePauses_.load();
+      
+      return v;
+    }
+    
+    // called by the send proc when its socket is full, returns false
+    // if it became writable since the send proc was last queued, in
+    // which case it should try again
+    bool wait(){
+      int s = Unknown;
+      if(writable_.compare_exchange_strong(s, Waiting)){
+        return true;
+      }
+      
+      // only the reactor queues the send proc once it is waiting, so
+      // it must not be left waiting while it is still running
+      writable_ = Unknown;
+      return false;
+    }
+    
+    // called by the reactor
+    void writable(){
+      if(writable_.exchange(Writable) == Waiting){
+        task_->queue(sendProc_);
+      }
+    }
+    
+    // called by the reactor with each completed frame, which holds a
+    // reference to its chunk, or with a null chunk once the connection
+    // has been closed
+    void frame(Chunk* chunk, char* buf, uint32_t size){
+      if(chunk){
+        size_t count = ++receiveCount_;
+        size_t bytes = receiveBytes_ += size;
+        
+        // only the reactor raises them
+        if(count > receiveMaxCount_){
+          receiveMaxCount_ = count;
+        }
+        
+        if(bytes > receiveMaxBytes_){
+          receiveMaxBytes_ = bytes;
+        }
+      }
+      
+      frameMutex_.lock();
+      frames_.push_back({chunk, buf, size});
+      frameMutex_.unlock();
+      
+      if(frameCount_++ == 0){
+        task_->queue(deliverProc_);
+      }
+    }
+    
+    // the connection is closed last, as onClose() may delete the
+    // communicator
+    void deliver(){
+      size_t count;
+      bool closed = false;
+      
+      do{
+        count = frameCount_;
+        
+        for(size_t i = 0; i < count; ++i){
+          frameMutex_.lock();
+          Frame f = frames_.front();
+          frames_.pop_front();
+          frameMutex_.unlock();
+          
+          if(!f.chunk){
+            closed = true;
+            continue;
+          }
+          
+          if(closed || !connected_){
+            releaseChunk(f.chunk);
+            received(1, f.size);
+            continue;
+          }
+          
+          uint32_t size = f.size;
+          
+          nvar msg;
+          
+          // the encoder may take ownership of the buffer it decrypts,
+          // so it is given a copy
+          if(encoder_){
+            char* buf = (char*)malloc(f.size);
+            memcpy(buf, f.buf, f.size);
+            releaseChunk(f.chunk);
+            
+            buf = decrypt(buf, f.size);
+            if(!buf){
+              // no more frames are read
+              removeConnection();
+              received(1, size);
+              closed = true;
+              continue;
+            }
+            
+            msg.unpack(buf, f.size);
+            free(buf);
+          }
+          else{
+            msg.unpack(f.buf, f.size);
+            releaseChunk(f.chunk);
+          }
+          
+          put(msg, size);
+        }
+      } while(frameCount_.fetch_sub(count) != count);
+      
+      if(closed){
+        close_();
+      }
+    }
+    
+    Transport* transport(){
+      return transport_;
+    }
+    
+    virtual char* encrypt(char* buf, uint32_t& size){
+      return encoder_ ? encoder_->encrypt(buf, size) : buf;
     }
     
     virtual char* decrypt(char* buf, uint32_t& size){
@@ -260,106 +1127,587 @@ namespace neu{
     NCommunicator* o_;
     NCommunicator::Encoder* encoder_;
     NProcTask* task_;
-    NSocket* socket_;
-    nqueue sendQueue_;
+    Transport* transport_;
+    deque<Packed> sendQueue_;
     NBasicMutex sendMutex_;
-    NVSemaphore sendSem_;
+    condition_variable sendCondition_;
     SendProc* sendProc_;
-    nqueue receiveQueue_;
+    DeliverProc* deliverProc_;
+    atomic<Connection*> connection_;
+    NBasicMutex connectionMutex_;
+    atomic<size_t> sendCount_;
+    atomic<size_t> maxBatch_;
+    atomic<size_t> maxMessageSize_;
+    atomic<size_t> minCompressSize_;
+    bool noDelay_;
+    bool cork_;
+    atomic<int> writable_;
+    Watermarks sendWatermarks_;
+    size_t sendQueued_;
+    size_t sendBytes_;
+    bool sendFull_;
+    size_t sendMaxCount_;
+    size_t sendMaxBytes_;
+    size_t sendFulls_;
+    size_t sendBlocked_;
+    size_t sendDropped_;
+    deque<Frame> frames_;
+    NBasicMutex frameMutex_;
+    atomic<size_t> frameCount_;
+    Watermarks receiveWatermarks_;
+    atomic<size_t> receiveCount_;
+    atomic<size_t> receiveBytes_;
+    atomic<size_t> receiveMaxCount_;
+    atomic<size_t> receiveMaxBytes_;
+    atomic<size_t> receivePauses_;
+    atomic_bool paused_;
+    deque<Received> receiveQueue_;
     NBasicMutex receiveMutex_;
     NVSemaphore receiveSem_;
-    ReceiveProc* receiveProc_;
     atomic_bool connected_;
     nvar session_;
   };
   
 } // end namespace neu
 
-ReceiveProc::ReceiveProc(NProcTask* task, NCommunicator_* c)
-: task_(task),
-c_(c),
-s_(c_->socket()){}
+bool Connection::onEvent(uint32_t events){
+  if(closed_){
+    return false;
+  }
+  
+  if(events & NReactor::Writable){
+    c_->writable();
+  }
+  
+  if(!(events & (NReactor::Readable | NReactor::Closed))){
+    return false;
+  }
+  
+  size_t total = 0;
+  
+  for(;;){
+    // while the receive queue is full the transport is left unread,
+    // so that its own flow control holds back the peer
+    if(c_->receiveFull() && c_->pause()){
+      return false;
+    }
+    
+    reserve();
+    
+    ssize_t n = transport_->read(chunk_->data + chunk_->end,
+                                 chunk_->size - chunk_->end);
+    
+    if(n > 0){
+      chunk_->end += n;
+      
+      if(!parse()){
+        close();
+        return false;
+      }
+      
+      total += n;
+      if(total >= MaxRead){
+        return true;
+      }
+      
+      continue;
+    }
+    
+    if(n < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      
+      if(errno == EAGAIN || errno == EWOULDBLOCK){
+        if(pos_ == chunk_->end){
+          releaseChunk(chunk_);
+          chunk_ = 0;
+        }
+        
+        if(hangup_){
+          close();
+        }
+        
+        return false;
+      }
+    }
+    
+    close();
+    return false;
+  }
+}
+
+// makes room to read into, the frame being received is moved to a
+// new chunk, large enough to hold it, when it does not fit in what is
+// left of the current one
 
-void ReceiveProc::run(nvar& r){
-  if(!c_->isConnected()){
+void Connection::reserve(){
+  if(!chunk_){
+    chunk_ = newChunk(ChunkSize);
+    pos_ = 0;
     return;
   }
   
-  uint32_t size;
-  int n = s_->receive((char*)&size, 4, _timeout);
-  if(n == -1){
-    signal(task_, this);
+  size_t pending = chunk_->end - pos_;
+  
+  // all of its frames have been delivered
+  if(pending == 0 && chunk_->refs == 1 && chunk_->size == ChunkSize){
+    chunk_->end = 0;
+    pos_ = 0;
     return;
   }
   
-  if(n != 4){
-    c_->close_();
-    return;
+  size_t need = ChunkSize;
+  
+  if(pending >= 4){
+    uint32_t size;
+    memcpy(&size, chunk_->data + pos_, 4);
+    need = size_t(size) + 4;
   }
   
-  char* buf = (char*)malloc(size);
+  size_t space = chunk_->size - chunk_->end;
+  
+  if(space > 0 && (space >= MinRead || pos_ + need <= chunk_->size)){
+    return;
+  }
   
-  uint32_t nTotal = 0;
+  Chunk* c = newChunk(max(need, ChunkSize));
+  memcpy(c->data, chunk_->data + pos_, pending);
+  c->end = pending;
   
-  while(nTotal < size){
-    n = s_->receive(buf + nTotal, size - nTotal);
+  releaseChunk(chunk_);
+  chunk_ = c;
+  pos_ = 0;
+}
+
+// hands over each complete frame, returns false if a frame is larger
+// than allowed
+
+bool Connection::parse(){
+  while(chunk_->end - pos_ >= 4){
+    uint32_t size;
+    memcpy(&size, chunk_->data + pos_, 4);
     
-    if(n <= 0){
-      free(buf);
-      c_->close_();
-      return;
+    // a frame holds at least its flags
+    if(size == 0 || size > c_->maxMessageSize()){
+      return false;
     }
     
-    nTotal += n;
+    if(chunk_->end - pos_ - 4 < size){
+      break;
+    }
+    
+    ++chunk_->refs;
+    c_->frame(chunk_, chunk_->data + pos_ + 4, size);
+    pos_ += size_t(size) + 4;
   }
   
-  buf = c_->decrypt(buf, size);
-  if(!buf){
-    c_->close_();
+  return true;
+}
+
+// if reading is paused, it closes once resumed and drained
+
+void Connection::hangup(){
+  if(closed_){
     return;
   }
   
-  nvar msg;
-  msg.unpack(buf, size);
-  free(buf);
+  hangup_ = true;
   
-  c_->put(msg);
+  while(onEvent(NReactor::Readable)){}
+}
+
+void Connection::close(){
+  closed_ = true;
+  c_->frame(0, 0, 0);
+}
+
+void Transport::add(Connection* c){
+  NReactor::get()->add(c);
+}
+
+void Transport::remove(Connection* c){
+  NReactor::get()->remove(c);
+}
+
+#ifdef __linux__
+
+bool Hangup::onEvent(uint32_t events){
+  if(events & (NReactor::Readable | NReactor::Closed)){
+    c_->hangup();
+  }
   
-  signal(task_, this);
+  return false;
 }
 
-SendProc::SendProc(NProcTask* task, NCommunicator_* c)
-: task_(task),
-c_(c),
-s_(c_->socket()){}
+ShmTransport* ShmTransport::create(NSocket* socket){
+  size_t size = 2*sizeof(Ring);
+  
+  int fds[3];
+  fds[0] = memfd_create("neu", MFD_CLOEXEC);
+  
+  if(fds[0] < 0){
+    return 0;
+  }
+  
+  if(ftruncate(fds[0], size) < 0){
+    ::close(fds[0]);
+    return 0;
+  }
+  
+  void* m = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+  
+  if(m == MAP_FAILED){
+    ::close(fds[0]);
+    return 0;
+  }
+  
+  Ring* rings = (Ring*)m;
+  
+  // both readers start out asleep, so the first write rings
+  for(size_t i = 0; i < 2; ++i){
+    rings[i].head = 0;
+    rings[i].tail = 0;
+    rings[i].readerWaiting = 1;
+    rings[i].writerWaiting = 0;
+  }
+  
+  fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  
+  bool ok = fds[1] >= 0 && fds[2] >= 0;
+  
+  if(ok){
+    char b = 0;
+    
+    iovec v;
+    v.iov_base = &b;
+    v.iov_len = 1;
+    
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    
+    msghdr h;
+    memset(&h, 0, sizeof(h));
+    h.msg_iov = &v;
+    h.msg_iovlen = 1;
+    h.msg_control = control;
+    h.msg_controllen = sizeof(control);
+    
+    cmsghdr* cm = CMSG_FIRSTHDR(&h);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    
+    ok = sendmsg(socket->fd(), &h, SendFlags) == 1;
+  }
+  
+  // the mapping keeps the memory
+  ::close(fds[0]);
+  
+  if(!ok){
+    munmap(m, size);
+    
+    for(size_t i = 1; i < 3; ++i){
+      if(fds[i] >= 0){
+        ::close(fds[i]);
+      }
+    }
+    
+    return 0;
+  }
+  
+  return new ShmTransport(socket, rings, fds + 1, true);
+}
 
-void SendProc::run(nvar& r){
-  if(!c_->isConnected()){
-    return;
+ShmTransport* ShmTransport::join(NSocket* socket){
+  if(!socket->poll(ShmTimeout)){
+    return 0;
   }
   
-  nvar msg;
-  if(!c_->get(msg, _timeout)){
-    signal(task_, this);
-    return;
+  int fds[3];
+  char b;
+  
+  iovec v;
+  v.iov_base = &b;
+  v.iov_len = 1;
+  
+  char control[CMSG_SPACE(sizeof(fds))];
+  
+  msghdr h;
+  memset(&h, 0, sizeof(h));
+  h.msg_iov = &v;
+  h.msg_iovlen = 1;
+  h.msg_control = control;
+  h.msg_controllen = sizeof(control);
+  
+  if(recvmsg(socket->fd(), &h, MSG_CMSG_CLOEXEC) != 1){
+    return 0;
   }
   
-  uint32_t size;
-  char* buf = msg.pack(size, 1024, 4);
-  buf = c_->encrypt(buf, size);
+  cmsghdr* cm = CMSG_FIRSTHDR(&h);
   
-  uint32_t s = size - 4;
-  memcpy(buf, &s, 4);
+  if(!cm || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS){
+    return 0;
+  }
   
-  uint32_t n = s_->send(buf, size);
-  free(buf);
+  size_t n = (cm->cmsg_len - CMSG_LEN(0))/sizeof(int);
   
-  if(n != size){
-    c_->close();
+  if(n != 3){
+    int* p = (int*)CMSG_DATA(cm);
+    
+    for(size_t i = 0; i < n; ++i){
+      ::close(p[i]);
+    }
+    
+    return 0;
+  }
+  
+  memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+  
+  size_t size = 2*sizeof(Ring);
+  void* m = MAP_FAILED;
+  
+  struct stat st;
+  if(fstat(fds[0], &st) == 0 && size_t(st.st_size) == size){
+    m = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+  }
+  
+  ::close(fds[0]);
+  
+  if(m == MAP_FAILED){
+    ::close(fds[1]);
+    ::close(fds[2]);
+    return 0;
+  }
+  
+  return new ShmTransport(socket, (Ring*)m, fds + 1, false);
+}
+
+// the first read after the reader went to sleep resets its doorbell,
+// any ring after that wakes the reactor again
+
+ssize_t ShmTransport::read(char* buf, size_t size){
+  if(!awake_){
+    uint64_t v;
+    ::read(bell_, &v, sizeof(v));
+    awake_ = true;
+  }
+  
+  uint64_t head = rx_->head.load(memory_order_relaxed);
+  uint64_t tail = rx_->tail;
+  
+  if(head == tail){
+    rx_->readerWaiting = 1;
+    tail = rx_->tail;
+    
+    if(head == tail){
+      awake_ = false;
+      errno = EAGAIN;
+      return -1;
+    }
+    
+    rx_->readerWaiting = 0;
+  }
+  
+  // the peer broke the ring
+  if(tail - head > RingSize){
+    errno = EPROTO;
+    return -1;
+  }
+  
+  size_t n = min(size_t(tail - head), size);
+  size_t pos = head & (RingSize - 1);
+  size_t m = min(n, RingSize - pos);
+  
+  memcpy(buf, rx_->data + pos, m);
+  memcpy(buf + m, rx_->data, n - m);
+  
+  rx_->head = head + n;
+  
+  if(rx_->writerWaiting && rx_->writerWaiting.exchange(0)){
+    ring();
+  }
+  
+  return n;
+}
+
+ssize_t ShmTransport::write(iovec* iov, size_t n){
+  uint64_t tail = tx_->tail.load(memory_order_relaxed);
+  uint64_t head = tx_->head;
+  
+  if(tail - head > RingSize){
+    errno = EPROTO;
+    return -1;
+  }
+  
+  size_t space = RingSize - (tail - head);
+  
+  if(space == 0){
+    tx_->writerWaiting = 1;
+    head = tx_->head;
+    space = RingSize - (tail - head);
+    
+    if(space == 0){
+      errno = EAGAIN;
+      return -1;
+    }
+  }
+  
+  size_t total = 0;
+  
+  for(size_t i = 0; i < n && space > 0; ++i){
+    size_t k = min(iov[i].iov_len, space);
+    size_t pos = (tail + total) & (RingSize - 1);
+    size_t m = min(k, RingSize - pos);
+    
+    memcpy(tx_->data + pos, iov[i].iov_base, m);
+    memcpy(tx_->data, (char*)iov[i].iov_base + m, k - m);
+    
+    total += k;
+    space -= k;
+  }
+  
+  tx_->tail = tail + total;
+  
+  if(tx_->readerWaiting && tx_->readerWaiting.exchange(0)){
+    ring();
+  }
+  
+  return total;
+}
+
+void ShmTransport::add(Connection* c){
+  NReactor::get()->add(c);
+  
+  hangup_ = new Hangup(fd_, c);
+  NReactor::get()->add(hangup_);
+}
+
+void ShmTransport::remove(Connection* c){
+  NReactor::get()->remove(hangup_);
+  NReactor::get()->remove(c);
+}
+
+#endif
+
+void DeliverProc::process(nvar& r){
+  c_->deliver();
+}
+
+SendProc::SendProc(NCommunicator_* c)
+: c_(c),
+transport_(c_->transport()),
+taken_(0),
+bytes_(0),
+first_(0){}
+
+void SendProc::clear(){
+  for(char* buf : bufs_){
+    free(buf);
+  }
+  
+  bufs_.clear();
+  iov_.clear();
+  first_ = 0;
+  bytes_ = 0;
+}
+
+bool SendProc::fill(){
+  size_t maxBatch = c_->maxBatch();
+  
+  while(iov_.size() < maxBatch){
+    NCommunicator_::Packed p;
+    if(!c_->get(p)){
+      break;
+    }
+    
+    ++taken_;
+    bytes_ += p.size;
+    
+    uint32_t size = p.size;
+    char* buf = c_->encrypt(p.buf, size);
+    
+    uint32_t s = size - 4;
+    memcpy(buf, &s, 4);
+    
+    bufs_.push_back(buf);
+    
+    iovec v;
+    v.iov_base = buf;
+    v.iov_len = size;
+    iov_.push_back(v);
+  }
+  
+  return !iov_.empty();
+}
+
+// a batch which only partly fit in the socket is kept until the
+// reactor finds the socket writable again
+
+void SendProc::process(nvar& r){
+  if(!c_->isConnected()){
     return;
   }
   
-  signal(task_, this);
+  for(;;){
+    if(first_ == iov_.size()){
+      if(!iov_.empty()){
+        c_->written(iov_.size(), bytes_);
+      }
+      
+      clear();
+      
+      if(!fill()){
+        size_t taken = taken_;
+        taken_ = 0;
+        
+        if(c_->sent(taken)){
+          return;
+        }
+        
+        continue;
+      }
+    }
+    
+    ssize_t n = transport_->write(iov_.data() + first_, iov_.size() - first_);
+    
+    if(n > 0){
+      while(n > 0){
+        iovec& v = iov_[first_];
+        
+        if(size_t(n) >= v.iov_len){
+          n -= v.iov_len;
+          ++first_;
+        }
+        else{
+          v.iov_base = (char*)v.iov_base + n;
+          v.iov_len -= n;
+          n = 0;
+        }
+      }
+      
+      continue;
+    }
+    
+    if(n < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      
+      if(errno == EAGAIN || errno == EWOULDBLOCK){
+        if(c_->wait()){
+          return;
+        }
+        
+        continue;
+      }
+    }
+    
+    c_->close();
+    return;
+  }
 }
 
 NCommunicator::NCommunicator(NProcTask* task){
@@ -374,8 +1722,12 @@ bool NCommunicator::connect(const nstr& host, int port){
   return x_->connect(host, port);
 }
 
-void NCommunicator::setSocket(NSocket* socket){
-  x_->setSocket(socket);
+bool NCommunicator::connect(const nstr& address){
+  return x_->connect(address);
+}
+
+void NCommunicator::setSocket(NSocket* socket, bool sharedMemory){
+  x_->setSocket(socket, sharedMemory);
 }
 
 NProcTask* NCommunicator::task(){
@@ -390,8 +1742,50 @@ bool NCommunicator::isConnected() const{
   return x_->isConnected();
 }
 
+void NCommunicator::setMaxBatch(size_t n){
+  x_->setMaxBatch(n);
+}
+
+void NCommunicator::setMaxMessageSize(size_t n){
+  x_->setMaxMessageSize(n);
+}
+
+void NCommunicator::setMinCompressSize(size_t n){
+  x_->setMinCompressSize(n);
+}
+
+void NCommunicator::setNoDelay(bool flag){
+  x_->setNoDelay(flag);
+}
+
+void NCommunicator::setCork(bool flag){
+  x_->setCork(flag);
+}
+
 void NCommunicator::send(nvar& msg){
-  x_->send(msg);
+  x_->send(msg, -1);
+}
+
+bool NCommunicator::send(nvar& msg, double timeout){
+  return x_->send(msg, timeout);
+}
+
+void NCommunicator::setSendWatermarks(size_t highCount,
+                                      size_t lowCount,
+                                      size_t highBytes,
+                                      size_t lowBytes){
+  x_->setSendWatermarks(highCount, lowCount, highBytes, lowBytes);
+}
+
+void NCommunicator::setReceiveWatermarks(size_t highCount,
+                                         size_t lowCount,
+                                         size_t highBytes,
+                                         size_t lowBytes){
+  x_->setReceiveWatermarks(highCount, lowCount, highBytes, lowBytes);
+}
+
+nvar NCommunicator::stats(){
+  return x_->stats();
 }
 
 bool NCommunicator::receive(nvar& msg){
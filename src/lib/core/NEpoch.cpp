@@ -0,0 +1,209 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#include <neu/NEpoch.h>
+
+#include <neu/NVector.h>
+#include <neu/NBasicMutex.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  struct Retired{
+    uint64_t epoch;
+    void* p;
+    NEpoch::Deleter deleter;
+  };
+  
+  class Global{
+  public:
+    Global()
+    : head_(0){}
+    
+    NEpoch::Record* attach(){
+      mutex_.lock();
+      
+      NEpoch::Record* r = head_;
+      while(r){
+        if(r->free){
+          r->free = false;
+          break;
+        }
+        
+        r = r->next;
+      }
+      
+      if(!r){
+        r = new NEpoch::Record;
+        r->epoch = 0;
+        r->free = false;
+        r->next = head_;
+        head_ = r;
+      }
+      
+      r->depth = 0;
+      
+      mutex_.unlock();
+      
+      return r;
+    }
+    
+    void detach(NEpoch::Record* r){
+      mutex_.lock();
+      r->epoch = 0;
+      r->free = true;
+      reclaim_();
+      mutex_.unlock();
+    }
+    
+    void retire(uint64_t epoch, void* p, NEpoch::Deleter deleter){
+      mutex_.lock();
+      retiredVec_.push_back({epoch, p, deleter});
+      reclaim_();
+      mutex_.unlock();
+    }
+    
+    void reclaim(){
+      mutex_.lock();
+      reclaim_();
+      mutex_.unlock();
+    }
+    
+  private:
+    // an object retired at epoch e can only be held by a reader which
+    // entered at an epoch <= e
+    void reclaim_(){
+      uint64_t minEpoch = UINT64_MAX;
+      
+      NEpoch::Record* r = head_;
+      while(r){
+        uint64_t e = r->epoch.load();
+        if(e != 0 && e < minEpoch){
+          minEpoch = e;
+        }
+        
+        r = r->next;
+      }
+      
+      size_t j = 0;
+      size_t size = retiredVec_.size();
+      for(size_t i = 0; i < size; ++i){
+        Retired& ri = retiredVec_[i];
+        
+        if(ri.epoch < minEpoch){
+          ri.deleter(ri.p);
+        }
+        else{
+          retiredVec_[j++] = ri;
+        }
+      }
+      
+      retiredVec_.resize(j);
+    }
+    
+    NEpoch::Record* head_;
+    NVector<Retired> retiredVec_;
+    NBasicMutex mutex_;
+  };
+  
+  // may be needed during static initialization of other modules,
+  // e.g: writes to the global scope
+  Global& global(){
+    static Global g;
+    return g;
+  }
+  
+  // returns this thread's record to the free list when it exits
+  class Detacher{
+  public:
+    Detacher()
+    : r(0){}
+    
+    ~Detacher(){
+      if(r){
+        global().detach(r);
+      }
+    }
+    
+    NEpoch::Record* r;
+  };
+  
+  thread_local Detacher _detacher;
+  
+} // end namespace
+
+atomic<uint64_t> NEpoch::epoch_(1);
+
+thread_local NEpoch::Record* NEpoch::record_ = 0;
+
+NEpoch::Record* NEpoch::attach_(){
+  record_ = global().attach();
+  _detacher.r = record_;
+  
+  return record_;
+}
+
+void NEpoch::retire(void* p, Deleter deleter){
+  // the object was unpublished before this increment, so any reader
+  // which observes the new epoch also observes the new version
+  uint64_t e = epoch_.fetch_add(1);
+  
+  global().retire(e, p, deleter);
+}
+
+void NEpoch::reclaim(){
+  global().reclaim();
+}
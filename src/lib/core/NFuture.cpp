@@ -0,0 +1,494 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#include <neu/NFuture.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include <neu/NProc.h>
+#include <neu/NError.h>
+#include <neu/NBasicMutex.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  class Continuation{
+  public:
+    Continuation()
+    : next(0){}
+    
+    virtual ~Continuation(){}
+    
+    virtual void run(NFuture_* f) = 0;
+    
+    Continuation* next;
+  };
+  
+} // end namespace
+
+namespace neu{
+  
+  class NFuture_{
+  public:
+    NFuture_()
+    : refs_(1),
+    ready_(false),
+    error_(0),
+    continuations_(0){}
+    
+    ~NFuture_(){
+      if(error_){
+        delete error_;
+      }
+    }
+    
+    void ref(){
+      ++refs_;
+    }
+    
+    void release(){
+      if(--refs_ == 0){
+        delete this;
+      }
+    }
+    
+    bool ready() const{
+      return ready_;
+    }
+    
+    void wait(){
+      if(ready_){
+        return;
+      }
+      
+      unique_lock<mutex> lock(mutex_.mutex());
+      
+      while(!ready_){
+        condition_.wait(lock);
+      }
+    }
+    
+    bool wait(double dt){
+      if(ready_){
+        return true;
+      }
+      
+      auto t = chrono::steady_clock::now() +
+      chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(dt));
+      
+      unique_lock<mutex> lock(mutex_.mutex());
+      
+      while(!ready_){
+        if(condition_.wait_until(lock, t) == cv_status::timeout){
+          return ready_;
+        }
+      }
+      
+      return true;
+    }
+    
+    const nvar& get(){
+      wait();
+      
+      if(error_){
+        throw NError(*error_);
+      }
+      
+      return v_;
+    }
+    
+    const nvar& value() const{
+      return v_;
+    }
+    
+    const NError* error() const{
+      return error_;
+    }
+    
+    void set(nvar& v){
+      mutex_.lock();
+      
+      if(ready_){
+        mutex_.unlock();
+        return;
+      }
+      
+      v_ = move(v);
+      complete();
+    }
+    
+    void setError(const NError& e){
+      mutex_.lock();
+      
+      if(ready_){
+        mutex_.unlock();
+        return;
+      }
+      
+      error_ = new NError(e);
+      complete();
+    }
+    
+    // runs c immediately if the result is already set
+    void then(Continuation* c){
+      mutex_.lock();
+      
+      if(!ready_){
+        c->next = continuations_;
+        continuations_ = c;
+        mutex_.unlock();
+        return;
+      }
+      
+      mutex_.unlock();
+      
+      c->run(this);
+      delete c;
+    }
+    
+  private:
+    atomic<uint32_t> refs_;
+    atomic_bool ready_;
+    nvar v_;
+    NError* error_;
+    Continuation* continuations_;
+    NBasicMutex mutex_;
+    condition_variable condition_;
+    
+    // called with mutex_ locked, which it unlocks
+    void complete(){
+      ready_ = true;
+      
+      Continuation* c = continuations_;
+      continuations_ = 0;
+      
+      mutex_.unlock();
+      
+      condition_.notify_all();
+      
+      // continuations were pushed in reverse order
+      Continuation* r = 0;
+      
+      while(c){
+        Continuation* next = c->next;
+        c->next = r;
+        r = c;
+        c = next;
+      }
+      
+      // keep this state alive while continuations release their
+      // references to it
+      ref();
+      
+      while(r){
+        Continuation* next = r->next;
+        r->run(this);
+        delete r;
+        r = next;
+      }
+      
+      release();
+    }
+  };
+  
+} // end namespace neu
+
+namespace{
+  
+  class Then : public Continuation{
+  public:
+    Then(NProcTask* task,
+         const NFuture& in,
+         const NFuture::Func& f,
+         double priority)
+    : task_(task),
+    in_(in),
+    f_(f),
+    priority_(priority){}
+    
+    void run(NFuture_* f){
+      if(f->error()){
+        out.setError(*f->error());
+        return;
+      }
+      
+      NFuture in = in_;
+      NFuture::Func func = f_;
+      
+      task_->submit([in, func]() -> nvar{
+        return func(in.get());
+      }, out, priority_);
+    }
+    
+    NPromise out;
+    
+  private:
+    NProcTask* task_;
+    NFuture in_;
+    NFuture::Func f_;
+    double priority_;
+  };
+  
+  class Notify : public Continuation{
+  public:
+    Notify(const function<void()>& f)
+    : f_(f){}
+    
+    void run(NFuture_* f){
+      f_();
+    }
+    
+  private:
+    function<void()> f_;
+  };
+  
+  class All{
+  public:
+    All(const NVector<NFuture>& fs)
+    : fs(fs),
+    count(fs.size()){}
+    
+    NVector<NFuture> fs;
+    atomic<size_t> count;
+    NPromise out;
+    
+    void done(){
+      if(--count > 0){
+        return;
+      }
+      
+      nvar v = nvec();
+      
+      for(const NFuture& f : fs){
+        try{
+          v << f.get();
+        }
+        catch(NError& e){
+          out.setError(e);
+          delete this;
+          return;
+        }
+      }
+      
+      out.set(move(v));
+      delete this;
+    }
+  };
+  
+  class AllPart : public Continuation{
+  public:
+    AllPart(All* all)
+    : all_(all){}
+    
+    void run(NFuture_* f){
+      all_->done();
+    }
+    
+  private:
+    All* all_;
+  };
+  
+} // end namespace
+
+NFuture::NFuture()
+: x_(0){}
+
+NFuture::NFuture(NFuture_* x)
+: x_(x){}
+
+NFuture::NFuture(const NFuture& f)
+: x_(f.x_){
+  if(x_){
+    x_->ref();
+  }
+}
+
+NFuture::~NFuture(){
+  if(x_){
+    x_->release();
+  }
+}
+
+NFuture& NFuture::operator=(const NFuture& f){
+  if(f.x_){
+    f.x_->ref();
+  }
+  
+  if(x_){
+    x_->release();
+  }
+  
+  x_ = f.x_;
+  
+  return *this;
+}
+
+bool NFuture::valid() const{
+  return x_;
+}
+
+bool NFuture::ready() const{
+  return x_ && x_->ready();
+}
+
+void NFuture::wait() const{
+  if(!x_){
+    NERROR("invalid future");
+  }
+  
+  x_->wait();
+}
+
+bool NFuture::wait(double dt) const{
+  if(!x_){
+    NERROR("invalid future");
+  }
+  
+  return x_->wait(dt);
+}
+
+const nvar& NFuture::get() const{
+  if(!x_){
+    NERROR("invalid future");
+  }
+  
+  return x_->get();
+}
+
+NFuture NFuture::then(NProcTask* task, const Func& f, double priority) const{
+  if(!x_){
+    NERROR("invalid future");
+  }
+  
+  Then* c = new Then(task, *this, f, priority);
+  NFuture out = c->out.future();
+  
+  x_->then(c);
+  
+  return out;
+}
+
+void NFuture::notify(const function<void()>& f) const{
+  if(!x_){
+    NERROR("invalid future");
+  }
+  
+  x_->then(new Notify(f));
+}
+
+NFuture NFuture::all(const NVector<NFuture>& fs){
+  if(fs.empty()){
+    NPromise p;
+    p.set(nvec());
+    return p.future();
+  }
+  
+  for(const NFuture& f : fs){
+    if(!f.x_){
+      NERROR("invalid future");
+    }
+  }
+  
+  All* all = new All(fs);
+  NFuture out = all->out.future();
+  
+  for(const NFuture& f : fs){
+    f.x_->then(new AllPart(all));
+  }
+  
+  return out;
+}
+
+NPromise::NPromise()
+: x_(new NFuture_){}
+
+NPromise::NPromise(const NPromise& p)
+: x_(p.x_){
+  x_->ref();
+}
+
+NPromise::~NPromise(){
+  x_->release();
+}
+
+NPromise& NPromise::operator=(const NPromise& p){
+  p.x_->ref();
+  x_->release();
+  x_ = p.x_;
+  
+  return *this;
+}
+
+NFuture NPromise::future() const{
+  x_->ref();
+  return NFuture(x_);
+}
+
+void NPromise::set(const nvar& v){
+  nvar c = v;
+  x_->set(c);
+}
+
+void NPromise::set(nvar&& v){
+  x_->set(v);
+}
+
+void NPromise::setError(const NError& e){
+  x_->setError(e);
+}
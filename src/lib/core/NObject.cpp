@@ -54,12 +54,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <neu/NObject.h>
 
+#include <atomic>
+
 #include <neu/NFuncMap.h>
 #include <neu/NScope.h>
 #include <neu/NClass.h>
 #include <neu/NThread.h>
 #include <neu/NRWMutex.h>
+#include <neu/NBasicMutex.h>
+#include <neu/NEpoch.h>
 #include <neu/NBroker.h>
+#include <neu/NProfiler.h>
+#include <neu/NObjectCompiler.h>
+#include <neu/NList.h>
 
 using namespace std;
 using namespace neu;
@@ -76,13 +83,14 @@ namespace{
   class Global{
   public:
     Global()
-    : globalScope_(new NScope){
+    : globalScope_(new NScope(false, true)){
       
       precedenceMap_("VarSet") = 17;
       precedenceMap_("Set") = 17;
       precedenceMap_("Var") = 17;
       precedenceMap_("Def") = 17;
       precedenceMap_("DefSym") = 17;
+      precedenceMap_("DefMemo") = 17;
       precedenceMap_("AddBy") = 17;
       precedenceMap_("SubBy") = 17;
       precedenceMap_("MulBy") = 17;
@@ -111,6 +119,18 @@ namespace{
       precedenceMap_("Dec") = 2;
       precedenceMap_("Inc") = 2;
       
+      // builtins whose result depends only on their arguments, these
+      // may be folded by optimize() when their arguments are literals
+      const char* pure[] =
+      {"Add", "Sub", "Mul", "Div", "Mod", "Neg", "LT", "LE", "GT", "GE",
+        "EQ", "NE", "And", "Or", "Not", "Pow", "Sqrt", "Exp", "Abs",
+        "Floor", "Ceil", "Log10", "Log", "Cos", "Acos", "Cosh", "Sin",
+        "Asin", "Sinh", "Tan", "Atan", "Tanh", "Inf", "NegInf", "Nan",
+        "Min", "Max", "Epsilon", 0};
+      
+      for(size_t i = 0; pure[i]; ++i){
+        pureMap_(pure[i]) = true;
+      }
     }
     
     NScope* globalScope(){
@@ -121,9 +141,14 @@ namespace{
       return precedenceMap_.get(op, -1);
     }
     
+    bool isPure(const nstr& f){
+      return pureMap_.has(f);
+    }
+    
   private:
     NScope* globalScope_;
     nvar precedenceMap_;
+    nvar pureMap_;
   };
   
   Global _global;
@@ -142,6 +167,10 @@ namespace{
           return 0;
       }
     }
+    
+    NObjectBase* reconstruct(const nvar& v){
+      return new NObject(v, NObject::Restore);
+    }
   };
   
   Class _class;
@@ -187,15 +216,138 @@ namespace neu{
       ScopeStack scopeStack;
     };
     
+    class ThreadData;
+    
+    // tracks the live ThreadData instances so that a thread which
+    // exits can release the contexts it created on objects which
+    // are still alive
+    class ContextRegistry{
+    public:
+      void add(ThreadData* threadData){
+        mutex_.lock();
+        threadDataMap_.insert({threadData->id(), threadData});
+        mutex_.unlock();
+      }
+      
+      void remove(uint64_t id){
+        mutex_.lock();
+        threadDataMap_.erase(id);
+        mutex_.unlock();
+      }
+      
+      bool has(uint64_t id){
+        mutex_.lock();
+        bool found = threadDataMap_.find(id) != threadDataMap_.end();
+        mutex_.unlock();
+        
+        return found;
+      }
+      
+      void release(uint64_t id, const NThread::id& threadId){
+        mutex_.lock();
+        auto itr = threadDataMap_.find(id);
+        if(itr != threadDataMap_.end()){
+          itr->second->release(threadId);
+        }
+        mutex_.unlock();
+      }
+      
+    private:
+      typedef NHashMap<uint64_t, ThreadData*> ThreadDataMap_;
+      
+      ThreadDataMap_ threadDataMap_;
+      NBasicMutex mutex_;
+    };
+    
+    // per-thread direct-mapped cache of the contexts belonging to
+    // this thread, keyed by ThreadData id - ids are never reused so
+    // a slot left behind by a deleted object can never match
+    class ContextCache{
+    public:
+      ContextCache()
+      : compactSize_(64){
+        for(size_t i = 0; i < Slots; ++i){
+          slots_[i].id = 0;
+          slots_[i].context = 0;
+        }
+      }
+      
+      ~ContextCache(){
+        NThread::id threadId = NThread::thisThreadId();
+        
+        for(uint64_t id : idVec_){
+          contextRegistry_.release(id, threadId);
+        }
+      }
+      
+      ThreadContext* get(uint64_t id) const{
+        const Slot& slot = slots_[id & (Slots - 1)];
+        return slot.id == id ? slot.context : 0;
+      }
+      
+      void put(uint64_t id, ThreadContext* context){
+        Slot& slot = slots_[id & (Slots - 1)];
+        slot.id = id;
+        slot.context = context;
+      }
+      
+      void added(uint64_t id){
+        if(idVec_.size() >= compactSize_){
+          compact();
+        }
+        
+        idVec_.push_back(id);
+      }
+      
+    private:
+      static const size_t Slots = 16;
+      
+      struct Slot{
+        uint64_t id;
+        ThreadContext* context;
+      };
+      
+      // drop the ids of objects which have since been deleted
+      void compact(){
+        NVector<uint64_t> idVec;
+        
+        for(uint64_t id : idVec_){
+          if(contextRegistry_.has(id)){
+            idVec.push_back(id);
+          }
+        }
+        
+        idVec_ = move(idVec);
+        
+        if(idVec_.size() * 2 > compactSize_){
+          compactSize_ *= 2;
+        }
+      }
+      
+      Slot slots_[Slots];
+      NVector<uint64_t> idVec_;
+      size_t compactSize_;
+    };
+    
     class ThreadData{
     public:
+      ThreadData()
+      : id_(++nextThreadDataId_){
+        contextRegistry_.add(this);
+      }
       
       ~ThreadData(){
+        contextRegistry_.remove(id_);
+        
         for(auto& itr : contextMap_){
           delete itr.second;
         }
       }
       
+      uint64_t id() const{
+        return id_;
+      }
+      
       ThreadContext*
       getContext(NObject_* obj, const NThread::id& threadId){
         
@@ -216,12 +368,25 @@ namespace neu{
         contextMap_.insert({threadId, context});
         contextMutex_.unlock();
         
+        contextCache_.added(id_);
+        
         return context;
       }
       
+      void release(const NThread::id& threadId){
+        contextMutex_.writeLock();
+        auto itr = contextMap_.find(threadId);
+        if(itr != contextMap_.end()){
+          delete itr->second;
+          contextMap_.erase(itr);
+        }
+        contextMutex_.unlock();
+      }
+      
     private:
       typedef NHashMap<NThread::id, ThreadContext*> ContextMap_;
       
+      uint64_t id_;
       ContextMap_ contextMap_;
       NRWMutex contextMutex_;
     };
@@ -232,8 +397,14 @@ namespace neu{
     strict_(true),
     handleSymbol_(false),
     sharedScope_(false),
+    optimize_(false),
     threadData_(0),
-    broker_(0){
+    broker_(0),
+    compiler_(0),
+    compileThreshold_(0),
+    tierMap_(new TierMap_),
+    memoSize_(1024),
+    memoized_(false){
       
       NScope* gs = _global.globalScope();
       mainContext_.pushScope(gs);
@@ -251,8 +422,14 @@ namespace neu{
     strict_(true),
     handleSymbol_(false),
     sharedScope_(true),
+    optimize_(false),
     threadData_(0),
-    broker_(0){
+    broker_(0),
+    compiler_(0),
+    compileThreshold_(0),
+    tierMap_(new TierMap_),
+    memoSize_(1024),
+    memoized_(false){
       
       NScope* gs = _global.globalScope();
       mainContext_.pushScope(gs);
@@ -270,8 +447,14 @@ namespace neu{
     exact_(false),
     strict_(true),
     sharedScope_(false),
+    optimize_(false),
     threadData_(0),
-    broker_(broker){
+    broker_(broker),
+    compiler_(0),
+    compileThreshold_(0),
+    tierMap_(new TierMap_),
+    memoSize_(1024),
+    memoized_(false){
       
       NScope* gs = _global.globalScope();
       mainContext_.pushScope(gs);
@@ -286,8 +469,14 @@ namespace neu{
     NObject_(NObject* o, const nvar& v, NObject::RestoreFlag)
     : o_(o),
     sharedScope_(false),
+    optimize_(false),
     threadData_(0),
-    broker_(0){
+    broker_(0),
+    compiler_(0),
+    compileThreshold_(0),
+    tierMap_(new TierMap_),
+    memoSize_(1024),
+    memoized_(false){
       
       const nvar& rv = v["NObject"];
       
@@ -308,8 +497,14 @@ namespace neu{
     NObject_(NObject* o, const nvar& v, NScope* sharedScope, NObject::RestoreFlag)
     : o_(o),
     sharedScope_(true),
+    optimize_(false),
     threadData_(0),
-    broker_(0){
+    broker_(0),
+    compiler_(0),
+    compileThreshold_(0),
+    tierMap_(new TierMap_),
+    memoSize_(1024),
+    memoized_(false){
       
       const nvar& rv = v["NObject"];
       
@@ -343,6 +538,18 @@ namespace neu{
       if(broker_){
         broker_->release(o_);
       }
+      
+      TierMap_* tm = tierMap_.load();
+      
+      for(auto& itr : *tm){
+        delete itr.second;
+      }
+      
+      delete tm;
+      
+      for(auto& itr : memoMap_){
+        delete itr.second;
+      }
     }
     
     void store(nvar& v) const{
@@ -377,6 +584,56 @@ namespace neu{
       handleSymbol_ = flag;
     }
     
+    void setOptimize(bool flag){
+      optimize_ = flag;
+    }
+    
+    void setCompiler(NObjectCompiler* compiler, size_t threshold){
+      compiler_ = compiler;
+      compileThreshold_ = threshold;
+    }
+    
+    void setMemoSize(size_t size){
+      memoMutex_.writeLock();
+      
+      memoSize_ = size;
+      
+      for(auto& itr : memoMap_){
+        itr.second->setCapacity(size);
+      }
+      
+      memoMutex_.unlock();
+    }
+    
+    nvar memoStats(){
+      nvar r;
+      
+      memoMutex_.readLock();
+      
+      for(auto& itr : memoMap_){
+        if(!itr.second->active){
+          continue;
+        }
+        
+        nstr label = itr.first.first + "/" + nvar(itr.first.second).toStr();
+        itr.second->stats(r(label));
+      }
+      
+      memoMutex_.unlock();
+      
+      return r;
+    }
+    
+    void clearMemo(){
+      memoMutex_.readLock();
+      
+      for(auto& itr : memoMap_){
+        itr.second->clear();
+      }
+      
+      memoMutex_.unlock();
+    }
+    
     bool isRemote(){
       return broker_;
     }
@@ -406,7 +663,17 @@ namespace neu{
           return &mainContext_;
         }
         
-        return threadData_->getContext(this, threadId);
+        uint64_t id = threadData_->id();
+        
+        ThreadContext* context = contextCache_.get(id);
+        if(context){
+          return context;
+        }
+        
+        context = threadData_->getContext(this, threadId);
+        contextCache_.put(id, context);
+        
+        return context;
       }
       
       return &mainContext_;
@@ -471,13 +738,32 @@ namespace neu{
         }
         
         if(scope->isLimiting()){
-          i = sharedScope_ ? 2 : 1;
+          i = sharedScope_ ? 3 : 2;
         }
       }
       
       return false;
     }
     
+    // returns the scope which call f of arity resolves to, or 0
+    NScope* functionScope(ThreadContext* context,
+                          const nstr& f,
+                          size_t arity){
+      for(int i = context->scopeStack.size() - 1; i >= 0; --i){
+        NScope* scope = context->getScope(i);
+        
+        if(scope->hasFunction(f, arity)){
+          return scope;
+        }
+        
+        if(scope->isLimiting()){
+          i = sharedScope_ ? 3 : 2;
+        }
+      }
+      
+      return 0;
+    }
+    
     nvar run(const nvar& v, uint32_t flags=0){
       // ******* it can be helpful to uncomment this line for debugging
       //cout << "processing: " << v << endl;
@@ -498,42 +784,14 @@ namespace neu{
             return (*fp)(o_, vd.funcStr(), vd.argVec());
           }
           
-          ThreadContext* context = getContext();
-          
-          nvar s;
-          nvar b;
-          if(getFunction(context, vd.str(), vd.size(), s, b)){
-            NScope scope(true);
-            context->pushScope(&scope);
-            
-            size_t size = vd.size();
-            for(size_t i = 0; i < size; ++i){
-              scope.setSymbolFast(s[i], vd[i].toPtr());
-            }
-            
-            try{
-              nvar r = run(b);
-              context->popScope();
-
-              switch(r.fullType()){
-                case nvar::Return:
-                  return none;
-                case nvar::ReturnVal:
-                  nvar* vp = r.varPtr();
-                  nvar ret = nvar(move(*vp));
-                  delete vp;
-                  return ret;
-              }
-              
+          if(memoized_){
+            nvar r;
+            if(runMemo(v, vd, r)){
               return r;
             }
-            catch(NError& e){
-              context->popScope();
-              throw e;
-            }
           }
           
-          return Throw(v, "failed to process function");
+          return runFunction(v, vd);
         }
         case nvar::Symbol:{
           nvar p;
@@ -547,6 +805,306 @@ namespace neu{
       return v;
     }
 
+    // runs user function call v, compiled if possible
+    nvar runFunction(const nvar& v, nvar& vd){
+      if(compiler_){
+        nvar r;
+        if(runCompiled(vd, r)){
+          return r;
+        }
+      }
+      
+      ThreadContext* context = getContext();
+      
+      nvar s;
+      nvar b;
+      if(getFunction(context, vd.str(), vd.size(), s, b)){
+        NScope scope(true);
+        context->pushScope(&scope);
+        
+        size_t size = vd.size();
+        for(size_t i = 0; i < size; ++i){
+          scope.setSymbolFast(s[i], vd[i].toPtr());
+        }
+        
+        bool profiling = NProfiler::active();
+        if(profiling){
+          NProfiler::enter(s);
+        }
+        
+        try{
+          nvar r = run(b);
+          context->popScope();
+          
+          if(profiling){
+            NProfiler::exit();
+          }
+
+          switch(r.fullType()){
+            case nvar::Return:
+              return none;
+            case nvar::ReturnVal:
+              nvar* vp = r.varPtr();
+              nvar ret = nvar(move(*vp));
+              delete vp;
+              return ret;
+          }
+          
+          return r;
+        }
+        catch(NError& e){
+          context->popScope();
+          
+          if(profiling){
+            NProfiler::exit();
+          }
+          
+          throw e;
+        }
+      }
+      
+      return Throw(v, "failed to process function");
+    }
+    
+    // sets r to the cached result of call v to a memoized function,
+    // keyed by the values of its arguments, running it on a miss.
+    // the arguments are evaluated first, as by Call, as those of a
+    // direct call may be expressions. returns false if the function
+    // is not memoized
+    bool runMemo(const nvar& v, nvar& vd, nvar& r){
+      memoMutex_.readLock();
+      
+      auto itr = memoMap_.find({vd.str(), vd.size()});
+      if(itr == memoMap_.end()){
+        memoMutex_.unlock();
+        return false;
+      }
+      
+      Memo* m = itr->second;
+      
+      memoMutex_.unlock();
+      
+      if(!m->active){
+        return false;
+      }
+      
+      // a definition of the same name and arity in a nearer scope,
+      // e.g: local to the calling function, shadows the memoized one
+      ThreadContext* context = getContext();
+      if(functionScope(context, vd.str(), vd.size()) !=
+         context->getScope(sharedScope_ ? 2 : 1)){
+        return false;
+      }
+      
+      size_t size = vd.size();
+      
+      nvar c(vd.str(), nvar::Func);
+      nvec k(size);
+      
+      for(size_t i = 0; i < size; ++i){
+        nvar a = run(vd[i]);
+        k[i] = *a;
+        c << move(a);
+      }
+      
+      nvar key(move(k));
+      
+      uint64_t generation;
+      if(m->get(key, r, generation)){
+        return true;
+      }
+      
+      r = runFunction(c, c);
+      m->put(key, *r, generation);
+      
+      return true;
+    }
+    
+    // runs the compiled specialization of function call v for the
+    // types of its arguments, compiling it once the function has
+    // been called compileThreshold_ times. returns false if the call
+    // must be interpreted. the tier map is read-copy-update, a tier
+    // discarded by a redefinition is reclaimed once no call can still
+    // be using it
+    bool runCompiled(const nvar& v, nvar& r){
+      size_t size = v.size();
+      if(size > 32){
+        return false;
+      }
+      
+      uint64_t code = 0;
+      
+      for(size_t i = 0; i < size; ++i){
+        switch((*v[i]).fullType()){
+          case nvar::Integer:
+            code |= uint64_t(1) << (i * 2);
+            break;
+          case nvar::Float:
+            code |= uint64_t(2) << (i * 2);
+            break;
+          default:
+            return false;
+        }
+      }
+      
+      NEpoch::Guard guard;
+      
+      const TierMap_& tm = *tierMap_.load();
+      
+      auto itr = tm.find({v.str(), size});
+      if(itr == tm.end()){
+        return false;
+      }
+      
+      Tier* t = itr->second;
+      
+      // a definition in a nearer scope shadows the compiled one, and
+      // after a Reset there is none
+      ThreadContext* context = getContext();
+      if(functionScope(context, v.str(), size) !=
+         context->getScope(sharedScope_ ? 2 : 1)){
+        return false;
+      }
+      
+      NCompiledFunc* f;
+      if(!t->get(code, f)){
+        // the count is only written until the threshold is reached
+        if(t->calls.load(memory_order_relaxed) < compileThreshold_ &&
+           ++t->calls < compileThreshold_){
+          return false;
+        }
+        
+        f = compile(v, code);
+      }
+      
+      return f && f->call(v, r);
+    }
+    
+    // compiles without holding the tier mutex, so that calls to other
+    // functions go on meanwhile. while one thread compiles a function,
+    // its calls on other threads are interpreted. called within the
+    // epoch guard of runCompiled()
+    NCompiledFunc* compile(const nvar& v, uint64_t code){
+      FuncKey_ k(v.str(), v.size());
+      
+      const TierMap_& tm = *tierMap_.load();
+      
+      auto itr = tm.find(k);
+      if(itr == tm.end()){
+        return 0;
+      }
+      
+      Tier* t = itr->second;
+      
+      if(t->compiling.exchange(true)){
+        return 0;
+      }
+      
+      nvar s;
+      nvar b;
+      if(!getFunction(getContext(), v.str(), v.size(), s, b)){
+        t->compiling = false;
+        return 0;
+      }
+      
+      nvec types;
+      for(size_t i = 0; i < v.size(); ++i){
+        types.push_back(((code >> (i * 2)) & 0x3) == 1 ?
+                        nvar::Integer : nvar::Float);
+      }
+      
+      NCompiledFunc* f = compiler_->compile(o_, s, b, types);
+      
+      tierMutex_.lock();
+      
+      // the function may have been redefined in the meantime
+      const TierMap_& cm = *tierMap_.load();
+      itr = cm.find(k);
+      if(itr == cm.end() || itr->second != t){
+        tierMutex_.unlock();
+        delete f;
+        return 0;
+      }
+      
+      Tier::Funcs_* fs = 0;
+      
+      NCompiledFunc* cf;
+      if(t->get(code, cf)){
+        delete f;
+        f = cf;
+      }
+      else{
+        fs = t->funcs.load();
+        Tier::Funcs_* nfs = new Tier::Funcs_(*fs);
+        nfs->push_back({code, f});
+        t->funcs.store(nfs);
+      }
+      
+      t->compiling = false;
+      
+      tierMutex_.unlock();
+      
+      if(fs){
+        NEpoch::retire(fs);
+      }
+      
+      return f;
+    }
+    
+    // only functions defined directly in the object scope are
+    // compiled, a definition anywhere else discards what was
+    // compiled for the same name and arity
+    void defTier(const nvar& s, bool objectScope){
+      FuncKey_ k(s.str(), s.size());
+      
+      tierMutex_.lock();
+      
+      TierMap_* tm = tierMap_.load();
+      
+      auto itr = tm->find(k);
+      if(itr == tm->end() && !objectScope){
+        tierMutex_.unlock();
+        return;
+      }
+      
+      TierMap_* nm = new TierMap_(*tm);
+      
+      Tier* t = 0;
+      
+      itr = nm->find(k);
+      if(itr != nm->end()){
+        t = itr->second;
+        nm->erase(itr);
+      }
+      
+      if(objectScope){
+        nm->insert({k, new Tier});
+      }
+      
+      tierMap_.store(nm);
+      
+      tierMutex_.unlock();
+      
+      NEpoch::retire(tm);
+      
+      if(t){
+        NEpoch::retire(t);
+      }
+    }
+    
+    // discards all that was compiled, e.g: on Reset
+    void clearTiers(){
+      tierMutex_.lock();
+      TierMap_* tm = tierMap_.exchange(new TierMap_);
+      tierMutex_.unlock();
+      
+      for(auto& itr : *tm){
+        NEpoch::retire(itr.second);
+      }
+      
+      NEpoch::retire(tm);
+    }
+    
     nvar Throw(const nvar& v1, const nvar& v2){
       nstr msg = v1.toStr() + ": ";
       
@@ -609,6 +1167,8 @@ namespace neu{
         mainContext_.getScope(1)->clear();
       }
       
+      clearTiers();
+      
       return none;
     }
     
@@ -706,6 +1266,175 @@ namespace neu{
       }
     }
     
+    // returns an optimized copy of v: constant calls to pure
+    // builtins are folded, If's with constant conditions are
+    // replaced by the branch taken, nested Block's are flattened and
+    // builtin calls are bound to their NFunc ahead of time. nodes which
+    // remain keep their __file/__line metadata. folding uses this
+    // object's current exact setting
+    nvar optimize(const nvar& v){
+      const nvar& vd = *v;
+      
+      if(vd.fullType() != nvar::Function){
+        return v;
+      }
+      
+      // copy the node so that the original code is left untouched
+      nvar r = vd;
+      optimizeNode_(r);
+      
+      return r;
+    }
+    
+    void optimizeNode_(nvar& v){
+      const nstr& f = v.str();
+      nvec& args = v.argVec();
+      size_t size = args.size();
+      
+      if(f == "Def" || f == "DefMemo"){
+        if(size == 2){
+          args[1] = optimize(args[1]);
+        }
+      }
+      else if(f == "Call"){
+        if(size == 1 || size == 2){
+          // the called function is a template for the evaluated args
+          const nvar& c = *args[size - 1];
+          
+          if(c.fullType() == nvar::Function){
+            nvar cr = c;
+            cr.argVec() = optimizeArgs_(cr.argVec());
+            args[size - 1] = move(cr);
+          }
+          
+          if(size == 2){
+            args[0] = optimize(args[0]);
+          }
+        }
+      }
+      else if(f == "In"){
+        if(size == 2){
+          args[0] = optimize(args[0]);
+        }
+        return;
+      }
+      else if(f == "DefSym" || f == "Class" || f == "New"){
+        return;
+      }
+      else{
+        args = optimizeArgs_(args);
+        
+        if(f == "Block" || f == "ScopedBlock"){
+          args = flatten_(args);
+        }
+        else if(f == "If" && (size == 2 || size == 3) &&
+                isLiteral_(args[0])){
+          nvar b;
+          
+          if(args[0]){
+            b = args[1];
+          }
+          else if(size == 3){
+            b = args[2];
+          }
+          else{
+            b = none;
+          }
+          
+          v = move(b);
+          return;
+        }
+        else if(_global.isPure(f) && allLiteral_(args)){
+          try{
+            nvar r = run(v);
+            
+            if(isLiteral_(r)){
+              v = move(r);
+              return;
+            }
+          }
+          catch(NError& e){
+            // leave it to fail at run time with its location
+          }
+        }
+      }
+      
+      if(!v.func()){
+        o_->handle(v);
+      }
+    }
+    
+    nvec optimizeArgs_(const nvec& args){
+      nvec r;
+      r.reserve(args.size());
+      
+      for(const nvar& a : args){
+        r.emplace_back(optimize(a));
+      }
+      
+      return r;
+    }
+    
+    // splice nested Block's into their parent and drop statements
+    // which became literals, except for the last which is the
+    // block's value
+    nvec flatten_(const nvec& args){
+      nvec sv;
+      
+      for(const nvar& a : args){
+        const nvar& ad = *a;
+        
+        if(ad.fullType() == nvar::Function && ad.str() == "Block"){
+          nvec& bv = ad.argVec();
+          for(const nvar& bi : bv){
+            sv.push_back(bi);
+          }
+        }
+        else{
+          sv.push_back(a);
+        }
+      }
+      
+      nvec r;
+      
+      size_t size = sv.size();
+      for(size_t i = 0; i < size; ++i){
+        if(i < size - 1 && isLiteral_(sv[i])){
+          continue;
+        }
+        
+        r.push_back(sv[i]);
+      }
+      
+      return r;
+    }
+    
+    static bool isLiteral_(const nvar& v){
+      switch((*v).fullType()){
+        case nvar::None:
+        case nvar::False:
+        case nvar::True:
+        case nvar::Integer:
+        case nvar::Rational:
+        case nvar::Float:
+        case nvar::Real:
+        case nvar::String:
+          return true;
+        default:
+          return false;
+      }
+    }
+    
+    static bool allLiteral_(const nvec& args){
+      for(const nvar& a : args){
+        if(!isLiteral_(a)){
+          return false;
+        }
+      }
+      
+      return true;
+    }
+    
     nvar Add(const nvar& v1, const nvar& v2){
       return run(v1) + run(v2);
     }
@@ -1006,8 +1735,19 @@ namespace neu{
       ThreadContext* context = getContext();
       
       NScope* scope = context->topScope();
-      scope->setFunction(v1, v2);
-
+      scope->setFunction(v1, optimize_ ? optimize(v2) : v2);
+      
+      bool objectScope =
+      context->scopeStack.size() == (sharedScope_ ? 3 : 2);
+      
+      if(compiler_){
+        defTier(v1, objectScope);
+      }
+      
+      if(objectScope && memoized_){
+        endMemo(v1);
+      }
+      
       return none;
     }
     
@@ -1024,10 +1764,62 @@ namespace neu{
       }
       
       scope->setFunction(v2, v3);
-
+      
+      if(compiler_){
+        defTier(v2, false);
+      }
+      
+      if(memoized_){
+        endMemo(v2);
+      }
+      
+      return none;
+    }
+    
+    // functions defined in the object scope are memoized, elsewhere
+    // DefMemo is the same as Def
+    nvar DefMemo(const nvar& v1, const nvar& v2){
+      Def(v1, v2);
+      
+      ThreadContext* context = getContext();
+      
+      if(context->scopeStack.size() != (sharedScope_ ? 3 : 2)){
+        return none;
+      }
+      
+      FuncKey_ k(v1.str(), v1.size());
+      
+      memoMutex_.writeLock();
+      
+      auto itr = memoMap_.find(k);
+      if(itr == memoMap_.end()){
+        memoMap_.insert({k, new Memo(memoSize_)});
+        memoized_ = true;
+      }
+      else{
+        itr->second->clear();
+        itr->second->active = true;
+      }
+      
+      memoMutex_.unlock();
+      
       return none;
     }
     
+    // a definition with Def which may replace a memoized function
+    // ends its memoization until it is defined again with DefMemo
+    void endMemo(const nvar& s){
+      memoMutex_.readLock();
+      
+      auto itr = memoMap_.find({s.str(), s.size()});
+      if(itr != memoMap_.end()){
+        itr->second->active = false;
+        itr->second->clear();
+      }
+      
+      memoMutex_.unlock();
+    }
+    
     nvar DefSym(const nvar& v1, const nvar& v2){
       ThreadContext* context = getContext();
       
@@ -1811,24 +2603,203 @@ namespace neu{
       return broker_->process_(o_, n);
     }
     
+    NFuture remoteRunAsync(const nvar& n){
+      assert(broker_);
+      
+      return broker_->processAsync_(o_, n);
+    }
+    
     void dumpScopes(){
       ThreadContext* context = getContext();
       context->dumpScopes();
     }
     
   private:
+    typedef pair<nstr, int16_t> FuncKey_;
+    
+    struct FuncHash_{
+      size_t operator()(const FuncKey_& k) const{
+        return hash<string>()(k.first.str()) ^ hash<int16_t>()(k.second);
+      }
+    };
+    
+    // call count and compiled specializations of a function, keyed
+    // by the argument types packed two bits per argument. the
+    // specializations are read-copy-update, as the tier map
+    class Tier{
+    public:
+      typedef NVector<pair<uint64_t, NCompiledFunc*>> Funcs_;
+      
+      Tier()
+      : calls(0),
+      compiling(false),
+      funcs(new Funcs_){}
+      
+      ~Tier(){
+        Funcs_* fs = funcs.load();
+        
+        for(auto& itr : *fs){
+          delete itr.second;
+        }
+        
+        delete fs;
+      }
+      
+      bool get(uint64_t code, NCompiledFunc*& f){
+        for(auto& itr : *funcs.load()){
+          if(itr.first == code){
+            f = itr.second;
+            return true;
+          }
+        }
+        
+        return false;
+      }
+      
+      atomic<size_t> calls;
+      atomic_bool compiling;
+      atomic<Funcs_*> funcs;
+    };
+    
+    typedef NHashMap<FuncKey_, Tier*, FuncHash_> TierMap_;
+    
+    // bounded LRU cache of the results of a memoized function
+    class Memo{
+    public:
+      typedef NList<pair<nvar, nvar>> List_;
+      
+      typedef NHashMap<nvar, List_::iterator,
+      nvarHash<nvar>, nvarEqual<nvar>> Map_;
+      
+      Memo(size_t capacity)
+      : active(true),
+      capacity_(capacity),
+      generation_(0),
+      hits_(0),
+      misses_(0){}
+      
+      // on a miss, sets generation to pass to put() so that a result
+      // computed before a clear() is not stored
+      bool get(const nvar& k, nvar& r, uint64_t& generation){
+        mutex_.lock();
+        
+        auto itr = map_.find(k);
+        if(itr == map_.end()){
+          ++misses_;
+          generation = generation_;
+          mutex_.unlock();
+          return false;
+        }
+        
+        ++hits_;
+        list_.splice(list_.begin(), list_, itr->second);
+        r = itr->second->second;
+        
+        mutex_.unlock();
+        
+        return true;
+      }
+      
+      void put(const nvar& k, const nvar& r, uint64_t generation){
+        mutex_.lock();
+        
+        if(generation != generation_){
+          mutex_.unlock();
+          return;
+        }
+        
+        // another thread may have computed the same call
+        auto itr = map_.find(k);
+        if(itr != map_.end()){
+          mutex_.unlock();
+          return;
+        }
+        
+        list_.push_front({k, r});
+        map_.insert({k, list_.begin()});
+        evict_();
+        
+        mutex_.unlock();
+      }
+      
+      void setCapacity(size_t capacity){
+        mutex_.lock();
+        capacity_ = capacity;
+        evict_();
+        mutex_.unlock();
+      }
+      
+      void clear(){
+        mutex_.lock();
+        list_.clear();
+        map_.clear();
+        ++generation_;
+        hits_ = 0;
+        misses_ = 0;
+        mutex_.unlock();
+      }
+      
+      void stats(nvar& r){
+        mutex_.lock();
+        r("hits") = hits_;
+        r("misses") = misses_;
+        r("size") = map_.size();
+        r("capacity") = capacity_;
+        mutex_.unlock();
+      }
+      
+      atomic<bool> active;
+      
+    private:
+      void evict_(){
+        while(map_.size() > capacity_){
+          map_.erase(list_.back().first);
+          list_.pop_back();
+        }
+      }
+      
+      size_t capacity_;
+      uint64_t generation_;
+      size_t hits_;
+      size_t misses_;
+      List_ list_;
+      Map_ map_;
+      NBasicMutex mutex_;
+    };
+    
+    typedef NHashMap<FuncKey_, Memo*, FuncHash_> MemoMap_;
+    
     NObject* o_;
     
     ThreadContext mainContext_;
     ThreadData* threadData_;
     NBroker* broker_;
+    NObjectCompiler* compiler_;
+    size_t compileThreshold_;
+    atomic<TierMap_*> tierMap_;
+    NBasicMutex tierMutex_;
+    size_t memoSize_;
+    atomic<bool> memoized_;
+    MemoMap_ memoMap_;
+    NRWMutex memoMutex_;
+    
+    static atomic<uint64_t> nextThreadDataId_;
+    static ContextRegistry contextRegistry_;
+    static thread_local ContextCache contextCache_;
     
     bool exact_ : 1;
     bool strict_ : 1;
     bool sharedScope_ : 1;
     bool handleSymbol_ : 1;
+    bool optimize_ : 1;
   };
   
+  atomic<uint64_t> NObject_::nextThreadDataId_(0);
+  
+  NObject_::ContextRegistry NObject_::contextRegistry_;
+  
+  thread_local NObject_::ContextCache NObject_::contextCache_;
+  
 } // end namespace neu
 
 FuncMap::FuncMap(){
@@ -2137,6 +3108,11 @@ FuncMap::FuncMap(){
         return NObject_::obj(o)->Def(v[0], v[1], v[2]);
       });
   
+  add("DefMemo", 2,
+      [](void* o, const nstr&, nvec& v) -> nvar{
+        return NObject_::obj(o)->DefMemo(v[0], v[1]);
+      });
+  
   add("DefSym", 2,
       [](void* o, const nstr&, nvec& v) -> nvar{
         return NObject_::obj(o)->DefSym(v[0], v[1]);
@@ -2671,6 +3647,10 @@ nvar NObject::remoteRun(const nvar& v){
   return x_->remoteRun(v);
 }
 
+NFuture NObject::remoteRunAsync(const nvar& v){
+  return x_->remoteRunAsync(v);
+}
+
 void NObject::store(nvar& v) const{
   x_->store(v);
 }
@@ -2695,6 +3675,26 @@ void NObject::setHandleSymbol(bool flag){
   x_->setHandleSymbol(flag);
 }
 
+void NObject::setOptimize(bool flag){
+  x_->setOptimize(flag);
+}
+
+void NObject::setCompiler(NObjectCompiler* compiler, size_t threshold){
+  x_->setCompiler(compiler, threshold);
+}
+
+void NObject::setMemoSize(size_t size){
+  x_->setMemoSize(size);
+}
+
+nvar NObject::memoStats(){
+  return x_->memoStats();
+}
+
+void NObject::clearMemo(){
+  x_->clearMemo();
+}
+
 bool NObject::isRemote(){
   return x_->isRemote();
 }
@@ -2707,6 +3707,10 @@ nvar NObject::Eval(const nvar& v){
   return x_->Eval(v);
 }
 
+nvar NObject::optimize(const nvar& v){
+  return x_->optimize(v);
+}
+
 nvar NObject::Throw(const nvar& v1, const nvar& v2){
   return x_->Throw(v1, v2);
 }
@@ -2943,6 +3947,10 @@ nvar NObject::Def(const nvar& v1, const nvar& v2, const nvar& v3){
   return x_->Def(v1, v2, v3);
 }
 
+nvar NObject::DefMemo(const nvar& v1, const nvar& v2){
+  return x_->DefMemo(v1, v2);
+}
+
 nvar NObject::DefSym(const nvar& v1, const nvar& v2){
   return x_->DefSym(v1, v2);
 }
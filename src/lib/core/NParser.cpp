@@ -654,11 +654,16 @@ namespace neu{
         Global* g = state->global;
         NProcTask* task = g->task;
         
+        NVector<NProc*> procs;
+        nvec rs;
+        
         for(Rule* p : rules_){
-          nvar r = state->copy();
+          procs.push_back(p);
+          rs.push_back(state->copy());
           state->global->start();
-          task->queue(p, r);
         }
+        
+        task->queueBatch(procs, rs);
       }
       
       void signalAll(Rule* caller,
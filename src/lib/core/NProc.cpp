@@ -52,32 +52,350 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  
 */
 
+
 #include <neu/NProc.h>
 
 #include <iostream>
 #include <queue>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <typeinfo>
+#include <cxxabi.h>
+#include <pthread.h>
+#include <unistd.h>
 
-#include <neu/NVSemaphore.h>
 #include <neu/NThread.h>
+#include <neu/NVSemaphore.h>
 #include <neu/NBasicMutex.h>
 #include <neu/NRWMutex.h>
+#include <neu/NSys.h>
+#include <neu/NError.h>
 
 using namespace std;
 using namespace neu;
 
 namespace{
   
-  class State{
+  // parses a cpu list as found in /sys, e.g: 0-3,8-11
+  void parseCPUs(const nstr& s, NVector<int>& cpus){
+    nvec ranges;
+    s.split(ranges, ",");
+    
+    for(const nvar& ri : ranges){
+      nstr range = ri.str();
+      range.strip();
+      
+      if(range.empty()){
+        continue;
+      }
+      
+      nvec ends;
+      range.split(ends, "-");
+      
+      int first = atoi(ends[0].c_str());
+      int last = ends.size() > 1 ? atoi(ends[1].c_str()) : first;
+      
+      for(int i = first; i <= last; ++i){
+        cpus.push_back(i);
+      }
+    }
+  }
+  
+  // the cpus of each NUMA node, a single node with every cpu where
+  // the topology is not available
+  void numaNodes(NVector<NVector<int>>& nodes){
+    for(size_t i = 0;; ++i){
+      ifstream f("/sys/devices/system/node/node" + nvar(i).toStr() +
+                 "/cpulist");
+      
+      if(!f.is_open()){
+        break;
+      }
+      
+      string line;
+      getline(f, line);
+      
+      NVector<int> cpus;
+      parseCPUs(line, cpus);
+      
+      if(!cpus.empty()){
+        nodes.emplace_back(move(cpus));
+      }
+    }
+    
+    if(nodes.empty()){
+      NVector<int> cpus;
+      
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      for(long i = 0; i < n; ++i){
+        cpus.push_back(i);
+      }
+      
+      nodes.emplace_back(move(cpus));
+    }
+  }
+  
+  uint64_t nanoseconds(){
+    return chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  
+  // statistics are only written by the worker which owns them, so
+  // they are updated without a locked instruction
+  void bump(atomic<uint64_t>& x, uint64_t d=1){
+    x.store(x.load(memory_order_relaxed) + d, memory_order_relaxed);
+  }
+  
+  // durations in buckets of powers of 2 nanoseconds
+  class Histogram{
+  public:
+    static const size_t Size = 40;
+    
+    Histogram(){
+      clear();
+    }
+    
+    void add(uint64_t ns){
+      size_t i = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+      bump(buckets_[i < Size ? i : Size - 1]);
+      bump(sum_, ns);
+      
+      if(ns > max_.load(memory_order_relaxed)){
+        max_.store(ns, memory_order_relaxed);
+      }
+    }
+    
+    void clear(){
+      for(size_t i = 0; i < Size; ++i){
+        buckets_[i] = 0;
+      }
+      
+      sum_ = 0;
+      max_ = 0;
+    }
+    
+    // accumulates into a histogram which is not being updated
+    void addTo(Histogram& h) const{
+      for(size_t i = 0; i < Size; ++i){
+        bump(h.buckets_[i], buckets_[i].load(memory_order_relaxed));
+      }
+      
+      bump(h.sum_, sum_.load(memory_order_relaxed));
+      
+      uint64_t m = max_.load(memory_order_relaxed);
+      if(m > h.max_){
+        h.max_ = m;
+      }
+    }
+    
+    uint64_t count() const{
+      uint64_t n = 0;
+      
+      for(size_t i = 0; i < Size; ++i){
+        n += buckets_[i].load(memory_order_relaxed);
+      }
+      
+      return n;
+    }
+    
+    // returns: [count:, mean:, max:, p50:, p90:, p99:], in seconds,
+    // percentiles are the upper bounds of their buckets
+    nvar toNvar() const{
+      uint64_t n = count();
+      
+      nvar v;
+      v("count") = n;
+      v("mean") = n == 0 ? 0.0 : sum_ / 1e9 / n;
+      v("max") = max_ / 1e9;
+      v("p50") = percentile(n, 0.5);
+      v("p90") = percentile(n, 0.9);
+      v("p99") = percentile(n, 0.99);
+      
+      return v;
+    }
+    
+  private:
+    atomic<uint64_t> buckets_[Size];
+    atomic<uint64_t> sum_;
+    atomic<uint64_t> max_;
+    
+    double percentile(uint64_t n, double q) const{
+      if(n == 0){
+        return 0;
+      }
+      
+      uint64_t k = 0;
+      
+      for(size_t i = 0; i < Size; ++i){
+        k += buckets_[i];
+        
+        if(k >= q * n){
+          return min(double(uint64_t(2) << i), double(max_)) / 1e9;
+        }
+      }
+      
+      return max_ / 1e9;
+    }
+  };
+  
+  nstr className(const type_info& t){
+    int status;
+    char* name = abi::__cxa_demangle(t.name(), 0, 0, &status);
+    
+    if(!name){
+      return t.name();
+    }
+    
+    nstr ret = name;
+    free(name);
+    
+    return ret;
+  }
+  
+  // runs the functions passed to NProcTask::submit()
+  
+  class FuncProc : public NProc{
+  public:
+    class Call{
+    public:
+      Call(const function<nvar()>& f, const NPromise& p)
+      : f(f),
+      p(p){}
+      
+      function<nvar()> f;
+      NPromise p;
+    };
+    
+    void run(nvar& r){
+      Call* c = r.ptr<Call>();
+      
+      try{
+        c->p.set(c->f());
+      }
+      catch(NError& e){
+        c->p.setError(e);
+      }
+      
+      delete c;
+    }
+    
+    bool dealloc_(nvar& r){
+      Call* c = r.ptr<Call>();
+      c->p.setError(NError("task shut down"));
+      delete c;
+      
+      return true;
+    }
+  };
+  
+  // runs the ranges of NProcTask::parallelFor(), each item claims
+  // ranges until none are left
+  
+  class ForProc : public NProc{
+  public:
+    typedef function<void(size_t, size_t)> Func;
+    
+    class Loop{
+    public:
+      Loop(size_t begin, size_t end, size_t chunk, const Func& f,
+           size_t refs)
+      : f(f),
+      begin(begin),
+      end(end),
+      chunk(chunk),
+      chunks((end - begin + chunk - 1)/chunk),
+      next(0),
+      remaining(chunks),
+      refs(refs),
+      error(0){}
+      
+      ~Loop(){
+        if(error){
+          delete error;
+        }
+      }
+      
+      void run(){
+        for(;;){
+          size_t i = next.fetch_add(1, memory_order_relaxed);
+          
+          if(i >= chunks){
+            return;
+          }
+          
+          size_t b = begin + i*chunk;
+          
+          try{
+            f(b, min(b + chunk, end));
+          }
+          catch(NError& e){
+            mutex.lock();
+            if(!error){
+              error = new NError(e);
+            }
+            mutex.unlock();
+          }
+          
+          if(--remaining == 0){
+            done.release();
+          }
+        }
+      }
+      
+      void release(){
+        if(--refs == 0){
+          delete this;
+        }
+      }
+      
+      Func f;
+      size_t begin;
+      size_t end;
+      size_t chunk;
+      size_t chunks;
+      atomic<size_t> next;
+      atomic<size_t> remaining;
+      atomic<size_t> refs;
+      NVSemaphore done;
+      NBasicMutex mutex;
+      NError* error;
+    };
+    
+    void run(nvar& r){
+      Loop* l = r.ptr<Loop>();
+      l->run();
+      l->release();
+    }
+    
+    bool dealloc_(nvar& r){
+      r.ptr<Loop>()->release();
+      
+      return true;
+    }
+  };
+  
+} // end namespace
+
+namespace neu{
+  
+  // the state of a proc in a task, a proc stores the state of the
+  // first task it is queued in, the states of any other tasks are
+  // kept in a map by those tasks
+  
+  class NProcState_{
   public:
     NProc* np;
+    NProcTask_* task;
     
-    State(NProc* np)
+    NProcState_(NProc* np, NProcTask_* task)
     : np(np),
+    task(task),
     queueCount_(0),
     terminated_(false){}
     
-    void queued(){
-      ++queueCount_;
+    void queued(uint32_t n=1){
+      queueCount_ += n;
     }
     
     bool dequeued(){
@@ -98,77 +416,100 @@ namespace{
     atomic_bool terminated_;
   };
   
-} // end namespace
-
-namespace neu{
+  // each worker thread owns a deque, items queued from a worker are
+  // pushed to and popped from the back of its own deque, idle workers
+  // steal from the front of the deques of other workers chosen at
+  // random. items with a priority other than 0 are kept in two
+  // shared lanes ordered by priority: items with a positive priority
+  // are run before any deque item, items with a negative priority
+  // only when there is nothing else to run
+  //
+  // items queued for later are kept by a timer thread, started on
+  // first use, in a hierarchical timing wheel with a resolution of
+  // 1 ms: four levels of 256 slots, a timer is placed in the lowest
+  // level whose slots cover its expiry and moved down a level each
+  // time the level below wraps around
   
   class NProcTask_{
   public:
+    typedef NProcState_ State;
+    
+    // items are recycled rather than deleted once run, each worker
+    // keeps a free list, which it hands to the shared free list once
+    // it grows past MaxFree, threads other than the workers take
+    // their items from the shared free list
+    
+    static const size_t MaxFree = 1024;
     
     class Item{
     public:
-      Item(State* s, nvar& r, double p)
-      : s(s),
-      r(move(r)),
-      p(p){}
-      
       State* s;
       nvar r;
       double p;
+      // 0 if statistics are off, otherwise 1, or when it was queued
+      // if it was sampled
+      uint64_t t;
+      Item* prev;
+      Item* next;
     };
     
-    class Queue{
+    class Lane{
     public:
-      Queue(){}
-      
-      ~Queue(){}
-      
-      void dealloc(NProcTask* task){
-        Item* item;
-        State* s;
-        
-        while(!queue_.empty()){
-          item = queue_.top();
-          queue_.pop();
-          
-          task->dealloc(item->r);
-          
-          s = item->s;
-          
-          if(s->dequeued()){
-            delete s->np;
-          }
-          
-          delete item;
-        }
-      }
+      Lane()
+      : size_(0){}
       
       void put(Item* item){
         mutex_.lock();
         queue_.push(item);
+        ++size_;
         mutex_.unlock();
+      }
+      
+      // puts a list of items linked through next
+      void putAll(Item* item){
+        mutex_.lock();
         
-        sem_.release();
+        while(item){
+          Item* next = item->next;
+          queue_.push(item);
+          ++size_;
+          item = next;
+        }
+        
+        mutex_.unlock();
       }
       
       Item* get(){
-        if(!sem_.acquire()){
+        if(size_ == 0){
           return 0;
         }
-
+        
         mutex_.lock();
+        
+        if(queue_.empty()){
+          mutex_.unlock();
+          return 0;
+        }
+        
         Item* item = queue_.top();
         queue_.pop();
+        --size_;
+        
         mutex_.unlock();
+        
         return item;
       }
-
-      void enable(){
-        sem_.enable();
-      }
       
-      void disable(){
-        sem_.disable();
+      Item* take(){
+        if(queue_.empty()){
+          return 0;
+        }
+        
+        Item* item = queue_.top();
+        queue_.pop();
+        --size_;
+        
+        return item;
       }
       
     private:
@@ -181,99 +522,1539 @@ namespace neu{
       typedef priority_queue<Item*, vector<Item*>, Compare_> Queue_;
       
       Queue_ queue_;
-      NVSemaphore sem_;
+      atomic<size_t> size_;
       NBasicMutex mutex_;
     };
     
-    class Thread : public NThread{
+    // a list of items linked through the items themselves
+    class Deque{
     public:
-      Thread(Queue& queue)
-      : queue_(queue){}
+      Deque()
+      : head_(0),
+      tail_(0){}
       
-      void run(){
-        State* s;
-        Item* item;
+      void push(Item* item){
+        mutex_.lock();
         
-        for(;;){
-          item = queue_.get();
+        item->prev = tail_;
+        item->next = 0;
+        
+        if(tail_){
+          tail_->next = item;
+        }
+        else{
+          head_ = item;
+        }
+        
+        tail_ = item;
+        
+        mutex_.unlock();
+      }
+      
+      // pushes a list of items linked through prev and next
+      void pushAll(Item* first, Item* last){
+        mutex_.lock();
+        
+        first->prev = tail_;
+        
+        if(tail_){
+          tail_->next = first;
+        }
+        else{
+          head_ = first;
+        }
+        
+        tail_ = last;
+        
+        mutex_.unlock();
+      }
+      
+      Item* pop(){
+        mutex_.lock();
+        
+        Item* item = tail_;
+        
+        if(item){
+          tail_ = item->prev;
           
-          if(item){
-            s = item->s;
-            
-            s->np->run(item->r);
-            
-            if(s->dequeued()){
-              delete s->np;
-            }
+          if(tail_){
+            tail_->next = 0;
+          }
+          else{
+            head_ = 0;
+          }
+        }
+        
+        mutex_.unlock();
+        
+        return item;
+      }
+      
+      // when wait is false, gives up on a deque which is locked by
+      // its owner or another thief
+      Item* steal(bool wait){
+        if(wait){
+          mutex_.lock();
+        }
+        else if(!mutex_.tryLock()){
+          return 0;
+        }
+        
+        Item* item = take();
+        
+        mutex_.unlock();
+        
+        return item;
+      }
+      
+      Item* take(){
+        Item* item = head_;
+        
+        if(item){
+          head_ = item->next;
           
-            delete item;
+          if(head_){
+            head_->prev = 0;
           }
           else{
-            break;
+            tail_ = 0;
           }
         }
+        
+        return item;
       }
       
     private:
-      Queue& queue_;
+      Item* head_;
+      Item* tail_;
+      NBasicMutex mutex_;
     };
     
-    NProcTask_(NProcTask* o, size_t threads)
-    : o_(o),
-    active_(true){
+    // statistics of a class of procs, as run by one worker
+    class ClassStats{
+    public:
+      ClassStats()
+      : tasks(0){}
       
-      for(size_t i = 0; i < threads; ++i){
-        Thread* thread = new Thread(q_);
-        threadVec_.push_back(thread);
-        thread->start();
-      }
-    }
-    
-    ~NProcTask_(){
-      shutdown();
-    }
+      atomic<uint64_t> tasks;
+      Histogram wait;
+      Histogram run;
+    };
     
-    void shutdown(){
-      if(!active_){
-        return;
-      }
-      
-      active_ = false;
+    class WorkerStats{
+    public:
+      typedef NHashMap<const type_info*, ClassStats*> ClassMap_;
       
-      q_.disable();
+      WorkerStats()
+      : queued(0),
+      started(0),
+      steals(0),
+      idle(0),
+      idleSince(0),
+      sample(0),
+      lastType(0),
+      lastClass(0){}
       
-      for(Thread* t : threadVec_){
-        t->join();
-        delete t;
+      ~WorkerStats(){
+        for(auto& itr : classMap){
+          delete itr.second;
+        }
       }
       
-      q_.dealloc(o_);
-      
-      for(auto& itr : stateMap_){
-        delete itr.second;
+      ClassStats* get(const type_info* t){
+        if(t == lastType){
+          return lastClass;
+        }
+        
+        auto itr = classMap.find(t);
+        
+        if(itr == classMap.end()){
+          // the map is only modified here, by its worker, while
+          // stats() may be reading it
+          mutex.lock();
+          itr = classMap.insert({t, new ClassStats}).first;
+          mutex.unlock();
+        }
+        
+        lastType = t;
+        lastClass = itr->second;
+        
+        return lastClass;
       }
-    }
-    
-    void queue(NProc* proc, nvar& r, double priority){
-      State* s = getState(proc);
       
-      if(s->terminated()){
-        return;
+      void clear(){
+        queued = 0;
+        started = 0;
+        steals = 0;
+        idle = 0;
+        
+        mutex.lock();
+        for(auto& itr : classMap){
+          itr.second->tasks = 0;
+          itr.second->wait.clear();
+          itr.second->run.clear();
+        }
+        mutex.unlock();
+      }
+      
+      atomic<uint64_t> queued;
+      atomic<uint64_t> started;
+      atomic<uint64_t> steals;
+      atomic<uint64_t> idle;
+      atomic<uint64_t> idleSince;
+      uint32_t sample;
+      ClassMap_ classMap;
+      NBasicMutex mutex;
+      const type_info* lastType;
+      ClassStats* lastClass;
+    };
+    
+    // samples the queue depth and logs statistics
+    class StatsProc : public NProc{
+    public:
+      StatsProc(NProcTask_* task)
+      : task_(task){}
+      
+      void run(nvar& r){
+        if(r == "log"){
+          task_->logStats();
+        }
+        else{
+          task_->sampleStats();
+        }
+      }
+      
+    private:
+      NProcTask_* task_;
+    };
+    
+    class Sample{
+    public:
+      double time;
+      uint64_t depth;
+      uint64_t tasks;
+    };
+    
+    static const size_t MaxSamples = 600;
+    
+    // one in SampleRate items has its wait and run times measured
+    static const uint32_t SampleRate = 16;
+    
+    class Worker : public NThread{
+    public:
+      Worker(NProcTask_* task, size_t index)
+      : task_(task),
+      index(index),
+      node(0),
+      seed(uint32_t(index) * 2654435761U + 1),
+      free(0),
+      freeCount(0){}
+      
+      void run(){
+        task_->init(this);
+        task_->work(this);
+      }
+      
+      uint32_t random(){
+        // xorshift
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+      }
+      
+      NProcTask_* task_;
+      size_t index;
+      size_t node;
+      NVector<int> cpus;
+      nstr name;
+      uint32_t seed;
+      Deque deque;
+      Item* free;
+      size_t freeCount;
+      WorkerStats stats;
+    };
+    
+    typedef NVector<Worker*> WorkerVec_;
+    
+    class Timer{
+    public:
+      uint64_t id;
+      State* s;
+      nvar r;
+      double p;
+      uint64_t expires;
+      uint64_t period;
+      Timer** list;
+      Timer* prev;
+      Timer* next;
+    };
+    
+    class TimerThread : public NThread{
+    public:
+      TimerThread(NProcTask_* task)
+      : task_(task){}
+      
+      void run(){
+        task_->runTimers();
+      }
+      
+    private:
+      NProcTask_* task_;
+    };
+    
+    static const size_t WheelBits = 8;
+    static const size_t WheelSize = 1 << WheelBits;
+    static const size_t WheelMask = WheelSize - 1;
+    static const size_t WheelLevels = 4;
+    
+    NProcTask_(NProcTask* o, const nvar& options)
+    : o_(o),
+    active_(true),
+    next_(0),
+    idle_(0),
+    searching_(0),
+    waking_(false),
+    epoch_(0),
+    free_(0),
+    timerThread_(0),
+    nextTimerId_(1),
+    tick_(0),
+    wakeTick_(0),
+    timerCount_(0),
+    overflow_(0),
+    start_(chrono::steady_clock::now()),
+    statsProc_(this),
+    stats_(false),
+    statsStart_(0),
+    externalQueued_(0),
+    sampleTimer_(0),
+    logTimer_(0),
+    logStream_(0),
+    logPeriod_(0),
+    externalSample_(0){
+      
+      for(size_t i = 0; i < WheelLevels; ++i){
+        for(size_t j = 0; j < WheelSize; ++j){
+          wheel_[i][j] = 0;
+        }
+      }
+      
+      size_t threads = options["threads"];
+      
+      NVector<NVector<int>> nodes;
+      
+      const nvar& cpus = options.get("cpus", none);
+      bool numa = options.get("numa", false);
+      
+      if(numa || cpus.hasVector()){
+        numaNodes(nodes);
+      }
+      
+      nodeWorkers_.resize(max(nodes.size(), size_t(1)));
+      
+      for(size_t i = 0; i < threads; ++i){
+        Worker* w = new Worker(this, i);
+        
+        if(options.has("name")){
+          w->name = options["name"].str() + ":" + nvar(i).toStr();
+        }
+        
+        if(cpus.hasVector() && cpus.size() > 0){
+          const nvar& ci = cpus[i % cpus.size()];
+          
+          if(ci.hasVector()){
+            for(size_t j = 0; j < ci.size(); ++j){
+              w->cpus.push_back(ci[j]);
+            }
+          }
+          else{
+            w->cpus.push_back(ci);
+          }
+          
+          w->node = nodeOf(nodes, w->cpus[0]);
+        }
+        else if(numa){
+          w->node = i % nodes.size();
+          w->cpus = nodes[w->node];
+        }
+        
+        nodeWorkers_[w->node].push_back(w);
+        workerVec_.push_back(w);
+      }
+      
+      for(Worker* w : workerVec_){
+        w->start();
+      }
+    }
+    
+    static size_t nodeOf(const NVector<NVector<int>>& nodes, int cpu){
+      for(size_t i = 0; i < nodes.size(); ++i){
+        for(int c : nodes[i]){
+          if(c == cpu){
+            return i;
+          }
+        }
+      }
+      
+      return 0;
+    }
+    
+    // names and pins w, from its own thread, so that the memory it
+    // allocates from then on is placed on its node
+    void init(Worker* w){
+      if(!w->name.empty()){
+        nstr name = w->name.substr(0, 15);
+#ifdef __APPLE__
+        pthread_setname_np(name.c_str());
+#else
+        pthread_setname_np(pthread_self(), name.c_str());
+#endif
+      }
+      
+#ifndef __APPLE__
+      if(!w->cpus.empty()){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        
+        for(int c : w->cpus){
+          CPU_SET(c, &set);
+        }
+        
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      }
+#endif
+    }
+    
+    size_t threads() const{
+      return workerVec_.size();
+    }
+    
+    int worker() const{
+      return current_ && current_->task_ == this ? current_->index : -1;
+    }
+    
+    size_t nodes() const{
+      return nodeWorkers_.size();
+    }
+    
+    size_t node(size_t worker) const{
+      return workerVec_[worker % workerVec_.size()]->node;
+    }
+    
+    ~NProcTask_(){
+      shutdown();
+      
+      deleteItems(free_);
+    }
+    
+    void shutdown(){
+      if(!active_){
+        return;
+      }
+      
+      active_ = false;
+      
+      wakeAll();
+      
+      for(Worker* w : workerVec_){
+        w->join();
+      }
+      
+      timerMutex_.lock();
+      timerCondition_.notify_one();
+      timerMutex_.unlock();
+      
+      if(timerThread_){
+        timerThread_->join();
+        delete timerThread_;
+        timerThread_ = 0;
+      }
+      
+      for(auto& itr : timerMap_){
+        Timer* t = itr.second;
+        
+        dealloc(t->s, t->r);
+        
+        if(t->s->dequeued()){
+          delete t->s->np;
+        }
+        
+        delete t;
+      }
+      
+      timerMap_.clear();
+      
+      Item* item;
+      
+      while((item = high_.take())){
+        dealloc(item);
+      }
+      
+      while((item = low_.take())){
+        dealloc(item);
+      }
+      
+      for(Worker* w : workerVec_){
+        while((item = w->deque.take())){
+          dealloc(item);
+        }
+        
+        deleteItems(w->free);
+        delete w;
+      }
+      
+      workerVec_.clear();
+      
+      for(State* s : stateVec_){
+        if(s->np){
+          s->np->state_ = 0;
+        }
+        
+        delete s;
+      }
+      
+      for(auto& itr : stateMap_){
+        delete itr.second;
+      }
+    }
+    
+    void dealloc(Item* item){
+      State* s = item->s;
+      
+      dealloc(s, item->r);
+      
+      if(s->dequeued()){
+        delete s->np;
+      }
+      
+      delete item;
+    }
+    
+    // the items of the task's own procs and of procs which release
+    // their own items are not passed to the outer dealloc()
+    void dealloc(State* s, nvar& r){
+      if(s->np == &statsProc_ || (s->np && s->np->dealloc_(r))){
+        return;
+      }
+      
+      o_->dealloc(r);
+    }
+    
+    void deleteItems(Item* item){
+      while(item){
+        Item* next = item->next;
+        delete item;
+        item = next;
+      }
+    }
+    
+    Item* newItem(Worker* w){
+      Item* item;
+      
+      if(w && w->free){
+        item = w->free;
+        w->free = item->next;
+        --w->freeCount;
+        return item;
+      }
+      
+      freeMutex_.lock();
+      
+      item = free_;
+      if(item){
+        free_ = item->next;
+        freeMutex_.unlock();
+        return item;
+      }
+      
+      freeMutex_.unlock();
+      
+      return new Item;
+    }
+    
+    void releaseItem(Worker* w, Item* item){
+      item->r = none;
+      item->next = w->free;
+      w->free = item;
+      
+      if(++w->freeCount < MaxFree){
+        return;
+      }
+      
+      Item* last = item;
+      while(last->next){
+        last = last->next;
+      }
+      
+      freeMutex_.lock();
+      last->next = free_;
+      free_ = w->free;
+      freeMutex_.unlock();
+      
+      w->free = 0;
+      w->freeCount = 0;
+    }
+    
+    void queue(NProc* proc, nvar& r, double priority, Worker* to=0){
+      State* s = getState(proc);
+      
+      if(s->terminated()){
+        return;
       }
       
       s->queued();
-      Item* item = new Item(s, r, priority);
-      q_.put(item);
+      
+      put(s, r, priority, to);
+    }
+    
+    void queueOn(NProc* proc, nvar& r, size_t worker){
+      if(workerVec_.empty()){
+        queue(proc, r, 0);
+        return;
+      }
+      
+      queue(proc, r, 0, workerVec_[worker % workerVec_.size()]);
+    }
+    
+    void queueOnNode(NProc* proc, nvar& r, size_t node){
+      WorkerVec_& ws = nodeWorkers_[node % nodeWorkers_.size()];
+      
+      if(ws.empty()){
+        queue(proc, r, 0);
+        return;
+      }
+      
+      // stay on the calling worker if it is on node
+      Worker* w = current_;
+      if(!w || w->task_ != this || w->node != node % nodeWorkers_.size()){
+        size_t i = next_.fetch_add(1, memory_order_relaxed);
+        w = ws[i % ws.size()];
+      }
+      
+      queue(proc, r, 0, w);
+    }
+    
+    // queues an item for s, which has already been counted as queued,
+    // to is the worker it should be placed on, if any
+    void put(State* s, nvar& r, double priority, Worker* to=0){
+      Worker* w = current_ && current_->task_ == this ? current_ : 0;
+      
+      Item* item = newItem(w);
+      item->s = s;
+      item->r = move(r);
+      item->p = priority;
+      item->t = stamp(w);
+      
+      if(priority > 0){
+        high_.put(item);
+      }
+      else if(priority < 0 || workerVec_.empty()){
+        low_.put(item);
+      }
+      else if(to){
+        to->deque.push(item);
+      }
+      else if(w){
+        w->deque.push(item);
+      }
+      else{
+        size_t i = next_.fetch_add(1, memory_order_relaxed);
+        workerVec_[i % workerVec_.size()]->deque.push(item);
+      }
+      
+      wake();
+    }
+    
+    // returns the t of an item queued by w, which is 0 if not called
+    // from a worker
+    uint64_t stamp(Worker* w){
+      if(!stats_.load(memory_order_relaxed)){
+        return 0;
+      }
+      
+      uint32_t sample;
+      
+      if(w){
+        bump(w->stats.queued);
+        sample = ++w->stats.sample;
+      }
+      else{
+        externalQueued_.fetch_add(1, memory_order_relaxed);
+        sample = ++externalSample_;
+      }
+      
+      return sample % SampleRate == 0 ? nanoseconds() : 1;
+    }
+    
+    // queues an item for each of rs, for procs[i], or for proc if
+    // procs is 0. items with a priority of 0 are split into one run
+    // for each worker, so each lock is taken once, and only as many
+    // workers are woken as there are runs
+    void queueBatch(NProc* proc, NProc* const* procs, nvec& rs,
+                    double priority){
+      size_t n = rs.size();
+      
+      if(n == 0){
+        return;
+      }
+      
+      State* s = 0;
+      
+      if(!procs){
+        s = getState(proc);
+        
+        if(s->terminated()){
+          rs.clear();
+          return;
+        }
+        
+        s->queued(n);
+      }
+      
+      Worker* w = current_ && current_->task_ == this ? current_ : 0;
+      
+      bool lane = priority != 0 || workerVec_.empty();
+      size_t runs = lane ? 1 : min(n, workerVec_.size());
+      size_t runSize = (n + runs - 1)/runs;
+      
+      Item* first = 0;
+      Item* last = 0;
+      size_t size = 0;
+      size_t run = 0;
+      
+      // the caller's own deque takes the first run
+      size_t start = w ? w->index :
+      next_.fetch_add(runs, memory_order_relaxed);
+      
+      for(size_t i = 0; i < n; ++i){
+        State* si = s;
+        
+        if(procs){
+          si = getState(procs[i]);
+          
+          if(si->terminated()){
+            continue;
+          }
+          
+          si->queued();
+        }
+        
+        Item* item = newItem(w);
+        item->s = si;
+        item->r = move(rs[i]);
+        item->p = priority;
+        item->t = stamp(w);
+        item->prev = last;
+        item->next = 0;
+        
+        if(last){
+          last->next = item;
+        }
+        else{
+          first = item;
+        }
+        
+        last = item;
+        
+        if(!lane && ++size == runSize){
+          workerVec_[(start + run++) % workerVec_.size()]->deque.pushAll(
+            first, last);
+          
+          first = 0;
+          last = 0;
+          size = 0;
+        }
+      }
+      
+      rs.clear();
+      
+      if(first){
+        if(priority > 0){
+          high_.putAll(first);
+        }
+        else if(lane){
+          low_.putAll(first);
+        }
+        else{
+          workerVec_[(start + run++) % workerVec_.size()]->deque.pushAll(
+            first, last);
+        }
+      }
+      
+      wake(lane ? n : run);
+    }
+    
+    // shared is set if the item was not taken from w's own deque
+    Item* next(Worker* w, bool wait, bool& shared){
+      shared = true;
+      
+      Item* item = high_.get();
+      if(item){
+        return item;
+      }
+      
+      item = w->deque.pop();
+      if(item){
+        shared = false;
+        return item;
+      }
+      
+      item = steal(w, wait);
+      if(item){
+        return item;
+      }
+      
+      return low_.get();
+    }
+    
+    // workers steal from the other workers of their node first
+    Item* steal(Worker* w, bool wait){
+      Item* item;
+      
+      if(nodeWorkers_.size() > 1){
+        item = steal(w, nodeWorkers_[w->node], wait);
+        if(item){
+          return item;
+        }
+      }
+      
+      return steal(w, workerVec_, wait);
+    }
+    
+    Item* steal(Worker* w, WorkerVec_& ws, bool wait){
+      size_t size = ws.size();
+      size_t start = w->random() % size;
+      
+      for(size_t i = 0; i < size; ++i){
+        Worker* v = ws[(start + i) % size];
+        
+        if(v != w){
+          Item* item = v->deque.steal(wait);
+          if(item){
+            if(item->t){
+              bump(w->stats.steals);
+            }
+            
+            return item;
+          }
+        }
+      }
+      
+      return 0;
+    }
+    
+    // a worker is searching from the time it wakes up until it finds
+    // an item or goes back to sleep, queue() doesn't wake a worker
+    // while another one is searching or being woken up. waking_ is
+    // cleared whenever a worker goes to or leaves the idle state
+    void work(Worker* w){
+      current_ = w;
+      
+      ++searching_;
+      bool searching = true;
+      
+      bool shared;
+      
+      while(active_){
+        Item* item = next(w, false, shared);
+        
+        if(!item){
+          // announce that we are about to sleep before checking for
+          // work a last time, so that queue() cannot miss waking us
+          uint64_t epoch = epoch_;
+          ++idle_;
+          waking_ = false;
+          
+          if(searching){
+            --searching_;
+            searching = false;
+          }
+          
+          item = next(w, true, shared);
+          
+          if(!item){
+            // utilization is measured by the time spent asleep
+            bool stats = stats_.load(memory_order_relaxed);
+            
+            if(stats){
+              w->stats.idleSince.store(nanoseconds(),
+                                       memory_order_relaxed);
+            }
+            
+            unique_lock<mutex> lock(sleepMutex_.mutex());
+            
+            while(epoch_ == epoch && active_){
+              condition_.wait(lock);
+            }
+            
+            lock.unlock();
+            
+            if(stats){
+              uint64_t since = w->stats.idleSince.exchange(0);
+              
+              if(since >= statsStart_){
+                bump(w->stats.idle, nanoseconds() - since);
+              }
+            }
+            
+            ++searching_;
+            --idle_;
+            waking_ = false;
+            searching = true;
+            continue;
+          }
+          
+          --idle_;
+          waking_ = false;
+        }
+        else if(searching){
+          searching = false;
+          
+          // the work is unevenly spread, have another worker look
+          // for more of it
+          if(--searching_ == 0 && shared){
+            wake();
+          }
+        }
+        
+        State* s = item->s;
+        
+        if(item->t){
+          WorkerStats& ws = w->stats;
+          ClassStats* cs = ws.get(&typeid(*s->np));
+          
+          bump(ws.started);
+          bump(cs->tasks);
+          
+          if(item->t > 1){
+            uint64_t start = nanoseconds();
+            s->np->run_(o_, item->r);
+            uint64_t end = nanoseconds();
+            
+            cs->wait.add(start > item->t ? start - item->t : 0);
+            cs->run.add(end - start);
+          }
+          else{
+            s->np->run_(o_, item->r);
+          }
+        }
+        else{
+          s->np->run_(o_, item->r);
+        }
+        
+        if(s->dequeued()){
+          delete s->np;
+        }
+        
+        releaseItem(w, item);
+      }
+      
+      current_ = 0;
+    }
+    
+    void wake(){
+      if(searching_ > 0 || idle_ == 0 || waking_.exchange(true)){
+        return;
+      }
+      
+      sleepMutex_.lock();
+      ++epoch_;
+      sleepMutex_.unlock();
+      
+      condition_.notify_one();
+    }
+    
+    // wakes up to n idle workers
+    void wake(size_t n){
+      if(n <= 1){
+        wake();
+        return;
+      }
+      
+      size_t idle = idle_;
+      
+      if(idle == 0){
+        return;
+      }
+      
+      sleepMutex_.lock();
+      ++epoch_;
+      sleepMutex_.unlock();
+      
+      if(n >= idle){
+        condition_.notify_all();
+        return;
+      }
+      
+      for(size_t i = 0; i < n; ++i){
+        condition_.notify_one();
+      }
+    }
+    
+    void wakeAll(){
+      sleepMutex_.lock();
+      ++epoch_;
+      sleepMutex_.unlock();
+      
+      condition_.notify_all();
+    }
+    
+    uint64_t ticks(double dt){
+      return dt <= 0 ? 0 : uint64_t(dt * 1000 + 0.5);
+    }
+    
+    uint64_t now(){
+      return chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - start_).count();
+    }
+    
+    uint64_t queueAfter(NProc* proc,
+                        nvar& r,
+                        double delay,
+                        double period,
+                        double priority){
+      State* s = getState(proc);
+      
+      if(s->terminated() || !active_){
+        return 0;
+      }
+      
+      s->queued();
+      
+      Timer* t = new Timer;
+      t->id = nextTimerId_++;
+      t->s = s;
+      t->r = move(r);
+      t->p = priority;
+      t->period = ticks(period);
+      
+      if(period > 0 && t->period == 0){
+        t->period = 1;
+      }
+      
+      uint64_t n = now();
+      
+      timerMutex_.lock();
+      
+      if(!timerThread_){
+        tick_ = n;
+        timerThread_ = new TimerThread(this);
+        timerThread_->start();
+      }
+      
+      // a timer always expires after the tick being processed
+      t->expires = max(n + ticks(delay), tick_ + 1);
+      
+      timerMap_.insert({t->id, t});
+      addTimer(t);
+      ++timerCount_;
+      
+      bool notify = t->expires < wakeTick_;
+      
+      timerMutex_.unlock();
+      
+      if(notify){
+        timerCondition_.notify_one();
+      }
+      
+      return t->id;
+    }
+    
+    bool cancel(uint64_t id){
+      timerMutex_.lock();
+      
+      auto itr = timerMap_.find(id);
+      if(itr == timerMap_.end()){
+        timerMutex_.unlock();
+        return false;
+      }
+      
+      Timer* t = itr->second;
+      timerMap_.erase(itr);
+      --timerCount_;
+      
+      // a periodic timer that is firing is released by fire()
+      if(!t->list){
+        timerMutex_.unlock();
+        return true;
+      }
+      
+      removeTimer(t);
+      
+      timerMutex_.unlock();
+      
+      dealloc(t->s, t->r);
+      
+      if(t->s->dequeued()){
+        delete t->s->np;
+      }
+      
+      delete t;
+      
+      return true;
+    }
+    
+    // places t in the lowest level of the wheel whose slots, from the
+    // current tick on, include t's expiry
+    void addTimer(Timer* t){
+      Timer** list = &overflow_;
+      
+      for(size_t i = 0; i < WheelLevels; ++i){
+        size_t shift = WheelBits * (i + 1);
+        
+        if((t->expires >> shift) == (tick_ >> shift)){
+          list = &wheel_[i][(t->expires >> (WheelBits * i)) & WheelMask];
+          break;
+        }
+      }
+      
+      t->list = list;
+      t->prev = 0;
+      t->next = *list;
+      
+      if(*list){
+        (*list)->prev = t;
+      }
+      
+      *list = t;
+    }
+    
+    void removeTimer(Timer* t){
+      if(t->prev){
+        t->prev->next = t->next;
+      }
+      else{
+        *t->list = t->next;
+      }
+      
+      if(t->next){
+        t->next->prev = t->prev;
+      }
+      
+      t->list = 0;
+    }
+    
+    // re-adds the timers of list relative to the current tick
+    void cascade(Timer** list){
+      Timer* t = *list;
+      *list = 0;
+      
+      while(t){
+        Timer* next = t->next;
+        addTimer(t);
+        t = next;
+      }
+    }
+    
+    // processes the ticks up to to, appending expired timers to fired
+    void advance(uint64_t to, Timer*& fired){
+      if(timerCount_ == 0){
+        tick_ = max(tick_, to);
+        return;
+      }
+      
+      while(tick_ < to){
+        uint64_t t = ++tick_;
+        
+        for(size_t i = 1; i <= WheelLevels; ++i){
+          size_t shift = WheelBits * i;
+          
+          if((t & ((uint64_t(1) << shift) - 1)) != 0){
+            break;
+          }
+          
+          if(i == WheelLevels){
+            cascade(&overflow_);
+          }
+          else{
+            cascade(&wheel_[i][(t >> shift) & WheelMask]);
+          }
+        }
+        
+        Timer*& slot = wheel_[0][t & WheelMask];
+        
+        while(slot){
+          Timer* e = slot;
+          removeTimer(e);
+          
+          if(e->period == 0){
+            timerMap_.erase(e->id);
+            --timerCount_;
+          }
+          
+          e->next = fired;
+          fired = e;
+        }
+      }
+    }
+    
+    // returns the next tick at which advance() has something to do:
+    // the next non-empty slot of the lowest level or, failing that,
+    // the end of its current round
+    uint64_t nextTick(){
+      if(timerCount_ == 0){
+        return UINT64_MAX;
+      }
+      
+      uint64_t end = (tick_ | WheelMask) + 1;
+      
+      for(uint64_t t = tick_ + 1; t < end; ++t){
+        if(wheel_[0][t & WheelMask]){
+          return t;
+        }
+      }
+      
+      return end;
+    }
+    
+    void runTimers(){
+      unique_lock<mutex> lock(timerMutex_.mutex());
+      
+      while(active_){
+        Timer* fired = 0;
+        advance(now(), fired);
+        
+        if(fired){
+          lock.unlock();
+          fire(fired);
+          lock.lock();
+          continue;
+        }
+        
+        wakeTick_ = nextTick();
+        
+        if(wakeTick_ == UINT64_MAX){
+          timerCondition_.wait(lock);
+        }
+        else{
+          timerCondition_.wait_until(lock,
+                                     start_ + chrono::milliseconds(wakeTick_));
+        }
+        
+        wakeTick_ = 0;
+      }
+    }
+    
+    void fire(Timer* t){
+      while(t){
+        Timer* next = t->next;
+        State* s = t->s;
+        
+        if(t->period == 0){
+          put(s, t->r, t->p);
+          delete t;
+          t = next;
+          continue;
+        }
+        
+        nvar r;
+        
+        timerMutex_.lock();
+        
+        // the timer may have been cancelled meanwhile
+        bool armed = timerMap_.has(t->id);
+        
+        if(armed && s->terminated()){
+          timerMap_.erase(t->id);
+          --timerCount_;
+          armed = false;
+        }
+        
+        double p = t->p;
+        
+        if(armed){
+          s->queued();
+          r = t->r;
+          t->expires = max(t->expires + t->period, tick_ + 1);
+          addTimer(t);
+        }
+        
+        timerMutex_.unlock();
+        
+        if(armed){
+          put(s, r, p);
+        }
+        else{
+          dealloc(t->s, t->r);
+          
+          if(s->dequeued()){
+            delete s->np;
+          }
+          
+          delete t;
+        }
+        
+        t = next;
+      }
+    }
+    
+    void startStats(double interval){
+      stopStats();
+      
+      for(Worker* w : workerVec_){
+        w->stats.clear();
+      }
+      
+      externalQueued_ = 0;
+      
+      samplesMutex_.lock();
+      samples_.clear();
+      samplesMutex_.unlock();
+      
+      statsStart_ = nanoseconds();
+      stats_ = true;
+      
+      nvar r;
+      sampleTimer_ = queueAfter(&statsProc_, r, interval, interval, 1);
+      
+      if(logStream_ && logPeriod_ > 0){
+        r = "log";
+        logTimer_ = queueAfter(&statsProc_, r, logPeriod_, logPeriod_, 1);
+      }
+    }
+    
+    void stopStats(){
+      if(!stats_){
+        return;
+      }
+      
+      stats_ = false;
+      
+      cancel(sampleTimer_);
+      cancel(logTimer_);
+      sampleTimer_ = 0;
+      logTimer_ = 0;
+    }
+    
+    void logStats(ostream& ostr, double period){
+      cancel(logTimer_);
+      logTimer_ = 0;
+      
+      logStream_ = &ostr;
+      logPeriod_ = period;
+      
+      if(stats_ && period > 0){
+        nvar r = "log";
+        logTimer_ = queueAfter(&statsProc_, r, period, period, 1);
+      }
+    }
+    
+    // the number of items queued and not yet started, tasks is set
+    // to the number of items started
+    uint64_t depth(uint64_t& tasks){
+      uint64_t queued = externalQueued_;
+      tasks = 0;
+      
+      for(Worker* w : workerVec_){
+        queued += w->stats.queued.load(memory_order_relaxed);
+        tasks += w->stats.started.load(memory_order_relaxed);
+      }
+      
+      return queued > tasks ? queued - tasks : 0;
+    }
+    
+    void sampleStats(){
+      Sample s;
+      s.time = (nanoseconds() - statsStart_) / 1e9;
+      s.depth = depth(s.tasks);
+      
+      samplesMutex_.lock();
+      
+      if(samples_.size() == MaxSamples){
+        samples_.pop_front();
+      }
+      
+      samples_.push_back(s);
+      
+      samplesMutex_.unlock();
+    }
+    
+    void logStats(){
+      nvar s = stats();
+      
+      const nvar& wait = s["wait"];
+      const nvar& run = s["run"];
+      
+      ostringstream ostr;
+      
+      ostr << "NProcTask: tasks/s: " << s["tasksPerSecond"] <<
+      ", depth: " << s["depth"] <<
+      ", utilization: " << double(s["utilization"]) * 100 << "%" <<
+      ", steals: " << s["steals"] <<
+      ", wait p50/p99: " << wait["p50"] << "/" << wait["p99"] <<
+      ", run p50/p99: " << run["p50"] << "/" << run["p99"] << endl;
+      
+      *logStream_ << ostr.str();
+    }
+    
+    nvar stats(){
+      double elapsed =
+      stats_ || statsStart_ ? (nanoseconds() - statsStart_) / 1e9 : 0;
+      
+      nvar v;
+      v("enabled") = bool(stats_);
+      v("elapsed") = elapsed;
+      v("threads") = workerVec_.size();
+      
+      uint64_t tasks;
+      v("depth") = depth(tasks);
+      v("tasks") = tasks;
+      
+      double recent = elapsed > 0 ? tasks / elapsed : 0;
+      
+      Histogram wait;
+      Histogram run;
+      
+      NMap<nstr, ClassStats*> classes;
+      
+      uint64_t steals = 0;
+      double busy = 0;
+      uint64_t now = nanoseconds();
+      
+      nvar& workers = v("workers");
+      workers = nvec();
+      
+      for(Worker* w : workerVec_){
+        WorkerStats& ws = w->stats;
+        
+        nvar wv;
+        wv("tasks") = ws.started.load(memory_order_relaxed);
+        wv("steals") = ws.steals.load(memory_order_relaxed);
+        
+        uint64_t idle = ws.idle.load(memory_order_relaxed);
+        uint64_t since = ws.idleSince.load(memory_order_relaxed);
+        
+        if(since >= statsStart_ && since < now){
+          idle += now - since;
+        }
+        
+        double b = max(elapsed - idle / 1e9, 0.0);
+        wv("utilization") = elapsed > 0 ? min(b / elapsed, 1.0) : 0.0;
+        workers << move(wv);
+        
+        steals += ws.steals.load(memory_order_relaxed);
+        busy += b;
+        
+        ws.mutex.lock();
+        
+        for(auto& itr : ws.classMap){
+          ClassStats* cs = itr.second;
+          
+          cs->wait.addTo(wait);
+          cs->run.addTo(run);
+          
+          ClassStats*& c = classes[className(*itr.first)];
+          
+          if(!c){
+            c = new ClassStats;
+          }
+          
+          bump(c->tasks, cs->tasks.load(memory_order_relaxed));
+          cs->wait.addTo(c->wait);
+          cs->run.addTo(c->run);
+        }
+        
+        ws.mutex.unlock();
+      }
+      
+      v("steals") = steals;
+      v("utilization") = elapsed > 0 && !workerVec_.empty() ?
+      min(busy / elapsed / workerVec_.size(), 1.0) : 0.0;
+      v("wait") = wait.toNvar();
+      v("run") = run.toNvar();
+      
+      nvar& procs = v("procs");
+      procs = nmap();
+      
+      for(auto& itr : classes){
+        nvar& p = procs(itr.first);
+        ClassStats* c = itr.second;
+        
+        p("tasks") = c->tasks.load();
+        p("wait") = c->wait.toNvar();
+        p("run") = c->run.toNvar();
+        
+        delete c;
+      }
+      
+      nvar& samples = v("samples");
+      samples = nvec();
+      
+      samplesMutex_.lock();
+      
+      const Sample* last = 0;
+      
+      for(const Sample& s : samples_){
+        nvar sv;
+        sv("time") = s.time;
+        sv("depth") = s.depth;
+        
+        if(last && s.time > last->time){
+          sv("tasksPerSecond") = (s.tasks - last->tasks) / (s.time - last->time);
+        }
+        else{
+          sv("tasksPerSecond") = s.time > 0 ? s.tasks / s.time : 0.0;
+        }
+        
+        samples << move(sv);
+        last = &s;
+      }
+      
+      // the rate over the last two samples, if there are any
+      if(samples_.size() > 1){
+        recent = samples.back()["tasksPerSecond"];
+      }
+      
+      samplesMutex_.unlock();
+      
+      v("tasksPerSecond") = recent;
+      
+      return v;
+    }
+    
+    NProc* funcProc(){
+      return &funcProc_;
+    }
+    
+    NProc* forProc(){
+      return &forProc_;
     }
     
     State* getState(NProc* np){
+      State* s = np->state_.load(memory_order_acquire);
+      
+      if(!s){
+        s = new State(np, this);
+        
+        State* e = 0;
+        if(np->state_.compare_exchange_strong(e, s)){
+          stateMutex_.lock();
+          stateVec_.push_back(s);
+          stateMutex_.unlock();
+          
+          return s;
+        }
+        
+        delete s;
+        s = e;
+      }
+      
+      if(s->task == this){
+        return s;
+      }
+      
+      return getMappedState(np);
+    }
+    
+    State* getMappedState(NProc* np){
       mutex_.readLock();
 
       auto itr = stateMap_.find(np);
       if(itr == stateMap_.end()){
         mutex_.unlock();
       
-        State* state = new State(np);
+        State* state = new State(np, this);
 
         mutex_.writeLock();
         stateMap_.insert({np, state});
@@ -289,6 +2070,12 @@ namespace neu{
     }
     
     bool terminate(NProc* np){
+      State* s = np->state_.load(memory_order_acquire);
+      
+      if(s && s->task == this){
+        return s->terminate();
+      }
+      
       mutex_.readLock();
       
       auto itr = stateMap_.find(np);
@@ -297,29 +2084,123 @@ namespace neu{
         return true;
       }
       
-      State* s = itr->second;
+      s = itr->second;
       mutex_.unlock();
       
       return s->terminate();
     }
     
   private:
-    typedef NVector<Thread*> ThreadVec_;
     typedef NHashMap<NProc*, State*> StateMap_;
     
     NProcTask* o_;
-    Queue q_;
-    ThreadVec_ threadVec_;
-    bool active_;
+    WorkerVec_ workerVec_;
+    NVector<WorkerVec_> nodeWorkers_;
+    atomic_bool active_;
+    Lane high_;
+    Lane low_;
+    atomic<size_t> next_;
+    atomic<size_t> idle_;
+    atomic<size_t> searching_;
+    atomic_bool waking_;
+    atomic<uint64_t> epoch_;
+    NBasicMutex sleepMutex_;
+    condition_variable condition_;
+    Item* free_;
+    NBasicMutex freeMutex_;
+    NVector<State*> stateVec_;
+    NBasicMutex stateMutex_;
+    FuncProc funcProc_;
+    ForProc forProc_;
+    StatsProc statsProc_;
+    atomic_bool stats_;
+    uint64_t statsStart_;
+    atomic<uint64_t> externalQueued_;
+    uint64_t sampleTimer_;
+    uint64_t logTimer_;
+    ostream* logStream_;
+    double logPeriod_;
+    NList<Sample> samples_;
+    atomic<uint32_t> externalSample_;
+    NBasicMutex samplesMutex_;
+    TimerThread* timerThread_;
+    atomic<uint64_t> nextTimerId_;
+    uint64_t tick_;
+    uint64_t wakeTick_;
+    size_t timerCount_;
+    Timer* wheel_[WheelLevels][WheelSize];
+    Timer* overflow_;
+    NHashMap<uint64_t, Timer*> timerMap_;
+    NBasicMutex timerMutex_;
+    condition_variable timerCondition_;
+    chrono::steady_clock::time_point start_;
     StateMap_ stateMap_;
     NRWMutex mutex_;
+    
+    static thread_local Worker* current_;
   };
   
+  thread_local NProcTask_::Worker* NProcTask_::current_ = 0;
+  
 } // end namespace neu
 
+NProc::~NProc(){
+  NProcState_* s = state_;
+  
+  if(s){
+    s->np = 0;
+  }
+}
 
 NProcTask::NProcTask(size_t threads){
-  x_ = new NProcTask_(this, threads);
+  nvar options;
+  options("threads") = threads;
+  
+  x_ = new NProcTask_(this, options);
+}
+
+NProcTask::NProcTask(const nvar& options){
+  x_ = new NProcTask_(this, options);
+}
+
+size_t NProcTask::threads() const{
+  return x_->threads();
+}
+
+int NProcTask::worker() const{
+  return x_->worker();
+}
+
+size_t NProcTask::nodes() const{
+  return x_->nodes();
+}
+
+size_t NProcTask::node(size_t worker) const{
+  return x_->node(worker);
+}
+
+void NProcTask::startStats(double interval){
+  x_->startStats(interval);
+}
+
+void NProcTask::stopStats(){
+  x_->stopStats();
+}
+
+nvar NProcTask::stats(){
+  return x_->stats();
+}
+
+void NProcTask::logStats(ostream& ostr, double period){
+  x_->logStats(ostr, period);
+}
+
+void NProcTask::queueOn(NProc* proc, nvar& r, size_t worker){
+  x_->queueOn(proc, r, worker);
+}
+
+void NProcTask::queueOnNode(NProc* proc, nvar& r, size_t node){
+  x_->queueOnNode(proc, r, node);
 }
 
 NProcTask::~NProcTask(){
@@ -334,6 +2215,92 @@ void NProcTask::queue(NProc* proc, nvar& r, double priority){
   x_->queue(proc, r, priority);
 }
 
+void NProcTask::queueBatch(NProc* proc, nvec& rs, double priority){
+  x_->queueBatch(proc, 0, rs, priority);
+}
+
+void NProcTask::queueBatch(const NVector<NProc*>& procs,
+                           nvec& rs,
+                           double priority){
+  if(procs.size() != rs.size()){
+    NERROR("procs and rs differ in size");
+  }
+  
+  x_->queueBatch(0, procs.data(), rs, priority);
+}
+
+void NProcTask::parallelFor(size_t begin,
+                            size_t end,
+                            size_t chunk,
+                            const function<void(size_t, size_t)>& f,
+                            double priority){
+  if(end <= begin){
+    return;
+  }
+  
+  if(chunk == 0){
+    chunk = 1;
+  }
+  
+  // the caller runs ranges too
+  size_t chunks = (end - begin + chunk - 1)/chunk;
+  size_t n = min(chunks - 1, threads());
+  
+  ForProc::Loop* l = new ForProc::Loop(begin, end, chunk, f, n + 1);
+  
+  if(n > 0){
+    nvec rs(n, nvar(l));
+    x_->queueBatch(x_->forProc(), 0, rs, priority);
+  }
+  
+  l->run();
+  
+  if(l->remaining > 0){
+    l->done.acquire();
+  }
+  
+  if(l->error){
+    NError e = *l->error;
+    l->release();
+    throw e;
+  }
+  
+  l->release();
+}
+
+void NProcTask::submit(const function<nvar()>& f,
+                       const NPromise& p,
+                       double priority){
+  nvar r = new FuncProc::Call(f, p);
+  x_->queue(x_->funcProc(), r, priority);
+}
+
+uint64_t NProcTask::queueAfter(NProc* proc,
+                               nvar& r,
+                               double delay,
+                               double priority){
+  return x_->queueAfter(proc, r, delay, 0, priority);
+}
+
+uint64_t NProcTask::queueAt(NProc* proc,
+                            nvar& r,
+                            double time,
+                            double priority){
+  return x_->queueAfter(proc, r, time - NSys::now(), 0, priority);
+}
+
+uint64_t NProcTask::queueEvery(NProc* proc,
+                               const nvar& r,
+                               double period,
+                               double priority){
+  nvar rc = r;
+  return x_->queueAfter(proc, rc, period, period, priority);
+}
+
+bool NProcTask::cancel(uint64_t timer){
+  return x_->cancel(timer);
+}
+
 bool NProcTask::terminate(NProc* proc){
   return x_->terminate(proc);
 }
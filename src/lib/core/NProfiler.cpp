@@ -0,0 +1,674 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#include <neu/NProfiler.h>
+
+#include <chrono>
+#include <algorithm>
+
+#include <neu/NThread.h>
+#include <neu/NBasicMutex.h>
+#include <neu/NSys.h>
+#include <neu/NMap.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  typedef chrono::steady_clock Clock;
+  
+  double now(){
+    return chrono::duration<double>(Clock::now().time_since_epoch()).count();
+  }
+  
+#ifdef NEU_PROFILE_ALLOC
+  thread_local uint64_t _allocations = 0;
+#endif
+  
+  uint64_t allocations(){
+#ifdef NEU_PROFILE_ALLOC
+    return _allocations;
+#else
+    return 0;
+#endif
+  }
+  
+  const uint32_t NoFunc = UINT32_MAX;
+  
+  struct Function{
+    nstr label;
+    nstr name;
+    size_t arity;
+    nstr file;
+    size_t line;
+  };
+  
+  struct Stats{
+    Stats()
+    : calls(0),
+    inclusive(0),
+    exclusive(0),
+    allocations(0),
+    samples(0),
+    inclusiveSamples(0),
+    depth(0){}
+    
+    uint64_t calls;
+    double inclusive;
+    double exclusive;
+    uint64_t allocations;
+    uint64_t samples;
+    uint64_t inclusiveSamples;
+    uint32_t depth;
+  };
+  
+  // a node in a thread's call tree, node 0 is the root
+  struct Node{
+    Node(uint32_t func, uint32_t parent)
+    : func(func),
+    parent(parent),
+    exclusive(0),
+    samples(0){}
+    
+    uint32_t func;
+    uint32_t parent;
+    double exclusive;
+    uint64_t samples;
+    NHashMap<uint32_t, uint32_t> children;
+  };
+  
+  struct FuncKey{
+    FuncKey(const nvar& s)
+    : name(s.str()),
+    arity(s.size()),
+    file(s.getFile()),
+    line(s.getLine()){}
+    
+    bool operator==(const FuncKey& k) const{
+      return line == k.line && arity == k.arity && name == k.name &&
+      file == k.file;
+    }
+    
+    nstr name;
+    size_t arity;
+    nstr file;
+    size_t line;
+  };
+  
+  struct FuncKeyHash{
+    size_t operator()(const FuncKey& k) const{
+      return hash<string>()(k.name.str()) ^ hash<size_t>()(k.arity) ^
+      hash<size_t>()(k.line << 8);
+    }
+  };
+  
+  struct Frame{
+    const nvar* s;
+    uint32_t func;
+    uint32_t node;
+    double start;
+    double child;
+    uint64_t allocations;
+    uint64_t childAllocations;
+  };
+  
+  class ThreadProfile{
+  public:
+    ThreadProfile(){
+      clear();
+    }
+    
+    void clear(){
+      stats.clear();
+      nodes.clear();
+      nodes.emplace_back(Node(NoFunc, 0));
+    }
+    
+    Stats& getStats(uint32_t func){
+      if(func >= stats.size()){
+        stats.resize(func + 1);
+      }
+      
+      return stats[func];
+    }
+    
+    uint32_t child(uint32_t node, uint32_t func){
+      auto itr = nodes[node].children.find(func);
+      if(itr != nodes[node].children.end()){
+        return itr->second;
+      }
+      
+      uint32_t c = nodes.size();
+      nodes.emplace_back(Node(func, node));
+      nodes[node].children.insert({func, c});
+      
+      return c;
+    }
+    
+    // adds the stats and call tree of p, a node always comes after
+    // its parent
+    void merge(ThreadProfile* p){
+      for(size_t i = 0; i < p->stats.size(); ++i){
+        const Stats& si = p->stats[i];
+        Stats& ti = getStats(i);
+        
+        ti.calls += si.calls;
+        ti.inclusive += si.inclusive;
+        ti.exclusive += si.exclusive;
+        ti.allocations += si.allocations;
+        ti.samples += si.samples;
+        ti.inclusiveSamples += si.inclusiveSamples;
+      }
+      
+      NVector<uint32_t> m(p->nodes.size(), 0);
+      
+      for(size_t i = 1; i < p->nodes.size(); ++i){
+        const Node& n = p->nodes[i];
+        
+        m[i] = child(m[n.parent], n.func);
+        
+        nodes[m[i]].exclusive += n.exclusive;
+        nodes[m[i]].samples += n.samples;
+      }
+    }
+    
+    NBasicMutex mutex;
+    NVector<Frame> stack;
+    NVector<Stats> stats;
+    NVector<Node> nodes;
+    NHashMap<FuncKey, uint32_t, FuncKeyHash> funcCache;
+  };
+  
+  class Sampler : public NThread{
+  public:
+    Sampler(double interval)
+    : interval_(interval),
+    done_(false){}
+    
+    void run();
+    
+    void finish(){
+      done_ = true;
+    }
+    
+  private:
+    double interval_;
+    atomic_bool done_;
+  };
+  
+  // the profiles of the threads running profiled code, and that of
+  // the threads which have exited, into which theirs were merged
+  
+  class Global{
+  public:
+    Global()
+    : mode_(NProfiler::Exact),
+    sampler_(0){
+      profiles_.push_back(&exited_);
+    }
+    
+    void start(uint32_t mode, double interval){
+      stop();
+      
+      mode_ = mode;
+      
+      if(mode_ & NProfiler::Sampling){
+        sampler_ = new Sampler(interval);
+        sampler_->start();
+      }
+    }
+    
+    void stop(){
+      if(sampler_){
+        sampler_->finish();
+        sampler_->join();
+        delete sampler_;
+        sampler_ = 0;
+      }
+    }
+    
+    uint32_t mode(){
+      return mode_;
+    }
+    
+    ThreadProfile* add(){
+      ThreadProfile* p = new ThreadProfile;
+      
+      profilesMutex_.lock();
+      profiles_.push_back(p);
+      profilesMutex_.unlock();
+      
+      return p;
+    }
+    
+    // called as the thread of p exits
+    void remove(ThreadProfile* p){
+      profilesMutex_.lock();
+      
+      auto itr = find(profiles_.begin(), profiles_.end(), p);
+      if(itr != profiles_.end()){
+        profiles_.erase(itr);
+      }
+      
+      exited_.mutex.lock();
+      exited_.merge(p);
+      exited_.mutex.unlock();
+      
+      profilesMutex_.unlock();
+      
+      delete p;
+    }
+    
+    uint32_t getFunc(const nvar& s){
+      nstr file = s.getFile();
+      size_t line = s.getLine();
+      
+      nstr label = s.str() + "/" + nvar(s.size()).toStr();
+      if(!file.empty() || line > 0){
+        label += "@" + s.getLocation();
+      }
+      
+      mutex_.lock();
+      
+      auto itr = funcMap_.find(label);
+      if(itr != funcMap_.end()){
+        uint32_t func = itr->second;
+        mutex_.unlock();
+        return func;
+      }
+      
+      uint32_t func = funcVec_.size();
+      funcVec_.push_back({label, s.str(), s.size(), file, line});
+      funcMap_.insert({label, func});
+      
+      mutex_.unlock();
+      
+      return func;
+    }
+    
+    Function getFunction(uint32_t func){
+      mutex_.lock();
+      Function f = funcVec_[func];
+      mutex_.unlock();
+      
+      return f;
+    }
+    
+    // holds the profiles mutex so that no profile is removed while
+    // f runs on it
+    template<class F>
+    void eachProfile(F f){
+      profilesMutex_.lock();
+      
+      for(ThreadProfile* p : profiles_){
+        p->mutex.lock();
+        f(p);
+        p->mutex.unlock();
+      }
+      
+      profilesMutex_.unlock();
+    }
+    
+  private:
+    uint32_t mode_;
+    Sampler* sampler_;
+    ThreadProfile exited_;
+    NVector<ThreadProfile*> profiles_;
+    NBasicMutex profilesMutex_;
+    NHashMap<nstr, uint32_t> funcMap_;
+    NVector<Function> funcVec_;
+    NBasicMutex mutex_;
+  };
+  
+  Global _global;
+  
+  thread_local ThreadProfile* _profile = 0;
+  
+  // set along with _profile, hands it back as its thread exits
+  class ProfileOwner{
+  public:
+    ProfileOwner()
+    : profile(0){}
+    
+    ~ProfileOwner(){
+      if(profile){
+        _profile = 0;
+        _global.remove(profile);
+      }
+    }
+    
+    ThreadProfile* profile;
+  };
+  
+  thread_local ProfileOwner _owner;
+  
+  uint32_t getFunc(ThreadProfile* p, const nvar& s){
+    FuncKey key(s);
+    
+    auto itr = p->funcCache.find(key);
+    if(itr != p->funcCache.end()){
+      return itr->second;
+    }
+    
+    uint32_t func = _global.getFunc(s);
+    p->funcCache.insert({key, func});
+    
+    return func;
+  }
+  
+  // record one sample of each thread's shadow stack
+  void Sampler::run(){
+    while(!done_){
+      NSys::sleep(interval_);
+      
+      _global.eachProfile([](ThreadProfile* p){
+        size_t size = p->stack.size();
+        if(size == 0){
+          return;
+        }
+        
+        uint32_t node = 0;
+        NVector<uint32_t> seen;
+        
+        for(size_t i = 0; i < size; ++i){
+          Frame& f = p->stack[i];
+          
+          if(f.func == NoFunc){
+            f.func = getFunc(p, *f.s);
+          }
+          
+          node = p->child(node, f.func);
+          
+          if(find(seen.begin(), seen.end(), f.func) == seen.end()){
+            seen.push_back(f.func);
+            ++p->getStats(f.func).inclusiveSamples;
+          }
+        }
+        
+        ++p->nodes[node].samples;
+        ++p->getStats(p->stack.back().func).samples;
+      });
+    }
+  }
+  
+  nstr stackLabel(ThreadProfile* p, uint32_t node){
+    nstr s;
+    
+    while(node != 0){
+      const Node& n = p->nodes[node];
+      nstr label = _global.getFunction(n.func).label;
+      s = s.empty() ? label : label + ";" + s;
+      node = n.parent;
+    }
+    
+    return s;
+  }
+  
+} // end namespace
+
+#ifdef NEU_PROFILE_ALLOC
+
+void* operator new(size_t size){
+  ++_allocations;
+  
+  void* p = malloc(size);
+  if(!p){
+    throw bad_alloc();
+  }
+  
+  return p;
+}
+
+void operator delete(void* p) noexcept{
+  free(p);
+}
+
+#endif
+
+atomic_bool NProfiler::active_(false);
+
+void NProfiler::start(uint32_t mode, double interval){
+  active_ = false;
+  
+  _global.start(mode, interval);
+  
+  active_ = true;
+}
+
+void NProfiler::stop(){
+  active_ = false;
+  
+  _global.stop();
+}
+
+void NProfiler::clear(){
+  _global.eachProfile([](ThreadProfile* p){
+    p->clear();
+  });
+}
+
+void NProfiler::enter(const nvar& s){
+  ThreadProfile* p = _profile;
+  
+  if(!p){
+    p = _profile = _owner.profile = _global.add();
+  }
+  
+  p->mutex.lock();
+  
+  if(_global.mode() & Sampling){
+    p->stack.push_back({&s, NoFunc, 0, 0, 0, 0, 0});
+    p->mutex.unlock();
+    return;
+  }
+  
+  uint32_t func = getFunc(p, s);
+  uint32_t parent = p->stack.empty() ? 0 : p->stack.back().node;
+  if(parent >= p->nodes.size()){
+    parent = 0;
+  }
+  
+  Stats& stats = p->getStats(func);
+  ++stats.calls;
+  ++stats.depth;
+  
+  p->stack.push_back({&s, func, p->child(parent, func),
+    0, 0, allocations(), 0});
+  
+  p->mutex.unlock();
+  
+  p->stack.back().start = now();
+}
+
+void NProfiler::exit(){
+  double t = now();
+  uint64_t a = allocations();
+  
+  ThreadProfile* p = _profile;
+  
+  if(!p){
+    return;
+  }
+  
+  p->mutex.lock();
+  
+  if(p->stack.empty()){
+    p->mutex.unlock();
+    return;
+  }
+  
+  Frame f = p->stack.back();
+  p->stack.pop_back();
+  
+  if(f.start == 0){
+    p->mutex.unlock();
+    return;
+  }
+  
+  double dt = t - f.start;
+  uint64_t da = a - f.allocations;
+  
+  Stats& stats = p->getStats(f.func);
+  
+  // only the outermost of recursive calls counts towards inclusive
+  if(stats.depth > 0 && --stats.depth == 0){
+    stats.inclusive += dt;
+  }
+  
+  stats.exclusive += dt - f.child;
+  stats.allocations += da - f.childAllocations;
+  
+  // the tree may have been cleared while this call was active
+  if(f.node < p->nodes.size()){
+    p->nodes[f.node].exclusive += dt - f.child;
+  }
+  
+  if(!p->stack.empty()){
+    Frame& parent = p->stack.back();
+    parent.child += dt;
+    parent.childAllocations += da;
+  }
+  
+  p->mutex.unlock();
+}
+
+nvar NProfiler::report(){
+  NVector<Stats> total;
+  
+  _global.eachProfile([&](ThreadProfile* p){
+    if(p->stats.size() > total.size()){
+      total.resize(p->stats.size());
+    }
+    
+    for(size_t i = 0; i < p->stats.size(); ++i){
+      const Stats& si = p->stats[i];
+      Stats& ti = total[i];
+      
+      ti.calls += si.calls;
+      ti.inclusive += si.inclusive;
+      ti.exclusive += si.exclusive;
+      ti.allocations += si.allocations;
+      ti.samples += si.samples;
+      ti.inclusiveSamples += si.inclusiveSamples;
+    }
+  });
+  
+  bool sampling = _global.mode() & Sampling;
+  
+  NVector<uint32_t> funcs;
+  for(size_t i = 0; i < total.size(); ++i){
+    if(total[i].calls > 0 || total[i].inclusiveSamples > 0){
+      funcs.push_back(i);
+    }
+  }
+  
+  sort(funcs.begin(), funcs.end(), [&](uint32_t a, uint32_t b){
+    return sampling ? total[a].samples > total[b].samples :
+    total[a].exclusive > total[b].exclusive;
+  });
+  
+  nvar r;
+  r("mode") = sampling ? "sampling" : "exact";
+  
+  nvar& fv = r("functions");
+  fv = nvec();
+  
+  for(uint32_t func : funcs){
+    Function f = _global.getFunction(func);
+    const Stats& s = total[func];
+    
+    nvar fi;
+    fi("name") = f.name;
+    fi("arity") = f.arity;
+    fi("file") = f.file;
+    fi("line") = f.line;
+    fi("calls") = s.calls;
+    fi("inclusive") = s.inclusive;
+    fi("exclusive") = s.exclusive;
+    fi("allocations") = s.allocations;
+    fi("samples") = s.samples;
+    fi("inclusiveSamples") = s.inclusiveSamples;
+    
+    fv << move(fi);
+  }
+  
+  return r;
+}
+
+nstr NProfiler::collapsed(){
+  bool sampling = _global.mode() & Sampling;
+  
+  NMap<nstr, double> m;
+  
+  _global.eachProfile([&](ThreadProfile* p){
+    for(size_t i = 1; i < p->nodes.size(); ++i){
+      const Node& n = p->nodes[i];
+      
+      double c = sampling ? n.samples : n.exclusive * 1e6;
+      if(c <= 0){
+        continue;
+      }
+      
+      m[stackLabel(p, i)] += c;
+    }
+  });
+  
+  nstr s;
+  for(auto& itr : m){
+    s += itr.first + " " + nvar(int64_t(itr.second)).toStr() + "\n";
+  }
+  
+  return s;
+}
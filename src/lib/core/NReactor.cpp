@@ -0,0 +1,353 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#include <neu/NReactor.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#endif
+
+#include <neu/nvar.h>
+#include <neu/NBasicMutex.h>
+#include <neu/NError.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  const size_t MaxEvents = 256;
+  
+  thread_local bool _inReactor = false;
+  
+  // drains the pipe written to by call() to wake the reactor
+  
+  class WakeHandler : public NReactor::Handler{
+  public:
+    WakeHandler(int fd)
+    : NReactor::Handler(fd){}
+    
+    bool onEvent(uint32_t events){
+      char buf[64];
+      while(read(fd(), buf, sizeof(buf)) > 0){}
+      
+      return false;
+    }
+  };
+  
+} // end namespace
+
+namespace neu{
+  
+  // handlers are called with mutex_ locked, remove() locks it too,
+  // unless called from a handler, so no handler is called once it
+  // has been removed. events already collected for a removed handler
+  // are skipped, it is deleted after the events collected with it
+  // have been handled. calls requested by other threads are kept
+  // apart until the reactor wakes
+  
+  class NReactor_{
+  public:
+    typedef NReactor::Handler Handler;
+    
+    NReactor_(){
+#ifdef __linux__
+      fd_ = epoll_create1(EPOLL_CLOEXEC);
+#else
+      fd_ = kqueue();
+#endif
+      
+      if(fd_ < 0 || pipe(wake_) < 0){
+        NERROR("failed to create reactor");
+      }
+      
+      add(new WakeHandler(wake_[0]));
+      
+      int opts = fcntl(wake_[1], F_GETFL);
+      fcntl(wake_[1], F_SETFL, opts | O_NONBLOCK);
+      
+      thread t(&NReactor_::run, this);
+      t.detach();
+    }
+    
+    void add(Handler* h){
+      int opts = fcntl(h->fd_, F_GETFL);
+      fcntl(h->fd_, F_SETFL, opts | O_NONBLOCK);
+      
+#ifdef __linux__
+      epoll_event e;
+      e.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+      e.data.ptr = h;
+      
+      if(epoll_ctl(fd_, EPOLL_CTL_ADD, h->fd_, &e) < 0){
+        NERROR("failed to add fd");
+      }
+#else
+      struct kevent e[2];
+      EV_SET(&e[0], h->fd_, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, h);
+      EV_SET(&e[1], h->fd_, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, h);
+      
+      if(kevent(fd_, e, 2, 0, 0, 0) < 0){
+        NERROR("failed to add fd");
+      }
+#endif
+    }
+    
+    void remove(Handler* h){
+      bool lock = !_inReactor;
+      
+      if(lock){
+        mutex_.lock();
+      }
+      
+      h->dead_ = true;
+      
+#ifdef __linux__
+      epoll_ctl(fd_, EPOLL_CTL_DEL, h->fd_, 0);
+#else
+      struct kevent e[2];
+      EV_SET(&e[0], h->fd_, EVFILT_READ, EV_DELETE, 0, 0, 0);
+      EV_SET(&e[1], h->fd_, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
+      kevent(fd_, e, 2, 0, 0, 0);
+#endif
+      
+      garbage_.push_back(h);
+      
+      if(lock){
+        mutex_.unlock();
+      }
+    }
+    
+    void queue(Handler* h, uint32_t events){
+      pendingMutex_.lock();
+      pending_.push_back({h, events});
+      pendingMutex_.unlock();
+      
+      // a full pipe will wake it anyway
+      char c = 0;
+      write(wake_[1], &c, 1);
+    }
+    
+  private:
+    class Call{
+    public:
+      Handler* h;
+      uint32_t events;
+    };
+    
+    int fd_;
+    int wake_[2];
+    NBasicMutex mutex_;
+    NVector<Handler*> again_;
+    NVector<Handler*> retry_;
+    NVector<Handler*> garbage_;
+    NVector<Call> pending_;
+    NVector<Call> calls_;
+    NBasicMutex pendingMutex_;
+    
+    void call(Handler* h, uint32_t events){
+      if(h->dead_){
+        return;
+      }
+      
+      if(h->onEvent(events) && !h->dead_){
+        if(h->again_ == 0){
+          again_.push_back(h);
+        }
+        
+        h->again_ |= events;
+      }
+    }
+    
+    void run(){
+      _inReactor = true;
+      
+#ifdef __linux__
+      epoll_event events[MaxEvents];
+#else
+      struct kevent events[MaxEvents];
+#endif
+      
+      for(;;){
+#ifdef __linux__
+        int n = epoll_wait(fd_, events, MaxEvents, again_.empty() ? -1 : 0);
+#else
+        timespec zero = {0, 0};
+        int n = kevent(fd_, 0, 0, events, MaxEvents,
+                       again_.empty() ? 0 : &zero);
+#endif
+        
+        mutex_.lock();
+        
+        // handlers which stopped early go first
+        retry_ = again_;
+        again_.clear();
+        
+        for(Handler* h : retry_){
+          uint32_t e = h->again_;
+          h->again_ = 0;
+          call(h, e);
+        }
+        
+        retry_.clear();
+        
+        pendingMutex_.lock();
+        calls_ = pending_;
+        pending_.clear();
+        pendingMutex_.unlock();
+        
+        for(const Call& c : calls_){
+          call(c.h, c.events);
+        }
+        
+        calls_.clear();
+        
+        for(int i = 0; i < n; ++i){
+#ifdef __linux__
+          Handler* h = (Handler*)events[i].data.ptr;
+          uint32_t e = events[i].events;
+          
+          uint32_t re = 0;
+          
+          if(e & EPOLLIN){
+            re |= NReactor::Readable;
+          }
+          
+          if(e & EPOLLOUT){
+            re |= NReactor::Writable;
+          }
+          
+          if(e & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+            re |= NReactor::Closed;
+          }
+#else
+          Handler* h = (Handler*)events[i].udata;
+          
+          uint32_t re = events[i].filter == EVFILT_READ ?
+          NReactor::Readable : NReactor::Writable;
+          
+          if(events[i].flags & (EV_EOF | EV_ERROR)){
+            re |= NReactor::Closed;
+          }
+#endif
+          
+          call(h, re);
+        }
+        
+        if(!garbage_.empty()){
+          size_t j = 0;
+          
+          for(size_t i = 0; i < again_.size(); ++i){
+            if(!again_[i]->dead_){
+              again_[j++] = again_[i];
+            }
+          }
+          
+          again_.resize(j);
+          
+          pendingMutex_.lock();
+          
+          j = 0;
+          
+          for(size_t i = 0; i < pending_.size(); ++i){
+            if(!pending_[i].h->dead_){
+              pending_[j++] = pending_[i];
+            }
+          }
+          
+          pending_.resize(j);
+          
+          pendingMutex_.unlock();
+          
+          for(Handler* h : garbage_){
+            delete h;
+          }
+          
+          garbage_.clear();
+        }
+        
+        mutex_.unlock();
+      }
+    }
+  };
+  
+} // end namespace neu
+
+NReactor::NReactor(){
+  x_ = new NReactor_;
+}
+
+NReactor* NReactor::get(){
+  static NReactor* reactor = new NReactor;
+  return reactor;
+}
+
+void NReactor::add(Handler* h){
+  x_->add(h);
+}
+
+void NReactor::remove(Handler* h){
+  x_->remove(h);
+}
+
+void NReactor::call(Handler* h, uint32_t events){
+  x_->queue(h, events);
+}
@@ -60,6 +60,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <neu/NListener.h>
 #include <neu/NVSemaphore.h>
 #include <neu/NCommunicator.h>
+#include <neu/NReactor.h>
+#include <neu/NError.h>
 
 using namespace std;
 using namespace neu;
@@ -68,53 +70,121 @@ namespace{
 
   class AuthProc : public NProc{
   public:
-    AuthProc(NProcTask* task, NServer* server)
+    AuthProc(NProcTask* task, NServer* server, bool sharedMemory)
     : task_(task),
-    server_(server){}
+    server_(server),
+    sharedMemory_(sharedMemory){}
     
+    // r is the accepted socket, or the communicator and the current
+    // delay while waiting for the authentication message
     void run(nvar& r){
-      NSocket* socket = r.ptr<NSocket>();
-      NCommunicator* comm = server_->create();
-      comm->setSocket(socket);
+      NCommunicator* comm;
+      
+      if(r.hasKeys()){
+        comm = r["comm"].ptr<NCommunicator>();
+      }
+      else{
+        NSocket* socket = r.ptr<NSocket>();
+        comm = server_->create();
+        comm->setSocket(socket, sharedMemory_);
+        
+        r = nvar();
+        r("comm") = comm;
+        r("delay") = 0.0;
+      }
       
       nvar auth;
-      comm->receive(auth);
+      if(!comm->receive(auth, 0)){
+        if(!comm->isConnected()){
+          delete comm;
+          return;
+        }
+        
+        double delay = r["delay"];
+        delay = delay == 0 ? 0.001 : min(delay*2, _timeout);
+        r("delay") = delay;
+        
+        task_->queueAfter(this, r, delay);
+        return;
+      }
       
       if(!server_->authenticate(comm, auth)){
         comm->close();
         delete comm;
+        return;
       }
       
       nvar resp = true;
       comm->send(resp);
+      
+      server_->onAuthenticated(comm);
     }
     
   private:
     NProcTask* task_;
     NServer* server_;
+    bool sharedMemory_;
   };
   
+  // queued by the reactor when connections are pending, accepts
+  // until none are left
+  
   class AcceptProc : public NProc{
   public:
-    AcceptProc(NProcTask* task, AuthProc* authProc, NListener& listener, int port)
+    AcceptProc(NProcTask* task, AuthProc* authProc, NListener& listener)
     : task_(task),
     authProc_(authProc),
-    listener_(listener){}
+    listener_(listener),
+    pending_(0){}
 
     void run(nvar& r){
-      NSocket* socket = listener_.accept(_timeout);
-      if(socket){
-        nvar ar = socket;
-        task_->queue(authProc_, ar);
-      }
+      size_t count;
       
-      signal(task_, this);
+      do{
+        count = pending_;
+        
+        for(;;){
+          NSocket* socket = listener_.accept(0);
+          if(!socket){
+            break;
+          }
+          
+          nvar ar = socket;
+          task_->queue(authProc_, ar);
+        }
+      } while(pending_.fetch_sub(count) != count);
+    }
+    
+    // called by the reactor
+    void ready(){
+      if(pending_++ == 0){
+        task_->queue(this);
+      }
     }
     
   private:
     NProcTask* task_;
     AuthProc* authProc_;
     NListener& listener_;
+    atomic<size_t> pending_;
+  };
+  
+  class ListenHandler : public NReactor::Handler{
+  public:
+    ListenHandler(int fd, AcceptProc* acceptProc)
+    : NReactor::Handler(fd),
+    acceptProc_(acceptProc){}
+    
+    bool onEvent(uint32_t events){
+      if(events & NReactor::Readable){
+        acceptProc_->ready();
+      }
+      
+      return false;
+    }
+    
+  private:
+    AcceptProc* acceptProc_;
   };
   
 } // end namespace
@@ -127,9 +197,14 @@ namespace neu{
     : o_(o),
     task_(task),
     acceptProc_(0),
-    authProc_(0){}
+    authProc_(0),
+    handler_(0){}
     
     ~NServer_(){
+      if(handler_){
+        NReactor::get()->remove(handler_);
+      }
+      
       if(acceptProc_){
         if(task_->terminate(acceptProc_)){
           delete acceptProc_;
@@ -152,19 +227,48 @@ namespace neu{
         return false;
       }
       
-      authProc_ = new AuthProc(task_, o_);
+      start(false);
       
-      acceptProc_ = new AcceptProc(task_, authProc_, listener_, port);
-      task_->queue(acceptProc_);
-
       return true;
     }
     
+    bool listen(const nstr& address){
+      nstr scheme;
+      nstr host;
+      int port;
+      
+      if(!NSocket::parseAddress(address, scheme, host, port)){
+        NERROR("invalid address: " + address);
+      }
+      
+      if(scheme == "tcp"){
+        return listen(port);
+      }
+      
+      if(!listener_.listenLocal(host)){
+        return false;
+      }
+      
+      start(scheme == "shm");
+      
+      return true;
+    }
+    
+    void start(bool sharedMemory){
+      authProc_ = new AuthProc(task_, o_, sharedMemory);
+      
+      acceptProc_ = new AcceptProc(task_, authProc_, listener_);
+      
+      handler_ = new ListenHandler(listener_.fd(), acceptProc_);
+      NReactor::get()->add(handler_);
+    }
+    
   private:
     NServer* o_;
     NProcTask* task_;
     AcceptProc* acceptProc_;
     AuthProc* authProc_;
+    ListenHandler* handler_;
     NListener listener_;
   };
   
@@ -185,3 +289,7 @@ NProcTask* NServer::task(){
 bool NServer::listen(int port){
   return x_->listen(port);
 }
+
+bool NServer::listen(const nstr& address){
+  return x_->listen(address);
+}
@@ -0,0 +1,308 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#include <neu/NTaskGraph.h>
+
+#include <atomic>
+
+#include <neu/NProc.h>
+#include <neu/NError.h>
+#include <neu/NBasicMutex.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  class Node{
+  public:
+    Node(const NTaskGraph::Func& f, double p)
+    : f(f),
+    p(p),
+    pending(0),
+    failed(false){}
+    
+    NTaskGraph::Func f;
+    double p;
+    NVector<size_t> deps;
+    NVector<size_t> dependents;
+    atomic<size_t> pending;
+    
+    // set if the node threw or one it depends on failed, before the
+    // pending count of its dependents is decremented
+    atomic_bool failed;
+    
+    nvar result;
+  };
+  
+  class GraphProc : public NProc{
+  public:
+    GraphProc(NTaskGraph_* graph)
+    : graph_(graph){}
+    
+    void run(nvar& r);
+    
+  private:
+    NTaskGraph_* graph_;
+  };
+  
+} // end namespace
+
+namespace neu{
+  
+  class NTaskGraph_{
+  public:
+    NTaskGraph_(NTaskGraph* o, NProcTask* task)
+    : o_(o),
+    task_(task),
+    proc_(this),
+    remaining_(0),
+    error_(0),
+    started_(false){}
+    
+    ~NTaskGraph_(){
+      if(started_){
+        promise_.future().wait();
+      }
+      
+      for(Node* n : nodes_){
+        delete n;
+      }
+      
+      if(error_){
+        delete error_;
+      }
+    }
+    
+    size_t add(const NTaskGraph::Func& f,
+               const NVector<size_t>& deps,
+               double priority){
+      if(remaining_ > 0){
+        NERROR("graph is running");
+      }
+      
+      size_t i = nodes_.size();
+      
+      Node* n = new Node(f, priority);
+      
+      for(size_t d : deps){
+        if(d >= i){
+          delete n;
+          NERROR("invalid dependency: " + nvar(d));
+        }
+        
+        n->deps.push_back(d);
+        nodes_[d]->dependents.push_back(i);
+      }
+      
+      nodes_.push_back(n);
+      
+      return i;
+    }
+    
+    size_t size() const{
+      return nodes_.size();
+    }
+    
+    NFuture run(){
+      if(remaining_ > 0){
+        NERROR("graph is running");
+      }
+      
+      promise_ = NPromise();
+      NFuture f = promise_.future();
+      started_ = true;
+      
+      if(nodes_.empty()){
+        promise_.set(nvec());
+        return f;
+      }
+      
+      if(error_){
+        delete error_;
+        error_ = 0;
+      }
+      
+      NVector<size_t> ready;
+      
+      for(size_t i = 0; i < nodes_.size(); ++i){
+        Node* n = nodes_[i];
+        n->pending = n->deps.size();
+        n->failed = false;
+        n->result = none;
+        
+        if(n->deps.empty()){
+          ready.push_back(i);
+        }
+      }
+      
+      remaining_ = nodes_.size();
+      
+      for(size_t i : ready){
+        queue(i);
+      }
+      
+      return f;
+    }
+    
+    const nvar& result(size_t i) const{
+      return nodes_[i]->result;
+    }
+    
+    void queue(size_t i){
+      nvar r = i;
+      task_->queue(&proc_, r, nodes_[i]->p);
+    }
+    
+    void runNode(size_t i){
+      Node* n = nodes_[i];
+      
+      // a node which depends on a failed one only completes, failing
+      // its own dependents in turn
+      if(!n->failed){
+        nvec inputs;
+        
+        for(size_t d : n->deps){
+          inputs.push_back(nodes_[d]->result);
+        }
+        
+        try{
+          n->result = n->f(inputs);
+        }
+        catch(NError& e){
+          n->failed = true;
+          
+          errorMutex_.lock();
+          if(!error_){
+            error_ = new NError(e);
+          }
+          errorMutex_.unlock();
+        }
+      }
+      
+      for(size_t d : n->dependents){
+        if(n->failed){
+          nodes_[d]->failed = true;
+        }
+        
+        if(--nodes_[d]->pending == 0){
+          queue(d);
+        }
+      }
+      
+      if(--remaining_ == 0){
+        complete();
+      }
+    }
+    
+    void complete(){
+      NPromise p = promise_;
+      
+      if(error_){
+        p.setError(*error_);
+        return;
+      }
+      
+      nvar v = nvec();
+      
+      for(Node* n : nodes_){
+        v << n->result;
+      }
+      
+      p.set(move(v));
+    }
+    
+  private:
+    NTaskGraph* o_;
+    NProcTask* task_;
+    GraphProc proc_;
+    NVector<Node*> nodes_;
+    atomic<size_t> remaining_;
+    NPromise promise_;
+    atomic<NError*> error_;
+    NBasicMutex errorMutex_;
+    bool started_;
+  };
+  
+} // end namespace neu
+
+void GraphProc::run(nvar& r){
+  graph_->runNode(r.asLong());
+}
+
+NTaskGraph::NTaskGraph(NProcTask* task){
+  x_ = new NTaskGraph_(this, task);
+}
+
+NTaskGraph::~NTaskGraph(){
+  delete x_;
+}
+
+size_t NTaskGraph::add(const Func& f,
+                       const NVector<size_t>& deps,
+                       double priority){
+  return x_->add(f, deps, priority);
+}
+
+size_t NTaskGraph::size() const{
+  return x_->size();
+}
+
+NFuture NTaskGraph::run(){
+  return x_->run();
+}
+
+const nvar& NTaskGraph::result(size_t node) const{
+  return x_->result(node);
+}
@@ -0,0 +1,1038 @@
+/*
+
+      ___           ___           ___
+     /\__\         /\  \         /\__\
+    /::|  |       /::\  \       /:/  /
+   /:|:|  |      /:/\:\  \     /:/  /
+  /:/|:|  |__   /::\~\:\  \   /:/  /  ___
+ /:/ |:| /\__\ /:/\:\ \:\__\ /:/__/  /\__\
+ \/__|:|/:/  / \:\~\:\ \/__/ \:\  \ /:/  /
+     |:/:/  /   \:\ \:\__\    \:\  /:/  /
+     |::/  /     \:\ \/__/     \:\/:/  /
+     /:/  /       \:\__\        \::/  /
+     \/__/         \/__/         \/__/
+
+
+The Neu Framework, Copyright (c) 2013-2015, Andrometa LLC
+All rights reserved.
+
+neu@andrometa.net
+http://neu.andrometa.net
+
+Neu can be used freely for commercial purposes. If you find Neu
+useful, please consider helping to support our work and the evolution
+of Neu by making a donation via: http://donate.andrometa.net
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+ 
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+ 
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+ 
+3. Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+ 
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+*/
+
+#include <neu/NObjectJIT.h>
+
+#include <neu/NObject.h>
+#include <neu/NPLModule.h>
+#include <neu/NPLParser.h>
+#include <neu/NBasicMutex.h>
+#include <neu/NError.h>
+
+using namespace std;
+using namespace neu;
+
+namespace{
+  
+  enum Type{
+    Invalid,
+    Unknown,
+    Long,
+    Double,
+    Bool
+  };
+  
+  const size_t MaxArgs = 16;
+  
+  const char* ClassName = "NObjectJIT";
+  
+  // NPLModule uses one LLVM context for all modules
+  NBasicMutex _mutex;
+  
+  class Object : public NPLObject{
+  public:
+    int64_t bail_;
+  };
+  
+  union Slot{
+    int64_t i;
+    double d;
+  };
+  
+  class Func : public NPLFunc{
+  public:
+    Slot ret;
+    Slot args[MaxArgs];
+  };
+  
+  class CompiledFunc : public NCompiledFunc{
+  public:
+    CompiledFunc(NPLModule* module,
+                 NPLFunc::FP fp,
+                 Type rt,
+                 const NVector<Type>& types)
+    : module_(module),
+    fp_(fp),
+    rt_(rt),
+    types_(types){}
+    
+    ~CompiledFunc(){
+      delete module_;
+    }
+    
+    bool call(const nvar& v, nvar& r){
+      Object o;
+      o.bail_ = 0;
+      
+      Func f;
+      f.fp = fp_;
+      f.o = &o;
+      f.ret.i = 0;
+      
+      size_t size = types_.size();
+      for(size_t i = 0; i < size; ++i){
+        if(types_[i] == Long){
+          f.args[i].i = (*v[i]).toLong();
+        }
+        else{
+          f.args[i].d = (*v[i]).toDouble();
+        }
+      }
+      
+      fp_(&f);
+      
+      if(o.bail_){
+        return false;
+      }
+      
+      switch(rt_){
+        case Long:
+          r = f.ret.i;
+          break;
+        case Double:
+          r = f.ret.d;
+          break;
+        default:
+          r = f.ret.i != 0;
+          break;
+      }
+      
+      return true;
+    }
+    
+  private:
+    NPLModule* module_;
+    NPLFunc::FP fp_;
+    Type rt_;
+    NVector<Type> types_;
+  };
+  
+  // translates an NObject function into an NPL class with a single
+  // method. pass 0 infers the return type, self-calls evaluate to
+  // Unknown until it is known, pass 1 checks all types and emits
+  // the method body
+  class Translator{
+  public:
+    Translator(NObject* o, const nvar& s, const NVector<Type>& types)
+    : o_(o),
+    s_(s),
+    types_(types),
+    rt_(Unknown){}
+    
+    Type returnType(){
+      return rt_;
+    }
+    
+    nvar translate(const nvar& b){
+      nvar body;
+      
+      hasCalls_ = false;
+      
+      for(size_t pass = 0; pass < 2; ++pass){
+        scopes_.clear();
+        scopes_.push_back(Scope());
+        
+        for(size_t i = 0; i < s_.size(); ++i){
+          scopes_[0][(*s_[i]).str()] = types_[i];
+        }
+        
+        guards_.clear();
+        loopDepth_ = 0;
+        
+        body = nfunc("Block");
+        if(!functionBody(*b, body)){
+          return none;
+        }
+        
+        if(rt_ == Unknown){
+          return none;
+        }
+      }
+      
+      if(hasCalls_){
+        nvar c = nfunc("Block");
+        c << bailCheck();
+        c.append(body);
+        body = move(c);
+      }
+      
+      nvar fs = nfunc(s_.str());
+      for(size_t i = 0; i < s_.size(); ++i){
+        fs << decl((*s_[i]).str(), types_[i]);
+      }
+      
+      nvar c;
+      c("__offset") = 8;
+      c("__index") = 1;
+      
+      nvar a = decl("bail_", Long);
+      a("offset") = 0;
+      a("index") = 0;
+      c("bail_") = move(a);
+      
+      nvar k = {s_.sym(), s_.size()};
+      c(k) = nfunc("TypedFunc") << typeSpec(rt_) << move(fs) << move(body);
+      
+      nvar code;
+      code(ClassName) = move(c);
+      
+      return code;
+    }
+    
+  private:
+    typedef NMap<nstr, Type> Scope;
+    
+    static nvar typeSpec(Type t){
+      switch(t){
+        case Long:
+          return NPLParser::parseType("long");
+        case Double:
+          return NPLParser::parseType("double");
+        default:
+          return NPLParser::parseType("bool");
+      }
+    }
+    
+    static nvar decl(const nstr& s, Type t){
+      nvar d = typeSpec(t);
+      d.setHead(nsym(s));
+      return d;
+    }
+    
+    nvar zero(){
+      switch(rt_){
+        case Double:
+          return 0.0;
+        case Bool:
+          return nfunc("NE") << 0 << 0;
+        default:
+          return 0;
+      }
+    }
+    
+    nvar bail(){
+      return nfunc("Block") << (nfunc("Set") << nsym("bail_") << 1) <<
+      (nfunc("Ret") << zero());
+    }
+    
+    // returns early from a call whose callee bailed out
+    nvar bailCheck(){
+      return nfunc("If") << (nfunc("NE") << nsym("bail_") << 0) <<
+      (nfunc("Block") << (nfunc("Ret") << zero()));
+    }
+    
+    Type lookup(const nstr& s){
+      for(int i = scopes_.size() - 1; i >= 0; --i){
+        auto itr = scopes_[i].find(s);
+        if(itr != scopes_[i].end()){
+          return itr->second;
+        }
+      }
+      
+      return Invalid;
+    }
+    
+    bool isParam(const nstr& s){
+      for(size_t i = 0; i < s_.size(); ++i){
+        if((*s_[i]).str() == s){
+          return true;
+        }
+      }
+      
+      return false;
+    }
+    
+    void assign(const nstr& s, Type t){
+      for(int i = scopes_.size() - 1; i >= 0; --i){
+        auto itr = scopes_[i].find(s);
+        if(itr != scopes_[i].end()){
+          itr->second = t;
+          return;
+        }
+      }
+    }
+    
+    static bool isNumeric(Type t){
+      return t == Long || t == Double || t == Unknown;
+    }
+    
+    static Type arith(Type t1, Type t2){
+      if(!isNumeric(t1) || !isNumeric(t2)){
+        return Invalid;
+      }
+      
+      if(t1 == Unknown || t2 == Unknown){
+        return Unknown;
+      }
+      
+      return t1 == Long && t2 == Long ? Long : Double;
+    }
+    
+    // true if n is an operand which can be evaluated ahead of its
+    // statement without side effects or traps
+    static bool isSimple(const nvar& v){
+      const nvar& n = *v;
+      
+      switch(n.fullType()){
+        case nvar::Integer:
+        case nvar::Float:
+        case nvar::Symbol:
+          return true;
+        case nvar::Function:
+          break;
+        default:
+          return false;
+      }
+      
+      const nstr& f = n.str();
+      
+      if(f != "Add" && f != "Sub" && f != "Mul" && f != "Neg"){
+        return false;
+      }
+      
+      for(size_t i = 0; i < n.size(); ++i){
+        if(!isSimple(n[i])){
+          return false;
+        }
+      }
+      
+      return true;
+    }
+    
+    static bool isJump(const nvar& v){
+      const nvar& n = *v;
+      
+      if(!n.isFunction()){
+        return false;
+      }
+      
+      const nstr& f = n.str();
+      
+      if(f == "Ret" || f == "Break"){
+        return true;
+      }
+      
+      if((f == "Block" || f == "ScopedBlock") && n.size() > 0){
+        return isJump(n[n.size() - 1]);
+      }
+      
+      return false;
+    }
+    
+    // true if n leaves the function on every path
+    static bool isTerminal(const nvar& v){
+      const nvar& n = *v;
+      
+      if(!n.isFunction()){
+        return false;
+      }
+      
+      const nstr& f = n.str();
+      
+      if(f == "Ret"){
+        return true;
+      }
+      
+      if((f == "Block" || f == "ScopedBlock") && n.size() > 0){
+        return isTerminal(n[n.size() - 1]);
+      }
+      
+      if(f == "If" && n.size() == 3){
+        return isTerminal(n[1]) && isTerminal(n[2]);
+      }
+      
+      return false;
+    }
+    
+    static bool isStatement(const nvar& v){
+      const nvar& n = *v;
+      
+      if(!n.isFunction()){
+        return false;
+      }
+      
+      const nstr& f = n.str();
+      
+      return f == "Block" || f == "ScopedBlock" || f == "If" ||
+      f == "While" || f == "For" || f == "Ret" || f == "Break" ||
+      f == "Var" || f == "VarSet" || f == "Set" || f == "AddBy" ||
+      f == "SubBy" || f == "MulBy" || f == "Inc" || f == "Dec" ||
+      f == "PostInc" || f == "PostDec";
+    }
+    
+    bool functionBody(const nvar& b, nvar& out){
+      if(b.isFunction() && (b.str() == "Block" || b.str() == "ScopedBlock")){
+        if(b.size() == 0){
+          return false;
+        }
+        
+        if(!block(b, out, true)){
+          return false;
+        }
+      }
+      else{
+        nvar n = nfunc("Block") << b;
+        if(!block(n, out, true)){
+          return false;
+        }
+      }
+      
+      // the last statement of the function is a Ret, an If whose
+      // branches all return, or an expression, which block() turned
+      // into a Ret
+      const nvar& last = out[out.size() - 1];
+      if(!isTerminal(last)){
+        return false;
+      }
+      
+      if(!(*last).isFunction("Ret")){
+        out << (nfunc("Ret") << zero());
+      }
+      
+      return true;
+    }
+    
+    // translates the statements of n, appending them to out, along
+    // with the guards hoisted from each statement
+    bool block(const nvar& n, nvar& out, bool top=false){
+      nvec saved = move(guards_);
+      
+      size_t size = n.size();
+      
+      for(size_t i = 0; i < size; ++i){
+        const nvar& si = *n[i];
+        bool last = i == size - 1;
+        
+        guards_.clear();
+        
+        nvar o;
+        
+        if(top && last && !isStatement(si)){
+          nvar r = nfunc("Ret") << si;
+          if(!stmt(r, o, true)){
+            return false;
+          }
+        }
+        else if(!stmt(si, o, last)){
+          return false;
+        }
+        
+        for(nvar& g : guards_){
+          out << move(g);
+        }
+        
+        out << move(o);
+      }
+      
+      guards_ = move(saved);
+      
+      return true;
+    }
+    
+    bool branch(const nvar& v, nvar& out){
+      const nvar& n = *v;
+      
+      if(n.isFunction("Block") || n.isFunction("ScopedBlock")){
+        return stmt(n, out, true);
+      }
+      
+      out = nfunc("Block");
+      return block(nfunc("Block") << n, out);
+    }
+    
+    bool loopBody(const nvar& v, nvar& out){
+      ++loopDepth_;
+      
+      nvar b;
+      bool ok = branch(v, b);
+      
+      --loopDepth_;
+      
+      // NPLModule does not check for a terminator at the end of a
+      // loop body
+      if(!ok || isJump(b)){
+        return false;
+      }
+      
+      out = nfunc("Block");
+      
+      if(hasCalls_){
+        out << bailCheck();
+      }
+      
+      out << move(b);
+      
+      return true;
+    }
+    
+    // translates an expression, the loop conditions and increments
+    // cannot hoist guards
+    bool unguarded(const nvar& n, nvar& out, bool statement){
+      size_t size = guards_.size();
+      
+      if(statement){
+        if(!stmt(n, out, false)){
+          return false;
+        }
+      }
+      else if(expr(n, out) != Bool){
+        return false;
+      }
+      
+      return guards_.size() == size;
+    }
+    
+    bool stmt(const nvar& v, nvar& out, bool last){
+      const nvar& n = *v;
+      
+      if(!n.isFunction()){
+        return expr(n, out) != Invalid;
+      }
+      
+      const nstr& f = n.str();
+      size_t size = n.size();
+      
+      if(f == "Block" || f == "ScopedBlock"){
+        bool scoped = f == "ScopedBlock";
+        
+        if(scoped){
+          scopes_.push_back(Scope());
+        }
+        
+        out = nfunc(f);
+        bool ok = block(n, out);
+        
+        if(scoped){
+          scopes_.pop_back();
+        }
+        
+        return ok;
+      }
+      else if(f == "If" && (size == 2 || size == 3)){
+        nvar c;
+        if(expr(n[0], c) != Bool){
+          return false;
+        }
+        
+        out = nfunc("If") << move(c);
+        
+        for(size_t i = 1; i < size; ++i){
+          nvar b;
+          if(!branch(n[i], b)){
+            return false;
+          }
+          
+          out << move(b);
+        }
+        
+        return true;
+      }
+      else if(f == "While" && size == 2){
+        nvar c;
+        if(!unguarded(n[0], c, false)){
+          return false;
+        }
+        
+        nvar b;
+        if(!loopBody(n[1], b)){
+          return false;
+        }
+        
+        // NPLModule's For tests the condition after the body
+        out = nfunc("If") << c << (nfunc("For") << 0 << c << 0 << move(b));
+        
+        return true;
+      }
+      else if(f == "For" && size == 4){
+        scopes_.push_back(Scope());
+        
+        nvar i;
+        nvar c;
+        nvar s;
+        nvar b;
+        
+        bool ok = unguarded(n[0], i, true) && unguarded(n[1], c, false) &&
+        unguarded(n[2], s, true) && loopBody(n[3], b);
+        
+        scopes_.pop_back();
+        
+        if(!ok){
+          return false;
+        }
+        
+        out = nfunc("ScopedBlock") << move(i) <<
+        (nfunc("If") << c << (nfunc("For") << 0 << c << move(s) << move(b)));
+        
+        return true;
+      }
+      else if(f == "Ret" && size == 1){
+        if(!last){
+          return false;
+        }
+        
+        nvar r;
+        Type t = expr(n[0], r);
+        
+        switch(t){
+          case Invalid:
+            return false;
+          case Unknown:
+            break;
+          default:
+            if(rt_ == Unknown){
+              rt_ = t;
+            }
+            else if(t != rt_){
+              return false;
+            }
+            break;
+        }
+        
+        out = nfunc("Ret") << move(r);
+        
+        return true;
+      }
+      else if(f == "Break" && size == 0){
+        if(!last || loopDepth_ == 0){
+          return false;
+        }
+        
+        out = nfunc("Break");
+        
+        return true;
+      }
+      else if(f == "Var" && size == 2){
+        const nvar& sv = *n[0];
+        
+        if(!sv.isSymbol() || isParam(sv)){
+          return false;
+        }
+        
+        const nstr& s = sv;
+        
+        nvar r;
+        Type t = expr(n[1], r);
+        
+        if(t == Invalid || t == Bool){
+          return false;
+        }
+        
+        Scope& scope = scopes_.back();
+        
+        if(scope.find(s) != scope.end()){
+          return false;
+        }
+        
+        scope[s] = t;
+        out = nfunc("Local") << decl(s, t) << move(r);
+        
+        return true;
+      }
+      else if((f == "VarSet" || f == "Set") && size == 2){
+        const nvar& sv = *n[0];
+        
+        if(!sv.isSymbol() || isParam(sv)){
+          return false;
+        }
+        
+        const nstr& s = sv;
+        
+        nvar r;
+        Type t = expr(n[1], r);
+        
+        if(t == Invalid || t == Bool){
+          return false;
+        }
+        
+        Type st = lookup(s);
+        
+        // VarSet to a symbol which is not a local assigns to the one
+        // of the object or global scope of that name if there is one
+        // when it runs, so only locals declared with Var are compiled
+        if(st == Invalid){
+          return false;
+        }
+        
+        if(st == Unknown){
+          assign(s, t);
+        }
+        else if(t != Unknown && t != st){
+          return false;
+        }
+        
+        out = nfunc("Set") << nsym(s) << move(r);
+        
+        return true;
+      }
+      else if((f == "AddBy" || f == "SubBy" || f == "MulBy") &&
+              size == 2){
+        const nvar& sv = *n[0];
+        
+        if(!sv.isSymbol() || isParam(sv)){
+          return false;
+        }
+        
+        const nstr& s = sv;
+        
+        Type st = lookup(s);
+        
+        nvar r;
+        Type t = arith(st, expr(n[1], r));
+        
+        if(t == Invalid || (t != Unknown && st != Unknown && t != st)){
+          return false;
+        }
+        
+        out = nfunc(f) << nsym(s) << move(r);
+        
+        return true;
+      }
+      else if((f == "Inc" || f == "Dec" || f == "PostInc" ||
+               f == "PostDec") && size == 1){
+        const nvar& sv = *n[0];
+        
+        if(!sv.isSymbol() || isParam(sv) || !isNumeric(lookup(sv))){
+          return false;
+        }
+        
+        out = nfunc(f) << nsym(sv.str());
+        
+        return true;
+      }
+      
+      return expr(n, out) != Invalid;
+    }
+    
+    Type expr(const nvar& v, nvar& out){
+      const nvar& n = *v;
+      
+      switch(n.fullType()){
+        case nvar::Integer:
+          out = n.toLong();
+          return Long;
+        case nvar::Float:
+          out = n.toDouble();
+          return Double;
+        case nvar::True:
+          out = nfunc("EQ") << 0 << 0;
+          return Bool;
+        case nvar::False:
+          out = nfunc("NE") << 0 << 0;
+          return Bool;
+        case nvar::Symbol:{
+          Type t = lookup(n);
+          out = nsym(n.str());
+          return t;
+        }
+        case nvar::Function:
+          break;
+        default:
+          return Invalid;
+      }
+      
+      const nstr& f = n.str();
+      size_t size = n.size();
+      
+      if(size == 2 && (f == "Add" || f == "Sub" || f == "Mul")){
+        nvar l;
+        nvar r;
+        Type t = arith(expr(n[0], l), expr(n[1], r));
+        out = nfunc(f) << move(l) << move(r);
+        return t;
+      }
+      else if(size == 2 && (f == "Div" || f == "Mod")){
+        if(!isSimple(n[0]) || !isSimple(n[1])){
+          return Invalid;
+        }
+        
+        nvar l;
+        nvar r;
+        Type t1 = expr(n[0], l);
+        Type t2 = expr(n[1], r);
+        Type t = arith(t1, t2);
+        
+        if(t == Invalid){
+          return Invalid;
+        }
+        
+        // nvar throws on division by zero and division of Integers
+        // produces a Rational unless it is exact
+        guard(nfunc("EQ") << r << 0);
+        
+        if(t1 == Long && t2 == Long){
+          guard(nfunc("EQ") << r << -1);
+          
+          if(f == "Div"){
+            guard(nfunc("NE") << (nfunc("Mod") << l << r) << 0);
+          }
+        }
+        
+        out = nfunc(f) << move(l) << move(r);
+        
+        return t1 == Unknown || t2 == Unknown ? Unknown : t;
+      }
+      else if(size == 1 && f == "Neg"){
+        nvar a;
+        Type t = expr(n[0], a);
+        out = nfunc(f) << move(a);
+        return isNumeric(t) ? t : Invalid;
+      }
+      else if(size == 2 && (f == "LT" || f == "LE" || f == "GT" ||
+                            f == "GE" || f == "EQ" || f == "NE")){
+        nvar l;
+        nvar r;
+        if(arith(expr(n[0], l), expr(n[1], r)) == Invalid){
+          return Invalid;
+        }
+        
+        out = nfunc(f) << move(l) << move(r);
+        return Bool;
+      }
+      else if(size == 2 && (f == "And" || f == "Or")){
+        nvar l;
+        nvar r;
+        if(expr(n[0], l) != Bool || expr(n[1], r) != Bool){
+          return Invalid;
+        }
+        
+        out = nfunc(f) << move(l) << move(r);
+        return Bool;
+      }
+      else if(size == 1 && f == "Not"){
+        nvar a;
+        if(expr(n[0], a) != Bool){
+          return Invalid;
+        }
+        
+        out = nfunc(f) << move(a);
+        return Bool;
+      }
+      else if(size == 1 && f == "Call"){
+        const nvar& c = *n[0];
+        
+        if(!c.isFunction() || c.str() != s_.str() ||
+           c.size() != s_.size()){
+          return Invalid;
+        }
+        
+        nvar a = nfunc(c.str());
+        
+        for(size_t i = 0; i < c.size(); ++i){
+          nvar ai;
+          Type t = expr(c[i], ai);
+          
+          if(t == Invalid || (t != Unknown && t != types_[i])){
+            return Invalid;
+          }
+          
+          a << move(ai);
+        }
+        
+        hasCalls_ = true;
+        
+        out = nfunc("Call") << move(a);
+        
+        return rt_;
+      }
+      
+      return Invalid;
+    }
+    
+    void guard(const nvar& c){
+      guards_.push_back(nfunc("If") << c << bail());
+    }
+    
+    NObject* o_;
+    const nvar& s_;
+    NVector<Type> types_;
+    Type rt_;
+    NVector<Scope> scopes_;
+    nvec guards_;
+    size_t loopDepth_;
+    bool hasCalls_;
+  };
+  
+} // end namespace
+
+namespace neu{
+  
+  class NObjectJIT_{
+  public:
+    NObjectJIT_(NObjectJIT* o)
+    : o_(o),
+    estr_(0){}
+    
+    bool getTypes(const nvec& types, NVector<Type>& ts){
+      if(types.size() > MaxArgs){
+        return false;
+      }
+      
+      for(const nvar& t : types){
+        switch(t.toLong()){
+          case nvar::Integer:
+            ts.push_back(Long);
+            break;
+          case nvar::Float:
+            ts.push_back(Double);
+            break;
+          default:
+            return false;
+        }
+      }
+      
+      return true;
+    }
+    
+    nvar translate(NObject* o,
+                   const nvar& s,
+                   const nvar& b,
+                   const nvec& types,
+                   Type& rt){
+      NVector<Type> ts;
+      if(!getTypes(types, ts)){
+        return none;
+      }
+      
+      Translator translator(o, *s, ts);
+      nvar code = translator.translate(b);
+      rt = translator.returnType();
+      
+      return code;
+    }
+    
+    NCompiledFunc* compile(NObject* o,
+                           const nvar& s,
+                           const nvar& b,
+                           const nvec& types){
+      Type rt;
+      nvar code = translate(o, s, b, types, rt);
+      
+      if(code.isNone()){
+        return 0;
+      }
+      
+      NVector<Type> ts;
+      getTypes(types, ts);
+      
+      _mutex.lock();
+      
+      NPLModule* module = new NPLModule;
+      
+      if(estr_){
+        module->setErrorStream(*estr_);
+      }
+      else{
+        module->setErrorStream(nullStream_);
+      }
+      
+      Func f;
+      
+      try{
+        if(!module->compile(code)){
+          delete module;
+          _mutex.unlock();
+          return 0;
+        }
+        
+        module->getFunc({ClassName, s.str(), s.size()}, &f);
+      }
+      catch(NError& e){
+        delete module;
+        _mutex.unlock();
+        return 0;
+      }
+      
+      _mutex.unlock();
+      
+      return new CompiledFunc(module, f.fp, rt, ts);
+    }
+    
+    void setErrorStream(ostream& estr){
+      estr_ = &estr;
+    }
+    
+  private:
+    NObjectJIT* o_;
+    ostream* estr_;
+    ostream nullStream_{0};
+  };
+  
+} // end namespace neu
+
+NObjectJIT::NObjectJIT(){
+  x_ = new NObjectJIT_(this);
+}
+
+NObjectJIT::~NObjectJIT(){
+  delete x_;
+}
+
+NCompiledFunc* NObjectJIT::compile(NObject* o,
+                                   const nvar& s,
+                                   const nvar& b,
+                                   const nvec& types){
+  return x_->compile(o, s, b, types);
+}
+
+nvar NObjectJIT::translate(NObject* o,
+                           const nvar& s,
+                           const nvar& b,
+                           const nvec& types){
+  Type rt;
+  return x_->translate(o, s, b, types, rt);
+}
+
+void NObjectJIT::setErrorStream(ostream& estr){
+  x_->setErrorStream(estr);
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <thread>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NServer.h>
+#include <neu/NCommunicator.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// a producer sends messages faster than a slow consumer takes them,
+// first with bounded send and receive queues, then unbounded. reports
+// the time taken, the growth of the peak resident memory and the
+// deepest the queues got on each side
+
+class SinkComm : public NCommunicator{
+public:
+  SinkComm(NProcTask* task)
+  : NCommunicator(task){}
+};
+
+class SinkServer : public NServer{
+public:
+  SinkServer(NProcTask* task, bool bounded)
+  : NServer(task),
+  bounded_(bounded),
+  comm_(0){}
+  
+  NCommunicator* create(){
+    NCommunicator* comm = new SinkComm(task());
+    
+    if(bounded_){
+      comm->setReceiveWatermarks(256, 64, 1 << 20, 1 << 18);
+    }
+    
+    return comm;
+  }
+  
+  bool authenticate(NCommunicator* comm, const nvar& auth){
+    comm_ = comm;
+    return true;
+  }
+  
+  NCommunicator* comm(){
+    return comm_;
+  }
+  
+private:
+  bool bounded_;
+  atomic<NCommunicator*> comm_;
+};
+
+size_t peakResidentBytes(){
+  ifstream in("/proc/self/status");
+  string line;
+  
+  while(getline(in, line)){
+    if(line.find("VmHWM:") == 0){
+      return atol(line.c_str() + 6) * 1024;
+    }
+  }
+  
+  return 0;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 4;
+  size_t n = argc > 2 ? atoi(argv[2]) : 10000;
+  size_t size = 4096;
+  
+  // the consumer waits this long on each message
+  double delay = 500e-6;
+  
+  NProcTask task(threads);
+  
+  // the peak only grows, so the bounded run comes first
+  for(int bounded = 1; bounded >= 0; --bounded){
+    int port = 5269 + bounded;
+    
+    SinkServer server(&task, bounded);
+    
+    if(!server.listen(port)){
+      cerr << "failed to listen" << endl;
+      return 1;
+    }
+    
+    NCommunicator client(&task);
+    
+    if(bounded){
+      client.setSendWatermarks(256, 64, 1 << 20, 1 << 18);
+    }
+    
+    if(!client.connect("localhost", port)){
+      cerr << "failed to connect" << endl;
+      return 1;
+    }
+    
+    nvar auth = true;
+    client.send(auth);
+    
+    nvar resp;
+    if(!client.receive(resp, 5) || !resp){
+      cerr << "failed to authenticate" << endl;
+      return 1;
+    }
+    
+    NCommunicator* sink = server.comm();
+    
+    size_t m1 = peakResidentBytes();
+    double t1 = NSys::now();
+    
+    thread consumer([&]{
+      for(size_t i = 0; i < n; ++i){
+        nvar msg;
+        if(!sink->receive(msg)){
+          break;
+        }
+        
+        NSys::sleep(delay);
+      }
+    });
+    
+    // random letters, which do not compress much
+    nstr str(size, ' ');
+    for(size_t i = 0; i < size; ++i){
+      str[i] = 'a' + rand() % 26;
+    }
+    
+    nvar msg = str;
+    
+    for(size_t i = 0; i < n; ++i){
+      nvar r = msg;
+      client.send(r);
+    }
+    
+    double t2 = NSys::now();
+    
+    consumer.join();
+    
+    double t = NSys::now() - t1;
+    size_t m2 = peakResidentBytes();
+    
+    nvar ss = client.stats()["send"];
+    nvar rs = sink->stats()["receive"];
+    
+    cout << (bounded ? "bounded" : "unbounded") << ", time: " << t <<
+    " s, producer done after: " << t2 - t1 << " s, peak memory growth: " <<
+    (m2 - m1)/1048576.0 << " MB, max send queue: " << ss["maxCount"] <<
+    " (" << ss["maxBytes"] << " bytes), max receive queue: " <<
+    rs["maxCount"] << " (" << rs["maxBytes"] << " bytes), sends blocked: " <<
+    ss["blocked"] << ", reads paused: " << rs["paused"] << endl;
+    
+    client.close();
+    NSys::sleep(0.1);
+  }
+  
+  return 0;
+}
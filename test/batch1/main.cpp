@@ -0,0 +1,108 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NVSemaphore.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the latency of fanning out a large number of small tasks:
+// queued one at a time, queued as a batch, and as a parallelFor() with
+// one index per range. the time to queue and the time until the last
+// task has run are reported
+
+class CountProc : public NProc{
+public:
+  CountProc(size_t n)
+  : n_(n),
+  count_(0){}
+  
+  void run(nvar& r){
+    if(++count_ == n_){
+      sem_.release();
+    }
+  }
+  
+  void wait(){
+    sem_.acquire();
+    count_ = 0;
+  }
+  
+private:
+  size_t n_;
+  atomic<size_t> count_;
+  NVSemaphore sem_;
+};
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 1000000;
+  
+  NProcTask task(threads);
+  CountProc proc(n);
+  
+  // fill the free lists of items
+  for(size_t i = 0; i < n; ++i){
+    nvar r = i;
+    task.queue(&proc, r);
+  }
+  
+  proc.wait();
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < n; ++i){
+    nvar r = i;
+    task.queue(&proc, r);
+  }
+  
+  double t2 = NSys::now();
+  proc.wait();
+  double t3 = NSys::now();
+  
+  cout << "queue, queued: " << t2 - t1 << " s, done: " <<
+  t3 - t1 << " s" << endl;
+  
+  nvec rs;
+  rs.reserve(n);
+  
+  t1 = NSys::now();
+  
+  for(size_t i = 0; i < n; ++i){
+    rs.push_back(i);
+  }
+  
+  task.queueBatch(&proc, rs);
+  
+  t2 = NSys::now();
+  proc.wait();
+  t3 = NSys::now();
+  
+  cout << "queueBatch, queued: " << t2 - t1 << " s, done: " <<
+  t3 - t1 << " s" << endl;
+  
+  atomic<size_t> count(0);
+  
+  t1 = NSys::now();
+  
+  task.parallelFor(0, n, 1, [&](size_t i, size_t j){
+    count += j - i;
+  });
+  
+  t3 = NSys::now();
+  
+  cout << "parallelFor, done: " << t3 - t1 << " s" << endl;
+  
+  if(count != n){
+    cout << "parallelFor ran " << count << " of " << n << endl;
+    return 1;
+  }
+  
+  return 0;
+}
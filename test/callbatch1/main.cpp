@@ -0,0 +1,137 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NObject.h>
+#include <neu/NClass.h>
+#include <neu/NBroker.h>
+#include <neu/NFuture.h>
+#include <neu/NError.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the time taken to make 1000 small calls on a distributed
+// object over loopback: synchronously, asynchronously, and
+// asynchronously within a batch which sends them as one message. then
+// checks that a failing call in a batch fails on its own
+
+class BenchClass : public NClass{
+public:
+  BenchClass()
+  : NClass("neu::Bench"){}
+  
+  NObject* constructRemote(NBroker* broker){
+    return new NObject(broker);
+  }
+};
+
+BenchClass _benchClass;
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t rounds = argc > 2 ? atoi(argv[2]) : 20;
+  size_t n = 1000;
+  int port = 5270;
+  
+  NProcTask task(threads);
+  
+  NObject bench;
+  
+  NBroker broker(&task);
+  if(!broker.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  broker.distribute(&bench, "Bench", "bench");
+  
+  NObject* obj = broker.obtain("localhost", port, "bench", nvar());
+  if(!obj){
+    cerr << "failed to obtain" << endl;
+    return 1;
+  }
+  
+  double synchronous = 0;
+  double async = 0;
+  double batched = 0;
+  
+  for(size_t r = 0; r < rounds; ++r){
+    double t1 = NSys::now();
+    
+    for(size_t i = 0; i < n; ++i){
+      obj->remoteRun(nfunc("Add") << i << 1);
+    }
+    
+    double t2 = NSys::now();
+    
+    NVector<NFuture> fs;
+    
+    for(size_t i = 0; i < n; ++i){
+      fs.push_back(obj->remoteRunAsync(nfunc("Add") << i << 1));
+    }
+    
+    for(NFuture& f : fs){
+      f.get();
+    }
+    
+    double t3 = NSys::now();
+    
+    fs.clear();
+    
+    {
+      NBroker::Batch batch(broker);
+      
+      for(size_t i = 0; i < n; ++i){
+        fs.push_back(obj->remoteRunAsync(nfunc("Add") << i << 1));
+      }
+    }
+    
+    for(NFuture& f : fs){
+      f.get();
+    }
+    
+    double t4 = NSys::now();
+    
+    synchronous += t2 - t1;
+    async += t3 - t2;
+    batched += t4 - t3;
+  }
+  
+  cout << "synchronous: " << synchronous / rounds * 1000 << " ms" << endl;
+  
+  cout << "asynchronous: " << async / rounds * 1000 << " ms, speedup: " <<
+  synchronous / async << endl;
+  
+  cout << "batched: " << batched / rounds * 1000 << " ms, speedup: " <<
+  synchronous / batched << endl;
+  
+  NFuture f1;
+  NFuture f2;
+  NFuture f3;
+  
+  {
+    NBroker::Batch batch(broker);
+    f1 = obj->remoteRunAsync(nfunc("Add") << 1 << 2);
+    f2 = obj->remoteRunAsync(nfunc("Missing") << 1);
+    f3 = obj->remoteRunAsync(nfunc("Add") << 3 << 4);
+  }
+  
+  cout << "batched results: " << f1.get() << ", ";
+  
+  try{
+    f2.get();
+    cout << "no error";
+  }
+  catch(NError& e){
+    cout << "error";
+  }
+  
+  cout << ", " << f3.get() << endl;
+  
+  return 0;
+}
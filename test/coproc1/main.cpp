@@ -0,0 +1,180 @@
+#include <iostream>
+#include <atomic>
+
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NCoProc.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// compares the number of connections echo servers can serve
+// concurrently on a given number of threads: a proc which blocks its
+// worker in recv() for the life of its connection against a
+// coroutine which suspends itself until its connection is readable.
+// each connection is a socket pair, the main thread sends a byte on
+// every connection and counts the echoes received before a deadline
+
+atomic<size_t> _open(0);
+
+class BlockingProc : public NProc{
+public:
+  void run(nvar& r){
+    int fd = r;
+    char c;
+    
+    while(recv(fd, &c, 1, 0) == 1){
+      send(fd, &c, 1, 0);
+    }
+    
+    close(fd);
+    --_open;
+  }
+};
+
+class EchoProc : public NCoProc{
+public:
+  void run(nvar& r){
+    int fd = r;
+    char c;
+    
+    for(;;){
+      awaitReadable(fd);
+      
+      if(recv(fd, &c, 1, 0) != 1){
+        break;
+      }
+      
+      send(fd, &c, 1, 0);
+    }
+    
+    close(fd);
+    --_open;
+  }
+};
+
+// returns the number of connections served in the first round, and
+// sets rate to the round trips per second if all were served
+size_t echo(NProcTask& task, NProc* proc, size_t connections,
+            size_t rounds, double& rate){
+  NVector<pollfd> fds;
+  
+  for(size_t i = 0; i < connections; ++i){
+    int sv[2];
+    
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0){
+      cerr << "failed to create socket pair: " << i << endl;
+      _exit(1);
+    }
+    
+    ++_open;
+    
+    nvar r = sv[1];
+    task.queue(proc, r);
+    
+    pollfd p;
+    p.fd = sv[0];
+    p.events = POLLIN;
+    fds.push_back(p);
+  }
+  
+  size_t served = 0;
+  rate = 0;
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < rounds; ++i){
+    char c = 1;
+    
+    for(pollfd& p : fds){
+      if(send(p.fd, &c, 1, 0) != 1){
+        _exit(1);
+      }
+    }
+    
+    double end = NSys::now() + 2;
+    size_t received = 0;
+    
+    while(received < connections){
+      double dt = end - NSys::now();
+      
+      if(dt <= 0 || poll(fds.data(), fds.size(), dt*1000) <= 0){
+        break;
+      }
+      
+      for(pollfd& p : fds){
+        if(p.revents & POLLIN){
+          if(recv(p.fd, &c, 1, 0) == 1){
+            ++received;
+          }
+        }
+        
+        p.revents = 0;
+      }
+    }
+    
+    if(i == 0){
+      served = received;
+    }
+    
+    if(received < connections){
+      break;
+    }
+  }
+  
+  if(served == connections){
+    rate = connections * rounds / (NSys::now() - t1);
+  }
+  
+  // closing the connections ends the procs
+  for(pollfd& p : fds){
+    close(p.fd);
+  }
+  
+  while(_open > 0){
+    NSys::sleep(0.01);
+  }
+  
+  return served;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  // the procs may echo to connections which have been closed
+  signal(SIGPIPE, SIG_IGN);
+  
+  size_t connections = argc > 1 ? atoi(argv[1]) : 1000;
+  size_t rounds = argc > 2 ? atoi(argv[2]) : 20;
+  
+  size_t threads[] = {1, 2, 4, 8};
+  
+  for(size_t t : threads){
+    NProcTask task(t);
+    
+    BlockingProc blocking;
+    EchoProc coroutine;
+    
+    double blockingRate;
+    size_t blockingServed =
+    echo(task, &blocking, connections, rounds, blockingRate);
+    
+    double coroutineRate;
+    size_t coroutineServed =
+    echo(task, &coroutine, connections, rounds, coroutineRate);
+    
+    cout << "threads: " << t << ", connections: " << connections <<
+    ", served: blocking: " << blockingServed << ", coroutine: " <<
+    coroutineServed << ", round trips/s: coroutine: " <<
+    coroutineRate << endl;
+  }
+  
+  return 0;
+}
@@ -0,0 +1,294 @@
+#include <iostream>
+#include <cmath>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NFuture.h>
+#include <neu/NTaskGraph.h>
+#include <neu/NVSemaphore.h>
+#include <neu/NError.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// compares futures and NTaskGraph with hand-written procs which
+// report completion through a semaphore:
+//
+// fork-join: rounds of 64 independent tasks, each round is waited on
+// before the next one starts
+//
+// pipeline: 2000 items passed through 4 stages, each stage of an item
+// depends on the previous stage of the same item
+//
+// then checks that a graph node which throws only keeps the nodes
+// depending on it from running
+
+double work(double x, size_t n){
+  for(size_t i = 0; i < n; ++i){
+    x = sqrt(x + i);
+  }
+  
+  return x;
+}
+
+class ForkProc : public NProc{
+public:
+  ForkProc(NVSemaphore& sem, size_t n)
+  : sem_(sem),
+  n_(n){}
+  
+  void run(nvar& r){
+    r = work(r, n_);
+    sem_.release();
+  }
+  
+private:
+  NVSemaphore& sem_;
+  size_t n_;
+};
+
+class StageProc : public NProc{
+public:
+  StageProc(NProcTask* task, NVSemaphore& sem, size_t n)
+  : task_(task),
+  sem_(sem),
+  n_(n),
+  next_(0){}
+  
+  void setNext(StageProc* next){
+    next_ = next;
+  }
+  
+  void run(nvar& r){
+    r = work(r, n_);
+    
+    if(next_){
+      task_->queue(next_, r);
+    }
+    else{
+      sem_.release();
+    }
+  }
+  
+private:
+  NProcTask* task_;
+  NVSemaphore& sem_;
+  size_t n_;
+  StageProc* next_;
+};
+
+double forkJoinSem(NProcTask& task, size_t rounds, size_t width, size_t n){
+  NVSemaphore sem;
+  ForkProc proc(sem, n);
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < rounds; ++i){
+    for(size_t j = 0; j < width; ++j){
+      nvar r = double(j);
+      task.queue(&proc, r);
+    }
+    
+    for(size_t j = 0; j < width; ++j){
+      sem.acquire();
+    }
+  }
+  
+  return NSys::now() - t1;
+}
+
+double forkJoinFuture(NProcTask& task, size_t rounds, size_t width, size_t n){
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < rounds; ++i){
+    NVector<NFuture> fs;
+    
+    for(size_t j = 0; j < width; ++j){
+      fs.push_back(task.submit([=]() -> nvar{
+        return work(j, n);
+      }));
+    }
+    
+    NFuture::all(fs).wait();
+  }
+  
+  return NSys::now() - t1;
+}
+
+double forkJoinGraph(NProcTask& task, size_t rounds, size_t width, size_t n){
+  NTaskGraph graph(&task);
+  
+  for(size_t j = 0; j < width; ++j){
+    graph.add([=](const nvec& inputs) -> nvar{
+      return work(j, n);
+    });
+  }
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < rounds; ++i){
+    graph.run().wait();
+  }
+  
+  return NSys::now() - t1;
+}
+
+double pipelineSem(NProcTask& task, size_t items, size_t stages, size_t n){
+  NVSemaphore sem;
+  
+  NVector<StageProc*> procs;
+  for(size_t i = 0; i < stages; ++i){
+    procs.push_back(new StageProc(&task, sem, n));
+    
+    if(i > 0){
+      procs[i - 1]->setNext(procs[i]);
+    }
+  }
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < items; ++i){
+    nvar r = double(i);
+    task.queue(procs[0], r);
+  }
+  
+  for(size_t i = 0; i < items; ++i){
+    sem.acquire();
+  }
+  
+  double t = NSys::now() - t1;
+  
+  for(StageProc* p : procs){
+    if(task.terminate(p)){
+      delete p;
+    }
+  }
+  
+  return t;
+}
+
+double pipelineFuture(NProcTask& task, size_t items, size_t stages, size_t n){
+  double t1 = NSys::now();
+  
+  NVector<NFuture> fs;
+  
+  for(size_t i = 0; i < items; ++i){
+    NFuture f = task.submit([=]() -> nvar{
+      return work(i, n);
+    });
+    
+    for(size_t j = 1; j < stages; ++j){
+      f = f.then(&task, [=](const nvar& x) -> nvar{
+        return work(x, n);
+      });
+    }
+    
+    fs.push_back(f);
+  }
+  
+  NFuture::all(fs).wait();
+  
+  return NSys::now() - t1;
+}
+
+double pipelineGraph(NProcTask& task, size_t items, size_t stages, size_t n){
+  double t1 = NSys::now();
+  
+  NTaskGraph graph(&task);
+  
+  for(size_t i = 0; i < items; ++i){
+    size_t k = graph.add([=](const nvec& inputs) -> nvar{
+      return work(i, n);
+    });
+    
+    for(size_t j = 1; j < stages; ++j){
+      k = graph.add([=](const nvec& inputs) -> nvar{
+        return work(inputs[0], n);
+      }, {k});
+    }
+  }
+  
+  graph.run().wait();
+  
+  return NSys::now() - t1;
+}
+
+void failGraph(NProcTask& task, size_t width){
+  NTaskGraph graph(&task);
+  
+  atomic<size_t> independent(0);
+  atomic<size_t> dependent(0);
+  
+  size_t f = graph.add([](const nvec& inputs) -> nvar{
+    NERROR("node failed");
+  });
+  
+  for(size_t j = 0; j < width; ++j){
+    size_t k = graph.add([&, j](const nvec& inputs) -> nvar{
+      ++independent;
+      return work(j, 1000);
+    });
+    
+    graph.add([&](const nvec& inputs) -> nvar{
+      ++independent;
+      return work(inputs[0], 1000);
+    }, {k});
+    
+    k = graph.add([&](const nvec& inputs) -> nvar{
+      ++dependent;
+      return 0;
+    }, {f});
+    
+    graph.add([&](const nvec& inputs) -> nvar{
+      ++dependent;
+      return 0;
+    }, {k});
+  }
+  
+  bool failed = false;
+  
+  try{
+    graph.run().get();
+  }
+  catch(NError& e){
+    failed = true;
+  }
+  
+  cout << "failure: error: " << failed << ", independent nodes run: " <<
+  independent << " / " << width * 2 << ", dependent nodes run: " <<
+  dependent << endl;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 1000;
+  
+  NProcTask task(threads);
+  
+  size_t rounds = 500;
+  size_t width = 64;
+  size_t tasks = rounds * width;
+  
+  cout << "fork-join, tasks/s: semaphore: " <<
+  tasks / forkJoinSem(task, rounds, width, n) <<
+  ", futures: " << tasks / forkJoinFuture(task, rounds, width, n) <<
+  ", graph: " << tasks / forkJoinGraph(task, rounds, width, n) << endl;
+  
+  size_t items = 2000;
+  size_t stages = 4;
+  tasks = items * stages;
+  
+  cout << "pipeline, tasks/s: semaphore: " <<
+  tasks / pipelineSem(task, items, stages, n) <<
+  ", futures: " << tasks / pipelineFuture(task, items, stages, n) <<
+  ", graph: " << tasks / pipelineGraph(task, items, stages, n) << endl;
+  
+  failGraph(task, 64);
+  
+  return 0;
+}
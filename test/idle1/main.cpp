@@ -0,0 +1,133 @@
+#include <iostream>
+#include <cstring>
+#include <atomic>
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NServer.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the CPU used by an NServer holding idle connections, a
+// child process opens the connections, authenticates them and then
+// leaves them idle
+
+atomic<size_t> _authenticated(0);
+
+class Server : public NServer{
+public:
+  Server(NProcTask* task)
+  : NServer(task){}
+  
+  bool authenticate(NCommunicator* comm, const nvar& auth){
+    ++_authenticated;
+    return true;
+  }
+};
+
+double cpuTime(){
+  rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  
+  return u.ru_utime.tv_sec + u.ru_utime.tv_usec / 1e6 +
+  u.ru_stime.tv_sec + u.ru_stime.tv_usec / 1e6;
+}
+
+void connect(int port, size_t connections, int ready){
+  nvar auth = true;
+  
+  uint32_t size;
+  char* buf = auth.pack(size, 1024, 4);
+  uint32_t s = size - 4;
+  memcpy(buf, &s, 4);
+  
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  
+  for(size_t i = 0; i < connections; ++i){
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    
+    if(fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+       ::send(fd, buf, size, 0) != ssize_t(size)){
+      cerr << "failed to connect: " << i << endl;
+      _exit(1);
+    }
+  }
+  
+  free(buf);
+  
+  char c = 1;
+  if(write(ready, &c, 1) != 1){
+    _exit(1);
+  }
+  
+  for(;;){
+    pause();
+  }
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t connections = argc > 1 ? atoi(argv[1]) : 10000;
+  size_t threads = argc > 2 ? atoi(argv[2]) : 8;
+  double seconds = argc > 3 ? atof(argv[3]) : 5;
+  int port = 5265;
+  
+  NProcTask task(threads);
+  Server server(&task);
+  
+  if(!server.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  int fds[2];
+  if(pipe(fds) != 0){
+    return 1;
+  }
+  
+  pid_t pid = fork();
+  
+  if(pid == 0){
+    connect(port, connections, fds[1]);
+  }
+  
+  char c;
+  if(read(fds[0], &c, 1) != 1){
+    return 1;
+  }
+  
+  // let the server accept and authenticate every connection
+  NSys::sleep(2);
+  
+  double c1 = cpuTime();
+  double t1 = NSys::now();
+  
+  NSys::sleep(seconds);
+  
+  double cpu = cpuTime() - c1;
+  double t = NSys::now() - t1;
+  
+  cout << "connections: " << connections << ", threads: " << threads <<
+  ", authenticated: " << _authenticated << ", idle CPU: " <<
+  cpu / t * 100 << "%" << endl;
+  
+  kill(pid, SIGKILL);
+  
+  // skip tearing down the connections
+  _exit(0);
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NObjectJIT.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// compares interpreting hot numeric functions with running them
+// through the NObjectJIT tier, e.g:
+//
+// fib(n){
+//   if(n < 2){
+//     return n;
+//   }
+//   return fib(n - 1) + fib(n - 2);
+// }
+//
+// series(n, x){
+//   t =: 0.0;
+//   for(i =: 0; i < n; ++i){
+//     t += x / (i + 1);
+//   }
+//   return t;
+// }
+
+nvar call(const nstr& f, const nvar& a){
+  return nfunc("Call") << (nfunc(f) << a);
+}
+
+nvar fibDef(){
+  nvar body =
+    nfunc("Block") <<
+    (nfunc("If") << (nfunc("LT") << nsym("n") << 2) <<
+     (nfunc("Block") << (nfunc("Ret") << nsym("n")))) <<
+    (nfunc("Ret") <<
+     (nfunc("Add") <<
+      call("fib", nfunc("Sub") << nsym("n") << 1) <<
+      call("fib", nfunc("Sub") << nsym("n") << 2)));
+
+  return nfunc("Def") << (nfunc("fib") << nsym("n")) << body;
+}
+
+nvar seriesDef(){
+  nvar body =
+    nfunc("Block") <<
+    (nfunc("Var") << nsym("t") << 0.0) <<
+    (nfunc("For") <<
+     (nfunc("Var") << nsym("i") << 0) <<
+     (nfunc("LT") << nsym("i") << nsym("n")) <<
+     (nfunc("Inc") << nsym("i")) <<
+     (nfunc("ScopedBlock") <<
+      (nfunc("AddBy") << nsym("t") <<
+       (nfunc("Div") << nsym("x") <<
+        (nfunc("Add") << nsym("i") << 1))))) <<
+    (nfunc("Ret") << nsym("t"));
+
+  return nfunc("Def") << (nfunc("series") << nsym("n") << nsym("x")) << body;
+}
+
+double time(bool jit, const nvar& c, size_t rounds, nvar& result){
+  NObjectJIT compiler;
+
+  NObject o;
+
+  if(jit){
+    o.setCompiler(&compiler, 2);
+  }
+
+  o.run(fibDef());
+  o.run(seriesDef());
+
+  // warm up, so the JIT case is measured after compiling
+  for(size_t i = 0; i < 4; ++i){
+    result = o.run(c);
+  }
+
+  double t1 = NSys::now();
+
+  for(size_t i = 0; i < rounds; ++i){
+    result = o.run(c);
+  }
+
+  return NSys::now() - t1;
+}
+
+void compare(const nstr& name, const nvar& c, size_t rounds){
+  nvar r1;
+  double t1 = time(false, c, rounds, r1);
+
+  nvar r2;
+  double t2 = time(true, c, rounds, r2);
+
+  cout << name << " result: " << r1 << " / " << r2 << endl;
+  cout << name << " interpreted: " << t1 << " s" << endl;
+  cout << name << " jit: " << t2 << " s" << endl;
+  cout << name << " speedup: " << t1 / t2 << "x" << endl;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+
+  size_t rounds = argc > 1 ? atoi(argv[1]) : 5;
+
+  compare("fib", call("fib", 20), rounds);
+  compare("series", nfunc("Call") <<
+          (nfunc("series") << 100000 << 3.0), rounds);
+
+  return 0;
+}
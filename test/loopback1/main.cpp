@@ -0,0 +1,468 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NBasicMutex.h>
+#include <neu/NServer.h>
+#include <neu/NCommunicator.h>
+#include <neu/NObject.h>
+#include <neu/NClass.h>
+#include <neu/NBroker.h>
+#include <neu/NFuture.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// clients in this process make requests over loopback, to an echo
+// server through NCommunicator, then to a distributed object through
+// NBroker, for each message size, number of connections, compression
+// setting and number of requests outstanding on each connection.
+// prints a line of CSV for each: the round trips per second, their
+// latency percentiles, the CPU time of the process and the bytes
+// packed by both ends per round trip
+
+class CountingEncoder : public NCommunicator::Encoder{
+public:
+  CountingEncoder()
+  : bytes(0){}
+  
+  char* encrypt(char* buf, uint32_t& size){
+    bytes += size;
+    return buf;
+  }
+  
+  atomic<size_t> bytes;
+};
+
+CountingEncoder _encoder;
+
+// until it is authenticated, the server takes the messages itself
+
+class EchoComm : public NCommunicator{
+public:
+  EchoComm(NProcTask* task)
+  : NCommunicator(task),
+  ready(false){}
+  
+  atomic_bool ready;
+  
+  void onReceive(){
+    if(!ready){
+      return;
+    }
+    
+    nvar msg;
+    if(receive(msg, 0)){
+      send(msg);
+    }
+  }
+};
+
+class EchoServer : public NServer{
+public:
+  EchoServer(NProcTask* task)
+  : NServer(task),
+  minCompressSize_(1024){}
+  
+  ~EchoServer(){
+    closeAll();
+  }
+  
+  NCommunicator* create(){
+    NCommunicator* comm = new EchoComm(task());
+    comm->setEncoder(&_encoder);
+    comm->setMinCompressSize(minCompressSize_);
+    return comm;
+  }
+  
+  bool authenticate(NCommunicator* comm, const nvar& auth){
+    static_cast<EchoComm*>(comm)->ready = true;
+    return true;
+  }
+  
+  void onAuthenticated(NCommunicator* comm){
+    mutex_.lock();
+    comms_.push_back(comm);
+    mutex_.unlock();
+  }
+  
+  void setMinCompressSize(size_t n){
+    minCompressSize_ = n;
+  }
+  
+  void closeAll(){
+    mutex_.lock();
+    for(NCommunicator* comm : comms_){
+      delete comm;
+    }
+    comms_.clear();
+    mutex_.unlock();
+  }
+  
+private:
+  atomic<size_t> minCompressSize_;
+  NBasicMutex mutex_;
+  NVector<NCommunicator*> comms_;
+};
+
+class Echo : public NObject{
+public:
+  NFunc handle(const nvar& v, uint32_t flags){
+    if(v.isFunction() && v.funcStr() == "Echo"){
+      return [](void* o, const nstr&, nvec& v) -> nvar{
+        return v[0];
+      };
+    }
+    
+    return NObject::handle(v, flags);
+  }
+};
+
+class EchoClass : public NClass{
+public:
+  EchoClass()
+  : NClass("neu::Echo"){}
+  
+  NObject* constructRemote(NBroker* broker){
+    return new NObject(broker);
+  }
+};
+
+EchoClass _echoClass;
+
+double cpuTime(){
+  rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  
+  return u.ru_utime.tv_sec + u.ru_utime.tv_usec * 1e-6 +
+  u.ru_stime.tv_sec + u.ru_stime.tv_usec * 1e-6;
+}
+
+// letters from a small alphabet, which compress to about half
+nstr payload(size_t size){
+  nstr str(size, ' ');
+  for(size_t i = 0; i < size; ++i){
+    str[i] = 'a' + rand() % 8;
+  }
+  
+  return str;
+}
+
+class Run{
+public:
+  Run(const nstr& layer,
+      size_t size,
+      size_t connections,
+      bool compress,
+      size_t depth,
+      size_t n)
+  : layer_(layer),
+  size_(size),
+  connections_(connections),
+  compress_(compress),
+  depth_(depth),
+  n_(n),
+  latencies_(connections){}
+  
+  // round trips made on connection i, at least depth each
+  size_t count(size_t i) const{
+    size_t m = n_ / connections_ + (i < n_ % connections_ ? 1 : 0);
+    return max(m, depth_);
+  }
+  
+  void add(size_t i, double latency){
+    latencies_[i].push_back(latency);
+  }
+  
+  void start(){
+    bytes_ = _encoder.bytes;
+    cpu_ = cpuTime();
+    time_ = NSys::now();
+  }
+  
+  void stop(){
+    time_ = NSys::now() - time_;
+    cpu_ = cpuTime() - cpu_;
+    bytes_ = _encoder.bytes - bytes_;
+  }
+  
+  static void header(){
+    cout << "layer,size,connections,compress,depth,round_trips," <<
+    "round_trips_per_s,p50_us,p99_us,p999_us,cpu_us,bytes" << endl;
+  }
+  
+  void report(){
+    NVector<double> all;
+    for(auto& l : latencies_){
+      all.append(l);
+    }
+    
+    sort(all.begin(), all.end());
+    
+    size_t m = all.size();
+    
+    cout << layer_ << "," << size_ << "," << connections_ << "," <<
+    compress_ << "," << depth_ << "," << m << "," << m / time_ << "," <<
+    percentile(all, 0.5) * 1e6 << "," << percentile(all, 0.99) * 1e6 <<
+    "," << percentile(all, 0.999) * 1e6 << "," << cpu_ / m * 1e6 <<
+    "," << double(bytes_) / m << endl;
+  }
+  
+private:
+  nstr layer_;
+  size_t size_;
+  size_t connections_;
+  bool compress_;
+  size_t depth_;
+  size_t n_;
+  NVector<NVector<double>> latencies_;
+  size_t bytes_;
+  double cpu_;
+  double time_;
+  
+  static double percentile(const NVector<double>& v, double p){
+    if(v.empty()){
+      return 0;
+    }
+    
+    return v[min(v.size() - 1, size_t(p * v.size()))];
+  }
+};
+
+// each connection is driven by a thread which keeps depth messages
+// outstanding, the echoes may be received in any order
+
+bool benchComm(EchoServer& server,
+               int port,
+               Run& run,
+               const nvar& msg,
+               size_t connections,
+               size_t minCompressSize,
+               size_t depth){
+  
+  server.setMinCompressSize(minCompressSize);
+  
+  NVector<NCommunicator*> comms;
+  
+  for(size_t i = 0; i < connections; ++i){
+    NCommunicator* comm = new NCommunicator(server.task());
+    comm->setEncoder(&_encoder);
+    comm->setMinCompressSize(minCompressSize);
+    comms.push_back(comm);
+    
+    if(!comm->connect("localhost", port)){
+      return false;
+    }
+    
+    nvar auth = true;
+    comm->send(auth);
+    
+    nvar resp;
+    if(!comm->receive(resp, 5) || !resp){
+      return false;
+    }
+  }
+  
+  NVector<thread> threads;
+  
+  run.start();
+  
+  for(size_t i = 0; i < connections; ++i){
+    threads.emplace_back([&, i]{
+      NCommunicator* comm = comms[i];
+      size_t m = run.count(i);
+      size_t sent = 0;
+      
+      for(; sent < depth; ++sent){
+        nvar r = msg;
+        r("t") = NSys::now();
+        comm->send(r);
+      }
+      
+      for(size_t j = 0; j < m; ++j){
+        nvar r;
+        if(!comm->receive(r)){
+          return;
+        }
+        
+        run.add(i, NSys::now() - r["t"].toDouble());
+        
+        if(sent < m){
+          r("t") = NSys::now();
+          comm->send(r);
+          ++sent;
+        }
+      }
+    });
+  }
+  
+  for(thread& t : threads){
+    t.join();
+  }
+  
+  run.stop();
+  
+  for(NCommunicator* comm : comms){
+    delete comm;
+  }
+  
+  server.closeAll();
+  
+  return true;
+}
+
+// a connection is made for each authentication, the futures of each
+// are taken in the order the calls were made
+
+bool benchBroker(NBroker& broker,
+                 int port,
+                 Run& run,
+                 const nvar& msg,
+                 size_t connections,
+                 size_t minCompressSize,
+                 size_t depth){
+  
+  broker.setMinCompressSize(minCompressSize);
+  
+  NVector<NObject*> proxies;
+  
+  for(size_t i = 0; i < connections; ++i){
+    nvar auth;
+    auth("user") = i;
+    
+    NObject* p = broker.obtain("localhost", port, "echo", auth);
+    if(!p){
+      return false;
+    }
+    
+    proxies.push_back(p);
+  }
+  
+  NVector<thread> threads;
+  
+  run.start();
+  
+  for(size_t i = 0; i < connections; ++i){
+    threads.emplace_back([&, i]{
+      NObject* p = proxies[i];
+      size_t m = run.count(i);
+      
+      NVector<NFuture> fs(depth);
+      NVector<double> ts(depth);
+      
+      for(size_t j = 0; j < m + depth; ++j){
+        size_t k = j % depth;
+        NFuture& f = fs[k];
+        
+        if(f.valid()){
+          f.get();
+          run.add(i, NSys::now() - ts[k]);
+          f = NFuture();
+        }
+        
+        if(j < m){
+          ts[k] = NSys::now();
+          f = p->remoteRunAsync(nfunc("Echo") << msg);
+        }
+      }
+    });
+  }
+  
+  for(thread& t : threads){
+    t.join();
+  }
+  
+  run.stop();
+  
+  for(NObject* p : proxies){
+    broker.release(p);
+  }
+  
+  return true;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 2000;
+  int port = 5277;
+  
+  NVector<size_t> sizes = {64, 1024, 16384};
+  NVector<size_t> connections = {1, 4, 16};
+  NVector<size_t> depths = {1, 16, 64};
+  
+  NProcTask task(threads);
+  
+  EchoServer server(&task);
+  if(!server.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  Echo echo;
+  
+  NBroker broker(&task);
+  broker.setEncoder(&_encoder);
+  
+  if(!broker.listen(port + 1)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  broker.distribute(&echo, "Echo", "echo", NBroker::Concurrent);
+  
+  Run::header();
+  
+  for(int layer = 0; layer < 2; ++layer){
+    for(size_t size : sizes){
+      nvar msg = payload(size);
+      
+      for(size_t c : connections){
+        for(int compress = 0; compress < 2; ++compress){
+          size_t minCompressSize = compress ? 0 : nvar::NO_COMPRESS;
+          
+          for(size_t depth : depths){
+            bool ok;
+            
+            if(layer == 0){
+              Run run("comm", size, c, compress, depth, n);
+              
+              nvar m;
+              m("p") = msg;
+              
+              ok = benchComm(server, port, run, m, c,
+                             minCompressSize, depth);
+              if(ok){
+                run.report();
+              }
+            }
+            else{
+              Run run("broker", size, c, compress, depth, n);
+              
+              ok = benchBroker(broker, port + 1, run, msg, c,
+                               minCompressSize, depth);
+              if(ok){
+                run.report();
+              }
+            }
+            
+            if(!ok){
+              cerr << "failed to connect" << endl;
+              return 1;
+            }
+          }
+        }
+      }
+    }
+  }
+  
+  return 0;
+}
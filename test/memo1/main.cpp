@@ -0,0 +1,125 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// compares interpreting deterministic functions defined with Def and
+// with DefMemo, e.g:
+//
+// fib(n){
+//   if(n < 2){
+//     return n;
+//   }
+//   return fib(n - 1) + fib(n - 2);
+// }
+//
+// score(x){
+//   t = 0.0;
+//   for(i = 0; i < 1000; ++i){
+//     t += x * i / (i + 1.0);
+//   }
+//   return t;
+// }
+//
+// the scoring workload calls score() with 20 distinct arguments, as
+// in a fitness run re-evaluating the same individuals
+
+nvar call(const nstr& f, const nvar& a){
+  return nfunc("Call") << (nfunc(f) << a);
+}
+
+nvar fibDef(const nstr& def){
+  nvar body =
+    nfunc("Block") <<
+    (nfunc("If") << (nfunc("LT") << nsym("n") << 2) <<
+     (nfunc("Block") << (nfunc("Ret") << nsym("n")))) <<
+    (nfunc("Ret") <<
+     (nfunc("Add") <<
+      call("fib", nfunc("Sub") << nsym("n") << 1) <<
+      call("fib", nfunc("Sub") << nsym("n") << 2)));
+
+  return nfunc(def) << (nfunc("fib") << nsym("n")) << body;
+}
+
+nvar scoreDef(const nstr& def){
+  nvar body =
+    nfunc("Block") <<
+    (nfunc("VarSet") << nsym("t") << 0.0) <<
+    (nfunc("For") <<
+     (nfunc("VarSet") << nsym("i") << 0) <<
+     (nfunc("LT") << nsym("i") << 1000) <<
+     (nfunc("Inc") << nsym("i")) <<
+     (nfunc("ScopedBlock") <<
+      (nfunc("AddBy") << nsym("t") <<
+       (nfunc("Div") <<
+        (nfunc("Mul") << nsym("x") << nsym("i")) <<
+        (nfunc("Add") << nsym("i") << 1.0))))) <<
+    (nfunc("Ret") << nsym("t"));
+
+  return nfunc(def) << (nfunc("score") << nsym("x")) << body;
+}
+
+double fib(const nstr& def, nvar& result, nvar& stats){
+  NObject o;
+  o.run(fibDef(def));
+
+  double t1 = NSys::now();
+  result = o.run(call("fib", 22));
+  double t = NSys::now() - t1;
+
+  stats = o.memoStats();
+
+  return t;
+}
+
+double score(const nstr& def, size_t rounds, nvar& result, nvar& stats){
+  NObject o;
+  o.run(scoreDef(def));
+
+  double t1 = NSys::now();
+
+  result = 0.0;
+  for(size_t i = 0; i < rounds; ++i){
+    result += o.run(call("score", int64_t(i % 20)));
+  }
+
+  double t = NSys::now() - t1;
+
+  stats = o.memoStats();
+
+  return t;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+
+  size_t rounds = argc > 1 ? atoi(argv[1]) : 200;
+
+  nvar r1;
+  nvar r2;
+  nvar s1;
+  nvar s2;
+
+  double t1 = fib("Def", r1, s1);
+  double t2 = fib("DefMemo", r2, s2);
+
+  cout << "fib result: " << r1 << " / " << r2 << endl;
+  cout << "fib Def: " << t1 << " s" << endl;
+  cout << "fib DefMemo: " << t2 << " s" << endl;
+  cout << "fib memo: " << s2 << endl;
+
+  t1 = score("Def", rounds, r1, s1);
+  t2 = score("DefMemo", rounds, r2, s2);
+
+  cout << "score result: " << r1 << " / " << r2 << endl;
+  cout << "score Def: " << t1 << " s" << endl;
+  cout << "score DefMemo: " << t2 << " s" << endl;
+  cout << "score memo: " << s2 << endl;
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NThread.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures how interpreter throughput on a single shared NObject
+// scales with the number of threads evaluating code on it - every
+// evaluation step looks up the calling thread's context
+
+class Thread : public NThread{
+public:
+  Thread(NObject* o, const nvar& code, size_t rounds)
+    : o_(o),
+      code_(code),
+      rounds_(rounds){
+
+  }
+
+  void run(){
+    for(size_t i = 0; i < rounds_; ++i){
+      o_->run(code_);
+    }
+  }
+
+private:
+  NObject* o_;
+  nvar code_;
+  size_t rounds_;
+};
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+
+  size_t maxThreads = argc > 1 ? atoi(argv[1]) : 16;
+  size_t rounds = argc > 2 ? atoi(argv[2]) : 200;
+
+  NObject o;
+  o.enableThreading();
+
+  // sq(x){ return x * x; }
+  o.run(nfunc("Def") << (nfunc("sq") << nsym("x")) <<
+        (nfunc("Ret") << (nfunc("Mul") << nsym("x") << nsym("x"))));
+
+  // { s = 0; for(i = 0; i < 1000; ++i){ s += sq(i); } }
+  nvar code =
+    nfunc("ScopedBlock") <<
+    (nfunc("VarSet") << nsym("s") << 0) <<
+    (nfunc("For") <<
+     (nfunc("VarSet") << nsym("i") << 0) <<
+     (nfunc("LT") << nsym("i") << 1000) <<
+     (nfunc("Inc") << nsym("i")) <<
+     (nfunc("ScopedBlock") <<
+      (nfunc("AddBy") << nsym("s") <<
+       (nfunc("Call") << (nfunc("sq") << nsym("i"))))));
+
+  double base = 0;
+
+  for(size_t n = 1; n <= maxThreads; n *= 2){
+    NVector<Thread*> threads;
+
+    for(size_t i = 0; i < n; ++i){
+      threads.push_back(new Thread(&o, code, rounds));
+    }
+
+    double t1 = NSys::now();
+
+    for(Thread* t : threads){
+      t->start();
+    }
+
+    for(Thread* t : threads){
+      t->join();
+      delete t;
+    }
+
+    double dt = NSys::now() - t1;
+    double rate = n * rounds * 1000 / dt;
+
+    if(n == 1){
+      base = rate;
+    }
+
+    cout << "threads: " << n << " calls/s: " << size_t(rate) <<
+      " scaling: " << rate / base << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// memory-bound scans of buffers, each first touched by a worker of
+// the node it is homed on, then scanned repeatedly with tasks queued
+// either without a hint or with queueOnNode() to the buffer's node.
+// reports the fraction of bytes scanned from a remote node and the
+// scan bandwidth. workers are pinned with the numa option, on a
+// single node machine both modes read only local memory
+
+class Buffer{
+public:
+  double* data;
+  size_t size;
+  size_t home;
+  double sum;
+};
+
+atomic<size_t> _done(0);
+atomic<size_t> _remote(0);
+
+class InitProc : public NProc{
+public:
+  InitProc(NProcTask* task, NVector<Buffer>& buffers)
+  : task_(task),
+  buffers_(buffers){}
+  
+  void run(nvar& r){
+    Buffer& b = buffers_[r.asLong()];
+    
+    b.home = task_->node(task_->worker());
+    b.data = (double*)malloc(b.size * sizeof(double));
+    
+    for(size_t i = 0; i < b.size; ++i){
+      b.data[i] = i;
+    }
+    
+    ++_done;
+  }
+  
+private:
+  NProcTask* task_;
+  NVector<Buffer>& buffers_;
+};
+
+class ScanProc : public NProc{
+public:
+  ScanProc(NProcTask* task, NVector<Buffer>& buffers)
+  : task_(task),
+  buffers_(buffers){}
+  
+  void run(nvar& r){
+    Buffer& b = buffers_[r.asLong()];
+    
+    if(task_->node(task_->worker()) != b.home){
+      ++_remote;
+    }
+    
+    double sum = 0;
+    for(size_t i = 0; i < b.size; ++i){
+      sum += b.data[i];
+    }
+    
+    b.sum = sum;
+    
+    ++_done;
+  }
+  
+private:
+  NProcTask* task_;
+  NVector<Buffer>& buffers_;
+};
+
+void wait(size_t n){
+  while(_done < n){
+    NSys::sleep(0.0001);
+  }
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t count = argc > 2 ? atoi(argv[2]) : 64;
+  size_t rounds = argc > 3 ? atoi(argv[3]) : 20;
+  
+  // 4 MB per buffer
+  size_t size = 1 << 19;
+  
+  nvar options;
+  options("threads") = threads;
+  options("name") = "numa1";
+  options("numa") = true;
+  
+  NProcTask task(options);
+  
+  NVector<Buffer> buffers(count);
+  
+  InitProc initProc(&task, buffers);
+  ScanProc scanProc(&task, buffers);
+  
+  for(size_t i = 0; i < count; ++i){
+    buffers[i].size = size;
+    
+    nvar r = i;
+    task.queueOnNode(&initProc, r, i % task.nodes());
+  }
+  
+  wait(count);
+  
+  cout << "nodes: " << task.nodes() << ", threads: " << threads <<
+  ", buffers: " << count << " x " << size * sizeof(double) / 1e6 <<
+  " MB" << endl;
+  
+  for(size_t hint = 0; hint < 2; ++hint){
+    _done = 0;
+    _remote = 0;
+    
+    double t1 = NSys::now();
+    
+    for(size_t j = 0; j < rounds; ++j){
+      for(size_t i = 0; i < count; ++i){
+        nvar r = i;
+        
+        if(hint){
+          task.queueOnNode(&scanProc, r, buffers[i].home);
+        }
+        else{
+          task.queue(&scanProc, r);
+        }
+      }
+      
+      wait((j + 1) * count);
+    }
+    
+    double t = NSys::now() - t1;
+    
+    size_t scans = rounds * count;
+    
+    cout << (hint ? "queueOnNode" : "queue") << ": remote: " <<
+    double(_remote) / scans * 100 << "%, " <<
+    scans * size * sizeof(double) / t / 1e9 << " GB/s" << endl;
+  }
+  
+  task.shutdown();
+  
+  for(Buffer& b : buffers){
+    free(b.data);
+  }
+  
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <fstream>
+
+#include <unistd.h>
+#include <dirent.h>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NObject.h>
+#include <neu/NClass.h>
+#include <neu/NBroker.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// obtains proxies for a number of distributed objects on the same
+// host and measures the mean time to obtain one, the memory and the
+// file descriptors used per proxy, on both the client and server
+// sides, as both are in this process
+
+class BenchClass : public NClass{
+public:
+  BenchClass()
+  : NClass("neu::Bench"){}
+  
+  NObject* constructRemote(NBroker* broker){
+    return new NObject(broker);
+  }
+};
+
+BenchClass _benchClass;
+
+size_t residentBytes(){
+  ifstream in("/proc/self/statm");
+  size_t size = 0;
+  size_t resident = 0;
+  in >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+size_t openFiles(){
+  DIR* dir = opendir("/proc/self/fd");
+  if(!dir){
+    return 0;
+  }
+  
+  size_t n = 0;
+  while(readdir(dir)){
+    ++n;
+  }
+  
+  closedir(dir);
+  return n;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 500;
+  int port = 5271;
+  
+  NProcTask task(threads);
+  
+  NBroker broker(&task);
+  if(!broker.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  NVector<NObject*> objects;
+  
+  for(size_t i = 0; i < n; ++i){
+    NObject* o = new NObject;
+    objects.push_back(o);
+    broker.distribute(o, "Bench", "bench" + nvar(i).toStr());
+  }
+  
+  nvar auth;
+  auth("user") = "bench";
+  
+  NVector<NObject*> proxies;
+  
+  size_t m1 = residentBytes();
+  size_t f1 = openFiles();
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < n; ++i){
+    NObject* p =
+    broker.obtain("localhost", port, "bench" + nvar(i).toStr(), auth);
+    
+    if(!p){
+      cerr << "failed to obtain" << endl;
+      return 1;
+    }
+    
+    proxies.push_back(p);
+  }
+  
+  double t = NSys::now() - t1;
+  
+  // let the server finish accepting
+  NSys::sleep(0.5);
+  
+  size_t m2 = residentBytes();
+  size_t f2 = openFiles();
+  
+  int64_t sum = 0;
+  
+  for(NObject* p : proxies){
+    sum += p->remoteRun(nfunc("Add") << 1 << 2).toLong();
+  }
+  
+  cout << "proxies: " << n << ", obtain: " << t / n * 1e6 << " us" <<
+  ", memory per proxy: " << double(m2 - m1) / n << " bytes" <<
+  ", files per proxy: " << double(f2 - f1) / n <<
+  ", calls ok: " << (sum == int64_t(3 * n)) << endl;
+  
+  for(NObject* p : proxies){
+    broker.release(p);
+  }
+  
+  return 0;
+}
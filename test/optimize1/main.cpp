@@ -0,0 +1,81 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// compares interpreting a function as written with interpreting it
+// after NObject::optimize(), via setOptimize(), e.g:
+//
+// score(n){
+//   t = 0;
+//   for(i = 0; i < n; ++i){
+//     {
+//       t += i * (2.0 * 3.0) / (1.0 + 2.0);
+//       if(1 > 2){
+//         Print("debug");
+//       }
+//     }
+//   }
+//   return t;
+// }
+
+nvar scoreDef(){
+  nvar body =
+    nfunc("Block") <<
+    (nfunc("VarSet") << nsym("t") << 0) <<
+    (nfunc("For") <<
+     (nfunc("VarSet") << nsym("i") << 0) <<
+     (nfunc("LT") << nsym("i") << nsym("n")) <<
+     (nfunc("Inc") << nsym("i")) <<
+     (nfunc("ScopedBlock") <<
+      (nfunc("Block") <<
+       (nfunc("AddBy") << nsym("t") <<
+        (nfunc("Div") <<
+         (nfunc("Mul") << nsym("i") << (nfunc("Mul") << 2.0 << 3.0)) <<
+         (nfunc("Add") << 1.0 << 2.0))) <<
+       (nfunc("If") << (nfunc("GT") << 1 << 2) <<
+        (nfunc("ScopedBlock") << (nfunc("Print") << "debug")))))) <<
+    (nfunc("Ret") << nsym("t"));
+
+  return nfunc("Def") << (nfunc("score") << nsym("n")) << body;
+}
+
+double time(bool optimize, size_t rounds, nvar& result){
+  NObject o;
+  o.setOptimize(optimize);
+  o.run(scoreDef());
+
+  nvar call = nfunc("Call") << (nfunc("score") << 10000);
+
+  double t1 = NSys::now();
+
+  for(size_t i = 0; i < rounds; ++i){
+    result = o.run(call);
+  }
+
+  return NSys::now() - t1;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+
+  size_t rounds = argc > 1 ? atoi(argv[1]) : 20;
+
+  nvar r1;
+  double t1 = time(false, rounds, r1);
+
+  nvar r2;
+  double t2 = time(true, rounds, r2);
+
+  cout << "result: " << r1 << " / " << r2 << endl;
+  cout << "unoptimized: " << t1 << " s" << endl;
+  cout << "optimized: " << t2 << " s" << endl;
+  cout << "time saved: " << (1 - t2 / t1) * 100 << "%" << endl;
+
+  return 0;
+}
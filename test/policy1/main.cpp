@@ -0,0 +1,191 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NObject.h>
+#include <neu/NClass.h>
+#include <neu/NBroker.h>
+#include <neu/NFuture.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// many clients, each over its own connection, make calls on one
+// distributed object, nine reads to one write, under each execution
+// policy. a call waits briefly, as if on I/O. reports the calls per
+// second and whether a write ever overlapped another call
+
+class BenchClass : public NClass{
+public:
+  BenchClass()
+  : NClass("neu::Bench"){}
+  
+  NObject* constructRemote(NBroker* broker){
+    return new NObject(broker);
+  }
+};
+
+BenchClass _benchClass;
+
+class Counter : public NObject{
+public:
+  Counter()
+  : value_(0),
+  readers_(0),
+  writers_(0),
+  overlaps_(0){}
+  
+  NFunc handle(const nvar& v, uint32_t flags){
+    if(!v.isFunction()){
+      return NObject::handle(v, flags);
+    }
+    
+    if(v.funcStr() == "Read"){
+      return [](void* o, const nstr&, nvec& v) -> nvar{
+        return static_cast<Counter*>(o)->read();
+      };
+    }
+    
+    if(v.funcStr() == "Write"){
+      return [](void* o, const nstr&, nvec& v) -> nvar{
+        return static_cast<Counter*>(o)->write();
+      };
+    }
+    
+    return NObject::handle(v, flags);
+  }
+  
+  int64_t read(){
+    ++readers_;
+    
+    if(writers_ > 0){
+      ++overlaps_;
+    }
+    
+    NSys::sleep(work());
+    int64_t v = value_;
+    --readers_;
+    
+    return v;
+  }
+  
+  int64_t write(){
+    if(writers_++ > 0 || readers_ > 0){
+      ++overlaps_;
+    }
+    
+    NSys::sleep(work());
+    int64_t v = ++value_;
+    --writers_;
+    
+    return v;
+  }
+  
+  size_t overlaps(){
+    return overlaps_;
+  }
+  
+  static double work(){
+    return 50e-6;
+  }
+  
+private:
+  atomic<int64_t> value_;
+  atomic<size_t> readers_;
+  atomic<size_t> writers_;
+  atomic<size_t> overlaps_;
+};
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t clients = argc > 2 ? atoi(argv[2]) : 16;
+  size_t n = argc > 3 ? atoi(argv[3]) : 4000;
+  size_t window = 4;
+  int port = 5272;
+  
+  NProcTask task(threads);
+  
+  NBroker broker(&task);
+  if(!broker.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  struct Run{
+    const char* name;
+    NBroker::Policy policy;
+  };
+  
+  Run runs[] = {
+    {"serial", NBroker::Serial},
+    {"read/write", NBroker::ReadWrite},
+    {"concurrent", NBroker::Concurrent}
+  };
+  
+  for(const Run& run : runs){
+    Counter counter;
+    
+    nstr name = nstr("counter_") + run.name;
+    
+    nvar readOnly = nvec();
+    readOnly << "Read";
+    
+    broker.distribute(&counter, "Bench", name, run.policy, readOnly);
+    
+    // a connection is shared by obtains with the same authentication
+    NVector<NObject*> objs;
+    
+    for(size_t i = 0; i < clients; ++i){
+      nvar auth;
+      auth("client") = i;
+      
+      NObject* obj = broker.obtain("localhost", port, name, auth);
+      if(!obj){
+        cerr << "failed to obtain" << endl;
+        return 1;
+      }
+      
+      objs.push_back(obj);
+    }
+    
+    NVector<NFuture> fs(clients * window);
+    
+    double t1 = NSys::now();
+    
+    for(size_t i = 0; i < n; ++i){
+      NFuture& f = fs[i % fs.size()];
+      
+      if(f.valid()){
+        f.get();
+      }
+      
+      NObject* obj = objs[i % clients];
+      
+      f = obj->remoteRunAsync(nfunc(i % 10 == 0 ? "Write" : "Read"));
+    }
+    
+    for(NFuture& f : fs){
+      if(f.valid()){
+        f.get();
+      }
+    }
+    
+    double t = NSys::now() - t1;
+    
+    cout << run.name << ", clients: " << clients << ", calls/s: " <<
+    n / t << ", overlapping writes: " << counter.overlaps() << endl;
+    
+    for(NObject* obj : objs){
+      broker.release(obj);
+    }
+    
+    broker.revoke(name);
+  }
+  
+  return 0;
+}
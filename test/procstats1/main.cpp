@@ -0,0 +1,132 @@
+#include <iostream>
+#include <atomic>
+#include <cmath>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the overhead of NProcTask statistics: chains of procs
+// which signal themselves, run with statistics off and on, with
+// empty tasks and with tasks doing some work, then prints a
+// snapshot and logs a few summary lines
+
+atomic<size_t> _done(0);
+atomic<size_t> _slow(0);
+
+class ChainProc : public NProc{
+public:
+  ChainProc(NProcTask* task, size_t work)
+  : task_(task),
+  work_(work){}
+  
+  bool handle(nvar& v, nvar& r){
+    r = move(v);
+    return true;
+  }
+  
+  void run(nvar& r){
+    double x = 1;
+    for(size_t i = 0; i < work_; ++i){
+      x = sqrt(x + i);
+    }
+    
+    int64_t n = r;
+    
+    if(n > 1 || x < 0){
+      nvar v = n - 1;
+      signal(task_, this, v);
+    }
+    
+    ++_done;
+  }
+  
+private:
+  NProcTask* task_;
+  size_t work_;
+};
+
+class SlowProc : public NProc{
+public:
+  void run(nvar& r){
+    NSys::sleep(0.001);
+    ++_slow;
+  }
+};
+
+double chains(NProcTask& task, size_t count, size_t length, size_t work){
+  NVector<ChainProc*> procs;
+  for(size_t i = 0; i < count; ++i){
+    procs.push_back(new ChainProc(&task, work));
+  }
+  
+  _done = 0;
+  
+  double t1 = NSys::now();
+  
+  for(ChainProc* p : procs){
+    nvar r = length;
+    task.queue(p, r);
+  }
+  
+  while(_done < count * length){
+    NSys::sleep(0.0001);
+  }
+  
+  double t = NSys::now() - t1;
+  
+  for(ChainProc* p : procs){
+    if(task.terminate(p)){
+      delete p;
+    }
+  }
+  
+  return count * length / t;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  
+  NProcTask task(threads);
+  
+  for(size_t work : {0, 100}){
+    double off = chains(task, 64, 20000, work);
+    
+    task.startStats();
+    double on = chains(task, 64, 20000, work);
+    task.stopStats();
+    
+    cout << "work: " << work << ", tasks/s off: " << off <<
+    ", on: " << on << ", overhead: " << (off / on - 1) * 100 << "%" << endl;
+  }
+  
+  task.startStats(0.1);
+  task.logStats(cout, 0.25);
+  
+  SlowProc slow;
+  
+  for(size_t i = 0; i < 1000; ++i){
+    task.queue(&slow);
+  }
+  
+  chains(task, 64, 5000, 100);
+  
+  while(_slow < 1000){
+    NSys::sleep(0.001);
+  }
+  
+  nvar s = task.stats();
+  s("samples") = s["samples"].size();
+  
+  cout << s << endl;
+  
+  task.stopStats();
+  
+  return 0;
+}
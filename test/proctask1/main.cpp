@@ -0,0 +1,130 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures NProcTask throughput with tiny tasks on 1 to 64 threads:
+//
+// spawn: 256 chains, each proc signals itself from its worker until
+// it has run 2000 times
+//
+// external: the main thread queues 200000 tasks to 64 procs
+
+atomic<size_t> _done(0);
+
+class Proc : public NProc{
+public:
+  Proc(NProcTask* task)
+  : task_(task){}
+  
+  bool handle(nvar& v, nvar& r){
+    r = move(v);
+    return true;
+  }
+  
+  void run(nvar& r){
+    int64_t n = r;
+    
+    if(n > 1){
+      nvar v = n - 1;
+      signal(task_, this, v);
+    }
+    
+    ++_done;
+  }
+  
+private:
+  NProcTask* task_;
+};
+
+double spawn(size_t threads, size_t chains, size_t length){
+  NProcTask task(threads);
+  
+  NVector<Proc*> procs;
+  for(size_t i = 0; i < chains; ++i){
+    procs.push_back(new Proc(&task));
+  }
+  
+  _done = 0;
+  
+  double t1 = NSys::now();
+  
+  for(Proc* p : procs){
+    nvar r = length;
+    task.queue(p, r);
+  }
+  
+  while(_done < chains * length){
+    NSys::sleep(0.0001);
+  }
+  
+  double t = NSys::now() - t1;
+  
+  task.shutdown();
+  
+  for(Proc* p : procs){
+    delete p;
+  }
+  
+  return t;
+}
+
+double external(size_t threads, size_t procs, size_t count){
+  NProcTask task(threads);
+  
+  NVector<Proc*> pv;
+  for(size_t i = 0; i < procs; ++i){
+    pv.push_back(new Proc(&task));
+  }
+  
+  _done = 0;
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < count; ++i){
+    nvar r = 1;
+    task.queue(pv[i % procs], r);
+  }
+  
+  while(_done < count){
+    NSys::sleep(0.0001);
+  }
+  
+  double t = NSys::now() - t1;
+  
+  task.shutdown();
+  
+  for(Proc* p : pv){
+    delete p;
+  }
+  
+  return t;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t maxThreads = argc > 1 ? atoi(argv[1]) : 64;
+  
+  for(size_t threads = 1; threads <= maxThreads; threads *= 2){
+    size_t chains = 256;
+    size_t length = 2000;
+    
+    double t1 = spawn(threads, chains, length);
+    
+    size_t count = 200000;
+    double t2 = external(threads, 64, count);
+    
+    cout << "threads: " << threads <<
+    ", spawn: " << chains * length / t1 << " tasks/s" <<
+    ", external: " << count / t2 << " tasks/s" << endl;
+  }
+  
+  return 0;
+}
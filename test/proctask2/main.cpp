@@ -0,0 +1,103 @@
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures queue/run round trips per second, a proc queues itself
+// from run() until it has run a given number of times, and counts the
+// heap allocations made once the round trips are under way
+
+atomic<size_t> _allocations(0);
+
+void* operator new(size_t size){
+  ++_allocations;
+  
+  void* p = malloc(size);
+  if(!p){
+    throw bad_alloc();
+  }
+  
+  return p;
+}
+
+void operator delete(void* p) noexcept{
+  free(p);
+}
+
+class Proc : public NProc{
+public:
+  Proc(NProcTask* task, size_t count)
+  : task_(task),
+  count_(count),
+  done_(false){}
+  
+  void run(nvar& r){
+    if(--count_ == 0){
+      done_ = true;
+      return;
+    }
+    
+    task_->queue(this, r);
+  }
+  
+  bool done(){
+    return done_;
+  }
+  
+private:
+  NProcTask* task_;
+  size_t count_;
+  atomic_bool done_;
+};
+
+double roundTrips(size_t threads, size_t count, size_t& allocations){
+  NProcTask task(threads);
+  
+  // warm up, so that the task has seen the proc and has free items
+  Proc warm(&task, 1000);
+  task.queue(&warm);
+  while(!warm.done()){
+    NSys::sleep(0.001);
+  }
+  
+  Proc proc(&task, count);
+  
+  size_t a = _allocations;
+  double t1 = NSys::now();
+  
+  task.queue(&proc);
+  
+  while(!proc.done()){
+    NSys::sleep(0.001);
+  }
+  
+  double t = NSys::now() - t1;
+  allocations = _allocations - a;
+  
+  return t;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t count = argc > 1 ? atoi(argv[1]) : 2000000;
+  
+  for(size_t threads : {1, 4}){
+    size_t allocations;
+    double t = roundTrips(threads, count, allocations);
+    
+    cout << "threads: " << threads << ", " << count / t <<
+    " round trips/s, " << double(allocations) / count <<
+    " allocations per round trip" << endl;
+  }
+  
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <thread>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NProfiler.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// profiles interpreted code in Exact and Sampling mode and measures
+// the interpreter overhead of each against running unprofiled. then
+// checks that the calls made on threads which have since exited are
+// still reported, e.g:
+//
+// fib(n){
+//   if(n < 2){
+//     return n;
+//   }
+//   return fib(n - 1) + fib(n - 2);
+// }
+//
+// work(n){
+//   t = 0;
+//   for(i = 0; i < n; ++i){
+//     t += fib(12);
+//   }
+//   return t;
+// }
+
+nvar sig(const nvar& s, size_t line){
+  nvar r = s;
+  r.setFile("profile1.nml");
+  r.setLine(line);
+  return r;
+}
+
+nvar call(const nstr& f, const nvar& a){
+  return nfunc("Call") << (nfunc(f) << a);
+}
+
+void define(NObject& o){
+  o.run(nfunc("Def") << sig(nfunc("fib") << nsym("n"), 1) <<
+        (nfunc("Block") <<
+         (nfunc("If") << (nfunc("LT") << nsym("n") << 2) <<
+          (nfunc("Ret") << nsym("n"))) <<
+         (nfunc("Ret") <<
+          (nfunc("Add") <<
+           call("fib", nfunc("Sub") << nsym("n") << 1) <<
+           call("fib", nfunc("Sub") << nsym("n") << 2)))));
+  
+  o.run(nfunc("Def") << sig(nfunc("work") << nsym("n"), 8) <<
+        (nfunc("Block") <<
+         (nfunc("VarSet") << nsym("t") << 0) <<
+         (nfunc("For") <<
+          (nfunc("VarSet") << nsym("i") << 0) <<
+          (nfunc("LT") << nsym("i") << nsym("n")) <<
+          (nfunc("Inc") << nsym("i")) <<
+          (nfunc("AddBy") << nsym("t") << call("fib", 12))) <<
+         (nfunc("Ret") << nsym("t"))));
+}
+
+double time(NObject& o, size_t rounds){
+  nvar c = call("work", 10);
+  
+  double t1 = NSys::now();
+  
+  for(size_t i = 0; i < rounds; ++i){
+    o.run(c);
+  }
+  
+  return NSys::now() - t1;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t rounds = argc > 1 ? atoi(argv[1]) : 10;
+  
+  NObject o;
+  define(o);
+  
+  double t1 = time(o, rounds);
+  
+  NProfiler::start(NProfiler::Exact);
+  double t2 = time(o, rounds);
+  NProfiler::stop();
+  
+  cout << NProfiler::report() << endl;
+  cout << NProfiler::collapsed() << endl;
+  
+  NProfiler::clear();
+  
+  NProfiler::start(NProfiler::Sampling, 0.001);
+  double t3 = time(o, rounds);
+  NProfiler::stop();
+  
+  cout << NProfiler::report() << endl;
+  cout << NProfiler::collapsed() << endl;
+  
+  cout << "unprofiled: " << t1 << " s" << endl;
+  cout << "exact: " << t2 << " s (" << (t2 / t1 - 1) * 100 <<
+  "% overhead)" << endl;
+  cout << "sampling: " << t3 << " s (" << (t3 / t1 - 1) * 100 <<
+  "% overhead)" << endl;
+  
+  NProfiler::clear();
+  
+  size_t threads = 100;
+  
+  NProfiler::start(NProfiler::Exact);
+  
+  for(size_t i = 0; i < threads; ++i){
+    thread t([&]{
+      o.run(call("fib", 10));
+    });
+    
+    t.join();
+  }
+  
+  NProfiler::stop();
+  
+  nvar r = NProfiler::report();
+  
+  int64_t calls = 0;
+  for(size_t i = 0; i < r["functions"].size(); ++i){
+    const nvar& f = r["functions"][i];
+    
+    if(f["name"] == "fib"){
+      calls += f["calls"].toLong();
+    }
+  }
+  
+  // fib(10) makes 177 calls
+  cout << "fib calls on exited threads: " << calls << " (expected " <<
+  threads * 177 << ")" << endl;
+  
+  return 0;
+}
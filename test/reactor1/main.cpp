@@ -0,0 +1,196 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NServer.h>
+#include <neu/NCommunicator.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures an echo NServer holding many connections: the CPU used
+// while they are idle, the round trip latency on one connection
+// while the others are idle, and the time to answer one message on
+// every connection. the client side uses plain sockets
+
+class EchoComm : public NCommunicator{
+public:
+  EchoComm(NProcTask* task)
+  : NCommunicator(task){}
+  
+  void onReceive(){
+    nvar msg;
+    
+    // the authentication message is consumed by the server
+    if(session().has("auth") && receive(msg, 0)){
+      send(msg);
+    }
+  }
+};
+
+class Server : public NServer{
+public:
+  Server(NProcTask* task)
+  : NServer(task){}
+  
+  NCommunicator* create(){
+    return new EchoComm(task());
+  }
+  
+  bool authenticate(NCommunicator* comm, const nvar& auth){
+    comm->session()("auth") = true;
+    return true;
+  }
+};
+
+double cpuTime(){
+  rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  
+  return u.ru_utime.tv_sec + u.ru_utime.tv_usec / 1e6 +
+  u.ru_stime.tv_sec + u.ru_stime.tv_usec / 1e6;
+}
+
+void sendMsg(int fd, const nvar& v){
+  uint32_t size;
+  char* buf = v.pack(size, 1024, 4);
+  uint32_t s = size - 4;
+  memcpy(buf, &s, 4);
+  
+  if(send(fd, buf, size, 0) != ssize_t(size)){
+    cerr << "failed to send" << endl;
+    _exit(1);
+  }
+  
+  free(buf);
+}
+
+bool readAll(int fd, char* buf, size_t size){
+  size_t n = 0;
+  
+  while(n < size){
+    ssize_t k = recv(fd, buf + n, size - n, 0);
+    
+    if(k <= 0){
+      return false;
+    }
+    
+    n += k;
+  }
+  
+  return true;
+}
+
+void receiveMsg(int fd){
+  uint32_t size;
+  char buf[1024];
+  
+  if(!readAll(fd, (char*)&size, 4) || size > sizeof(buf) ||
+     !readAll(fd, buf, size)){
+    cerr << "failed to receive" << endl;
+    _exit(1);
+  }
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t connections = argc > 1 ? atoi(argv[1]) : 1000;
+  size_t threads = argc > 2 ? atoi(argv[2]) : 8;
+  int port = 5266;
+  
+  signal(SIGPIPE, SIG_IGN);
+  
+  NProcTask task(threads);
+  Server server(&task);
+  
+  if(!server.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  
+  NVector<int> fds;
+  
+  for(size_t i = 0; i < connections; ++i){
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    
+    if(fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+      cerr << "failed to connect: " << i << endl;
+      return 1;
+    }
+    
+    sendMsg(fd, true);
+    receiveMsg(fd);
+    
+    fds.push_back(fd);
+  }
+  
+  NSys::sleep(1);
+  
+  double c1 = cpuTime();
+  double t1 = NSys::now();
+  
+  NSys::sleep(2);
+  
+  double idle = (cpuTime() - c1) / (NSys::now() - t1) * 100;
+  
+  nvar msg = "ping";
+  
+  size_t rounds = 2000;
+  NVector<double> ts;
+  
+  for(size_t i = 0; i < rounds; ++i){
+    double t = NSys::now();
+    sendMsg(fds[0], msg);
+    receiveMsg(fds[0]);
+    ts.push_back(NSys::now() - t);
+  }
+  
+  sort(ts.begin(), ts.end());
+  
+  double mean = 0;
+  for(double t : ts){
+    mean += t;
+  }
+  mean /= rounds;
+  
+  c1 = cpuTime();
+  t1 = NSys::now();
+  
+  for(int fd : fds){
+    sendMsg(fd, msg);
+  }
+  
+  for(int fd : fds){
+    receiveMsg(fd);
+  }
+  
+  double burst = NSys::now() - t1;
+  double burstCPU = cpuTime() - c1;
+  
+  cout << "connections: " << connections << ", threads: " << threads <<
+  ", idle CPU: " << idle << "%, round trip: mean: " << mean * 1e6 <<
+  " us, p99: " << ts[rounds * 99 / 100] * 1e6 << " us, burst: " <<
+  burst * 1e3 << " ms, burst CPU: " << burstCPU * 1e3 << " ms" << endl;
+  
+  // skip tearing down the connections
+  _exit(0);
+}
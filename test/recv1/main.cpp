@@ -0,0 +1,169 @@
+#include <iostream>
+#include <atomic>
+#include <cstring>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NListener.h>
+#include <neu/NSocket.h>
+#include <neu/NCommunicator.h>
+#include <neu/NVSemaphore.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the messages per second a communicator receives over
+// loopback for messages of 64 bytes, 1 KB and 64 KB. the frames are
+// packed once, uncompressed, and written in bursts from a plain
+// socket so that only the receiving side is measured. then checks
+// that a message larger than the receiver allows closes the
+// connection
+
+class CountComm : public NCommunicator{
+public:
+  CountComm(NProcTask* task, size_t n)
+  : NCommunicator(task),
+  n_(n),
+  count_(0){}
+  
+  void onReceive(){
+    nvar msg;
+    receive(msg);
+    
+    if(++count_ == n_){
+      count_ = 0;
+      sem_.release();
+    }
+  }
+  
+  void onClose(bool manual){
+    if(!manual){
+      sem_.release();
+    }
+  }
+  
+  bool wait(double timeout){
+    return sem_.acquire(timeout);
+  }
+  
+private:
+  size_t n_;
+  atomic<size_t> count_;
+  NVSemaphore sem_;
+};
+
+// returns count frames of a message of size bytes
+nstr frames(size_t size, size_t count){
+  nvar msg = nstr(size, 'x');
+  
+  uint32_t n;
+  char* buf = msg.pack(n, size_t(-1), 4);
+  
+  uint32_t s = n - 4;
+  memcpy(buf, &s, 4);
+  
+  nstr out;
+  for(size_t i = 0; i < count; ++i){
+    out.append(buf, n);
+  }
+  
+  free(buf);
+  
+  return out;
+}
+
+bool write(NSocket& socket, const nstr& buf){
+  size_t pos = 0;
+  
+  while(pos < buf.length()){
+    ssize_t n = ::send(socket.fd(), buf.c_str() + pos,
+                       buf.length() - pos, 0);
+    
+    if(n <= 0){
+      return false;
+    }
+    
+    pos += n;
+  }
+  
+  return true;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  int port = 5268;
+  
+  NProcTask task(threads);
+  
+  NListener listener;
+  if(!listener.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  struct Config{
+    size_t size;
+    size_t n;
+    size_t burst;
+  };
+  
+  Config configs[] = {{64, 500000, 100}, {1024, 200000, 100},
+    {65536, 20000, 10}};
+  
+  for(const Config& config : configs){
+    NSocket client;
+    
+    if(!client.connect("127.0.0.1", port)){
+      cerr << "failed to connect" << endl;
+      return 1;
+    }
+    
+    CountComm server(&task, config.burst);
+    server.setSocket(listener.accept());
+    
+    nstr burst = frames(config.size, config.burst);
+    
+    double t1 = NSys::now();
+    
+    for(size_t i = 0; i < config.n; i += config.burst){
+      if(!write(client, burst) || !server.wait(60)){
+        cerr << "failed to send" << endl;
+        return 1;
+      }
+    }
+    
+    double t = NSys::now() - t1;
+    
+    cout << "size: " << config.size << ", messages/s: " <<
+    config.n / t << ", MB/s: " <<
+    config.n * config.size / t / 1048576 << endl;
+    
+    client.close();
+    NSys::sleep(0.1);
+  }
+  
+  NSocket client;
+  
+  if(!client.connect("127.0.0.1", port)){
+    cerr << "failed to connect" << endl;
+    return 1;
+  }
+  
+  CountComm server(&task, 1);
+  server.setMaxMessageSize(1024);
+  server.setSocket(listener.accept());
+  
+  write(client, frames(65536, 1));
+  
+  // the server closes the connection rather than receive it
+  server.wait(10);
+  
+  cout << "oversized message closes connection: " <<
+  !server.isConnected() << endl;
+  
+  return 0;
+}
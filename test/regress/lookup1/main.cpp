@@ -0,0 +1,66 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NError.h>
+
+using namespace std;
+using namespace neu;
+
+// a function body runs in a limiting scope, past which lookup goes on
+// in the object scope, so that a function can call another, or
+// itself, but does not see the locals of its caller
+
+nvar call(const nstr& f, const nvar& a){
+  return nfunc("Call") << (nfunc(f) << a);
+}
+
+nvar run(NObject& o, const nvar& v){
+  try{
+    return o.run(v);
+  }
+  catch(NError& e){
+    return nsym("error");
+  }
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  NObject o;
+  
+  // inc(x){ return x + 1; }
+  o.run(nfunc("Def") << (nfunc("inc") << nsym("x")) <<
+        (nfunc("Ret") << (nfunc("Add") << nsym("x") << 1)));
+  
+  // twice(x){ return inc(inc(x)); }
+  o.run(nfunc("Def") << (nfunc("twice") << nsym("x")) <<
+        (nfunc("Ret") << call("inc", call("inc", nsym("x")))));
+  
+  // fact(n){ if(n < 2){ return 1; } return n * fact(n - 1); }
+  o.run(nfunc("Def") << (nfunc("fact") << nsym("n")) <<
+        (nfunc("Block") <<
+         (nfunc("If") << (nfunc("LT") << nsym("n") << 2) <<
+          (nfunc("Ret") << 1)) <<
+         (nfunc("Ret") <<
+          (nfunc("Mul") << nsym("n") <<
+           call("fact", nfunc("Sub") << nsym("n") << 1)))));
+  
+  // local(x){ y = x; return peek(x); }
+  o.run(nfunc("Def") << (nfunc("local") << nsym("x")) <<
+        (nfunc("Block") <<
+         (nfunc("VarSet") << nsym("y") << nsym("x")) <<
+         (nfunc("Ret") << call("peek", nsym("x")))));
+  
+  // peek(x){ return y; }, y is local to its caller
+  o.run(nfunc("Def") << (nfunc("peek") << nsym("x")) <<
+        (nfunc("Ret") << nsym("y")));
+  
+  cout << "inc is: " << run(o, call("inc", 1)) << endl;
+  cout << "twice is: " << run(o, call("twice", 1)) << endl;
+  cout << "fact is: " << run(o, call("fact", 5)) << endl;
+  cout << "local is: " << run(o, call("local", 1)) << endl;
+  
+  return 0;
+}
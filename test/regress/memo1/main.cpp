@@ -0,0 +1,71 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+
+using namespace std;
+using namespace neu;
+
+// the memo of a function defined in the object scope with DefMemo
+// applies only to calls which resolve to that definition, a local
+// definition of the same name and arity shadows it. the arguments of
+// a direct call, which may be expressions, are keyed by their values
+
+nvar call(const nstr& f, const nvar& a){
+  return nfunc("Call") << (nfunc(f) << a);
+}
+
+// fib(n){ if(n < 2){ return n; } return fib(n - 1) + fib(n - 2); },
+// calling itself directly
+nvar fib(const nstr& f){
+  return nfunc("Block") <<
+  (nfunc("If") << (nfunc("LT") << nsym("n") << 2) <<
+   (nfunc("Ret") << nsym("n"))) <<
+  (nfunc("Ret") <<
+   (nfunc("Add") <<
+    (nfunc(f) << (nfunc("Sub") << nsym("n") << 1)) <<
+    (nfunc(f) << (nfunc("Sub") << nsym("n") << 2))));
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  NObject o;
+  
+  // f(x){ return x * 2; }, memoized
+  o.run(nfunc("DefMemo") << (nfunc("f") << nsym("x")) <<
+        (nfunc("Ret") << (nfunc("Mul") << nsym("x") << 2)));
+  
+  // g(x){ f(x){ return x + 100; } return f(x); }
+  o.run(nfunc("Def") << (nfunc("g") << nsym("x")) <<
+        (nfunc("Block") <<
+         (nfunc("Def") << (nfunc("f") << nsym("x")) <<
+          (nfunc("Ret") << (nfunc("Add") << nsym("x") << 100))) <<
+         (nfunc("Ret") << call("f", nsym("x")))));
+  
+  cout << "f(3) is: " << o.run(call("f", 3)) << endl;
+  
+  // the cached f(3) must not be returned for the local f
+  cout << "g(3) is: " << o.run(call("g", 3)) << endl;
+  
+  // nor the local f(4) be cached for the memoized f
+  cout << "g(4) is: " << o.run(call("g", 4)) << endl;
+  cout << "f(4) is: " << o.run(call("f", 4)) << endl;
+  cout << "f(3) is: " << o.run(call("f", 3)) << endl;
+  
+  nvar s = o.memoStats()["f/1"];
+  cout << "hits: " << s["hits"] << endl;
+  cout << "misses: " << s["misses"] << endl;
+  
+  o.run(nfunc("DefMemo") << (nfunc("mfib") << nsym("n")) << fib("mfib"));
+  
+  o.run(nfunc("VarSet") << nsym("m") << 15);
+  
+  cout << "mfib(m) is: " << o.run(nfunc("mfib") << nsym("m")) << endl;
+  cout << "mfib(m + 5) is: " <<
+  o.run(nfunc("mfib") << (nfunc("Add") << nsym("m") << 5)) << endl;
+  cout << "mfib(10) is: " << o.run(nfunc("mfib") << 10) << endl;
+  
+  return 0;
+}
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <thread>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NObject.h>
+#include <neu/NClass.h>
+#include <neu/NBroker.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// reads the symbols of a replicated object with 1000 symbols, which
+// is written to every 100 reads, through a plain proxy and then
+// through a subscribed one. measures the read latency, the bytes sent
+// per read by both ends, and how long a write takes to reach the
+// replica. then publishes an object under ReadWrite from two threads
+// while it is written to, and checks that its replica ends up equal
+// to it
+
+class BenchClass : public NClass{
+public:
+  BenchClass()
+  : NClass("neu::Bench"){}
+  
+  NObject* constructRemote(NBroker* broker){
+    return new NObject(broker);
+  }
+};
+
+BenchClass _benchClass;
+
+class CountingEncoder : public NCommunicator::Encoder{
+public:
+  CountingEncoder()
+  : bytes(0){}
+  
+  char* encrypt(char* buf, uint32_t& size){
+    bytes += size;
+    return buf;
+  }
+  
+  atomic<size_t> bytes;
+};
+
+nvar sym(size_t i){
+  return nsym("k" + nvar(i).toStr());
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 20000;
+  size_t m = argc > 3 ? atoi(argv[3]) : 1000;
+  double interval = 0.05;
+  int port = 5273;
+  
+  NProcTask task(threads);
+  
+  NObject bench;
+  
+  for(size_t i = 0; i < m; ++i){
+    bench.run(nfunc("VarSet") << sym(i) << i);
+  }
+  
+  CountingEncoder encoder;
+  
+  NBroker broker(&task);
+  broker.setEncoder(&encoder);
+  
+  if(!broker.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  broker.distribute(&bench, "Bench", "bench");
+  broker.replicate("bench", interval);
+  
+  NObject* plain = broker.obtain("localhost", port, "bench", nvar());
+  NObject* replica = broker.obtain("localhost", port, "bench", nvar());
+  
+  if(!plain || !replica){
+    cerr << "failed to obtain" << endl;
+    return 1;
+  }
+  
+  nvec reads;
+  reads << "Get";
+  
+  if(!broker.subscribe(replica, reads, interval * 4)){
+    cerr << "failed to subscribe" << endl;
+    return 1;
+  }
+  
+  int64_t next = m;
+  
+  for(NObject* p : {plain, replica}){
+    size_t b1 = encoder.bytes;
+    double t1 = NSys::now();
+    bool ok = true;
+    
+    for(size_t i = 0; i < n; ++i){
+      if(i % 100 == 0){
+        p->remoteRun(nfunc("Set") << sym(0) << next++);
+      }
+      
+      size_t j = i % m;
+      
+      if(j > 0 && p->remoteRun(nfunc("Get") << sym(j)).toLong() != int64_t(j)){
+        ok = false;
+      }
+    }
+    
+    double t = NSys::now() - t1;
+    
+    cout << (p == plain ? "plain" : "replica") <<
+    ": read: " << t / n * 1e6 << " us" <<
+    ", bytes per read: " << double(encoder.bytes - b1) / n <<
+    ", reads ok: " << ok << endl;
+  }
+  
+  // the time for writes to reach the replica
+  
+  size_t k = 20;
+  double staleness = 0;
+  
+  for(size_t i = 0; i < k; ++i){
+    int64_t v = next++;
+    
+    double t1 = NSys::now();
+    replica->remoteRun(nfunc("Set") << sym(0) << v);
+    
+    while(replica->remoteRun(nfunc("Get") << sym(0)).toLong() != v){
+      NSys::sleep(0.0005);
+    }
+    
+    staleness += NSys::now() - t1;
+  }
+  
+  cout << "interval: " << interval * 1e3 << " ms, write to replica: " <<
+  staleness / k * 1e3 << " ms" << endl;
+  
+  // publishes are read-only calls, so run in parallel under ReadWrite
+  
+  NObject shared;
+  
+  for(size_t i = 0; i < m; ++i){
+    shared.run(nfunc("VarSet") << sym(i) << i);
+  }
+  
+  broker.distribute(&shared, "Bench", "shared", NBroker::ReadWrite, reads);
+  broker.replicate("shared", interval);
+  
+  NObject* writer = broker.obtain("localhost", port, "shared", nvar());
+  NObject* sharedReplica = broker.obtain("localhost", port, "shared", nvar());
+  
+  if(!writer || !sharedReplica ||
+     !broker.subscribe(sharedReplica, reads, interval * 4)){
+    cerr << "failed to subscribe" << endl;
+    return 1;
+  }
+  
+  atomic_bool done(false);
+  
+  auto publish = [&]{
+    while(!done){
+      broker.publish("shared");
+      NSys::sleep(0.01);
+    }
+  };
+  
+  thread p1(publish);
+  thread p2(publish);
+  
+  // each symbol is changed and then changed back, the replica keeps
+  // a change which a delta from a stale snapshot misses
+  for(size_t r = 0; r < 20; ++r){
+    for(size_t i = 0; i < m; i += 10){
+      int64_t v = r % 2 == 0 ? -int64_t(i) : int64_t(i);
+      writer->remoteRun(nfunc("Set") << sym(i) << v);
+    }
+  }
+  
+  done = true;
+  p1.join();
+  p2.join();
+  
+  broker.publish("shared");
+  
+  bool equal = false;
+  double t1 = NSys::now();
+  
+  while(!equal && NSys::now() - t1 < 2){
+    equal = true;
+    
+    for(size_t i = 0; i < m; ++i){
+      if(sharedReplica->remoteRun(nfunc("Get") << sym(i)) !=
+         shared.run(sym(i))){
+        equal = false;
+        break;
+      }
+    }
+    
+    NSys::sleep(interval);
+  }
+  
+  cout << "published from two threads, replica equals owner: " <<
+  equal << endl;
+  
+  broker.release(writer);
+  broker.release(sharedReplica);
+  broker.release(plain);
+  broker.release(replica);
+  
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NObject.h>
+#include <neu/NClass.h>
+#include <neu/NBroker.h>
+#include <neu/NFuture.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the calls per second made over loopback on a distributed
+// object with 1 to 256 calls outstanding, against making each call
+// synchronously
+
+class BenchClass : public NClass{
+public:
+  BenchClass()
+  : NClass("neu::Bench"){}
+  
+  NObject* constructRemote(NBroker* broker){
+    return new NObject(broker);
+  }
+};
+
+BenchClass _benchClass;
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 20000;
+  int port = 5269;
+  
+  NProcTask task(threads);
+  
+  NObject bench;
+  
+  NBroker broker(&task);
+  if(!broker.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  broker.distribute(&bench, "Bench", "bench");
+  
+  NObject* obj = broker.obtain("localhost", port, "bench", nvar());
+  if(!obj){
+    cerr << "failed to obtain" << endl;
+    return 1;
+  }
+  
+  double t1 = NSys::now();
+  int64_t sum = 0;
+  
+  for(size_t i = 0; i < n; ++i){
+    sum += obj->remoteRun(nfunc("Add") << i << 1).toLong();
+  }
+  
+  double t = NSys::now() - t1;
+  
+  cout << "synchronous: calls/s: " << n / t << endl;
+  
+  int64_t expected = sum;
+  
+  for(size_t window = 1; window <= 256; window *= 2){
+    NVector<NFuture> fs(window);
+    
+    t1 = NSys::now();
+    sum = 0;
+    
+    for(size_t i = 0; i < n; ++i){
+      NFuture& f = fs[i % window];
+      
+      if(f.valid()){
+        sum += f.get().toLong();
+      }
+      
+      f = obj->remoteRunAsync(nfunc("Add") << i << 1);
+    }
+    
+    for(NFuture& f : fs){
+      if(f.valid()){
+        sum += f.get().toLong();
+      }
+    }
+    
+    t = NSys::now() - t1;
+    
+    cout << "outstanding: " << window << ", calls/s: " << n / t;
+    
+    if(sum != expected){
+      cout << ", wrong sum: " << sum;
+    }
+    
+    cout << endl;
+  }
+  
+  return 0;
+}
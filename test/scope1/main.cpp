@@ -0,0 +1,187 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NObject.h>
+#include <neu/NScope.h>
+#include <neu/NThread.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures symbol reads on a shared NScope from many threads: first
+// with direct getSymbol() calls, then through NObjects constructed
+// on the shared scope. a single writer thread keeps defining new
+// symbols throughout to exercise version publication
+
+static const size_t NUM_SYMBOLS = 64;
+
+class Reader : public NThread{
+public:
+  Reader(NScope* scope, size_t rounds)
+    : scope_(scope),
+      rounds_(rounds),
+      found_(0){
+
+  }
+
+  void run(){
+    NVector<nstr> keys;
+    for(size_t j = 0; j < NUM_SYMBOLS; ++j){
+      keys.push_back("s" + nvar(j).toStr());
+    }
+
+    nvar v;
+
+    for(size_t i = 0; i < rounds_; ++i){
+      for(size_t j = 0; j < NUM_SYMBOLS; ++j){
+        if(scope_->getSymbol(keys[j], v)){
+          ++found_;
+        }
+      }
+    }
+  }
+
+  size_t found(){
+    return found_;
+  }
+
+private:
+  NScope* scope_;
+  size_t rounds_;
+  size_t found_;
+};
+
+class Interpreter : public NThread{
+public:
+  Interpreter(NScope* scope, const nvar& code, size_t rounds)
+    : o_(scope),
+      code_(code),
+      rounds_(rounds){
+
+  }
+
+  void run(){
+    for(size_t i = 0; i < rounds_; ++i){
+      o_.run(code_);
+    }
+  }
+
+private:
+  NObject o_;
+  nvar code_;
+  size_t rounds_;
+};
+
+class Writer : public NThread{
+public:
+  Writer(NScope* scope)
+    : scope_(scope),
+      done_(false),
+      writes_(0){
+
+  }
+
+  void run(){
+    while(!done_){
+      scope_->setSymbol("w" + nvar(writes_ % 16), nvar(writes_));
+      ++writes_;
+      NSys::sleep(0.001);
+    }
+  }
+
+  void finish(){
+    done_ = true;
+  }
+
+  size_t writes(){
+    return writes_;
+  }
+
+private:
+  NScope* scope_;
+  atomic_bool done_;
+  size_t writes_;
+};
+
+template<class T>
+double runThreads(NVector<T*>& threads){
+  double t1 = NSys::now();
+
+  for(T* t : threads){
+    t->start();
+  }
+
+  for(T* t : threads){
+    t->join();
+  }
+
+  return NSys::now() - t1;
+}
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+
+  size_t numThreads = argc > 1 ? atoi(argv[1]) : 16;
+  size_t rounds = argc > 2 ? atoi(argv[2]) : 10000;
+
+  NScope shared(false, true);
+
+  for(size_t i = 0; i < NUM_SYMBOLS; ++i){
+    shared.setSymbol("s" + nvar(i), nvar(i));
+  }
+
+  Writer writer(&shared);
+  writer.start();
+
+  NVector<Reader*> readers;
+  for(size_t i = 0; i < numThreads; ++i){
+    readers.push_back(new Reader(&shared, rounds));
+  }
+
+  double dt = runThreads(readers);
+
+  size_t found = 0;
+  for(Reader* r : readers){
+    found += r->found();
+    delete r;
+  }
+
+  cout << "threads: " << numThreads << " getSymbol/s: " <<
+    size_t(found / dt) << endl;
+
+  // { x = 0; for(i = 0; i < 100; ++i){ x += s1 + s2; } }
+  nvar code =
+    nfunc("ScopedBlock") <<
+    (nfunc("VarSet") << nsym("x") << 0) <<
+    (nfunc("For") <<
+     (nfunc("VarSet") << nsym("i") << 0) <<
+     (nfunc("LT") << nsym("i") << 100) <<
+     (nfunc("Inc") << nsym("i")) <<
+     (nfunc("ScopedBlock") <<
+      (nfunc("AddBy") << nsym("x") <<
+       (nfunc("Add") << nsym("s1") << nsym("s2")))));
+
+  NVector<Interpreter*> interpreters;
+  for(size_t i = 0; i < numThreads; ++i){
+    interpreters.push_back(new Interpreter(&shared, code, rounds / 10));
+  }
+
+  dt = runThreads(interpreters);
+
+  for(Interpreter* t : interpreters){
+    delete t;
+  }
+
+  cout << "threads: " << numThreads << " loop iterations/s: " <<
+    size_t(numThreads * rounds / 10 * 100 / dt) << endl;
+
+  writer.finish();
+  writer.join();
+
+  cout << "writes: " << writer.writes() << endl;
+
+  return 0;
+}
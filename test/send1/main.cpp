@@ -0,0 +1,103 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NListener.h>
+#include <neu/NCommunicator.h>
+#include <neu/NVSemaphore.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// measures the throughput of small messages sent over loopback from
+// one communicator to another in bursts of 100, with and without
+// batching and Nagle's algorithm
+
+class CountComm : public NCommunicator{
+public:
+  CountComm(NProcTask* task, size_t n)
+  : NCommunicator(task),
+  n_(n),
+  count_(0){}
+  
+  void onReceive(){
+    nvar msg;
+    receive(msg);
+    
+    if(++count_ == n_){
+      count_ = 0;
+      sem_.release();
+    }
+  }
+  
+  void wait(){
+    sem_.acquire();
+  }
+  
+private:
+  size_t n_;
+  atomic<size_t> count_;
+  NVSemaphore sem_;
+};
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 8;
+  size_t n = argc > 2 ? atoi(argv[2]) : 200000;
+  size_t burst = 100;
+  int port = 5267;
+  
+  NProcTask task(threads);
+  
+  NListener listener;
+  if(!listener.listen(port)){
+    cerr << "failed to listen" << endl;
+    return 1;
+  }
+  
+  struct Config{
+    size_t maxBatch;
+    bool noDelay;
+  };
+  
+  Config configs[] = {{1, false}, {1, true}, {64, false}, {64, true}};
+  
+  for(const Config& config : configs){
+    NCommunicator client(&task);
+    client.setMaxBatch(config.maxBatch);
+    client.setNoDelay(config.noDelay);
+    
+    if(!client.connect("127.0.0.1", port)){
+      cerr << "failed to connect" << endl;
+      return 1;
+    }
+    
+    CountComm server(&task, burst);
+    server.setSocket(listener.accept());
+    
+    double t1 = NSys::now();
+    
+    for(size_t i = 0; i < n; i += burst){
+      for(size_t j = 0; j < burst; ++j){
+        nvar msg = i + j;
+        client.send(msg);
+      }
+      
+      server.wait();
+    }
+    
+    double t = NSys::now() - t1;
+    
+    cout << "max batch: " << config.maxBatch << ", no delay: " <<
+    config.noDelay << ", messages/s: " << n / t << endl;
+    
+    client.close();
+    NSys::sleep(0.1);
+  }
+  
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <atomic>
+
+#include <neu/nvar.h>
+#include <neu/NProgram.h>
+#include <neu/NProc.h>
+#include <neu/NServer.h>
+#include <neu/NCommunicator.h>
+#include <neu/NVSemaphore.h>
+#include <neu/NSys.h>
+
+using namespace std;
+using namespace neu;
+
+// compares the transports a communicator can connect to a peer on the
+// same host with: TCP loopback, a Unix domain socket and shared
+// memory rings. measures the round trip latency of one message at a
+// time, then the throughput of messages echoed in bursts. the
+// messages are smaller than the size at which they are compressed
+
+class EchoComm : public NCommunicator{
+public:
+  EchoComm(NProcTask* task)
+  : NCommunicator(task),
+  ready_(false){}
+  
+  // the authentication message is left for the server
+  void onReceive(){
+    if(!ready_){
+      return;
+    }
+    
+    nvar msg;
+    receive(msg);
+    send(msg);
+  }
+  
+  void start(){
+    ready_ = true;
+  }
+  
+private:
+  atomic_bool ready_;
+};
+
+class EchoServer : public NServer{
+public:
+  EchoServer(NProcTask* task)
+  : NServer(task){}
+  
+  NCommunicator* create(){
+    return new EchoComm(task());
+  }
+  
+  bool authenticate(NCommunicator* comm, const nvar& auth){
+    static_cast<EchoComm*>(comm)->start();
+    return true;
+  }
+};
+
+class CountComm : public NCommunicator{
+public:
+  CountComm(NProcTask* task)
+  : NCommunicator(task),
+  n_(1),
+  count_(0){}
+  
+  void onReceive(){
+    if(n_ == 0){
+      return;
+    }
+    
+    nvar msg;
+    receive(msg);
+    
+    if(++count_ == n_){
+      count_ = 0;
+      sem_.release();
+    }
+  }
+  
+  // n is the number of messages to wait for each time, 0 to leave
+  // them for receive()
+  void setCount(size_t n){
+    n_ = n;
+  }
+  
+  void wait(){
+    sem_.acquire();
+  }
+  
+private:
+  atomic<size_t> n_;
+  atomic<size_t> count_;
+  NVSemaphore sem_;
+};
+
+int main(int argc, char** argv){
+  NProgram program(argc, argv);
+  
+  size_t threads = argc > 1 ? atoi(argv[1]) : 4;
+  size_t n = argc > 2 ? atoi(argv[2]) : 100000;
+  size_t burst = 100;
+  
+  NProcTask task(threads);
+  
+  struct Transport{
+    const char* listen;
+    const char* connect;
+  };
+  
+  Transport transports[] = {
+    {"tcp://:5268", "tcp://127.0.0.1:5268"},
+    {"unix:///tmp/neu_transport1", "unix:///tmp/neu_transport1"},
+    {"shm:///tmp/neu_transport1_shm", "shm:///tmp/neu_transport1_shm"}
+  };
+  
+  size_t sizes[] = {64, 512};
+  
+  for(const Transport& t : transports){
+    EchoServer server(&task);
+    
+    if(!server.listen(t.listen)){
+      cerr << "failed to listen: " << t.listen << endl;
+      return 1;
+    }
+    
+    CountComm client(&task);
+    client.setCount(0);
+    
+    if(!client.connect(t.connect)){
+      cerr << "failed to connect: " << t.connect << endl;
+      return 1;
+    }
+    
+    nvar auth = true;
+    client.send(auth);
+    
+    nvar resp;
+    if(!client.receive(resp, 5) || !resp){
+      cerr << "failed to authenticate: " << t.connect << endl;
+      return 1;
+    }
+    
+    for(size_t size : sizes){
+      nvar msg = nstr(size, 'x');
+      
+      size_t m = n/10;
+      client.setCount(1);
+      
+      double t1 = NSys::now();
+      
+      for(size_t i = 0; i < m; ++i){
+        nvar r = msg;
+        client.send(r);
+        client.wait();
+      }
+      
+      double latency = (NSys::now() - t1)/m;
+      
+      client.setCount(burst);
+      
+      t1 = NSys::now();
+      
+      for(size_t i = 0; i < n; i += burst){
+        for(size_t j = 0; j < burst; ++j){
+          nvar r = msg;
+          client.send(r);
+        }
+        
+        client.wait();
+      }
+      
+      double rate = n/(NSys::now() - t1);
+      
+      cout << t.connect << ", size: " << size << ", round trip: " <<
+      latency*1e6 << " us, messages/s: " << rate << endl;
+    }
+    
+    client.close();
+    NSys::sleep(0.1);
+  }
+  
+  return 0;
+}